@@ -0,0 +1,400 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 base64.c
+ * @brief	streaming Base64 encoder and decoder with SSSE3 and NEON blocks
+ */
+#include "core/base64.h"
+#include "core/util/detect.h"
+#include <string.h>
+
+#if defined(GC_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BASE64_NEON 1
+#elif defined(GC_SSSE3)
+#include <tmmintrin.h>
+#endif
+
+/*
+ * The vector paths work on whole blocks of the alphabet: 48 bytes to 64
+ * characters with NEON table lookups, 12 bytes to 16 characters with SSSE3
+ * shuffles.  A decode block holding whitespace, padding or anything else
+ * outside the alphabet goes through the scalar loop instead, which also takes
+ * whatever is left at the end.  The 64-entry NEON lookups are AArch64 only,
+ * 32-bit ARM uses the scalar loop.
+ */
+
+static const char TO_BASE64[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define XX 0xff // not Base64
+#define WS 0xfe // skipped
+#define EQ 0xfd // padding, ends the data
+
+static const unsigned char FROM_BASE64[256] = {
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, WS, WS, WS, WS, WS, XX, XX, // 0-15
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 16-31
+    WS, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, 62, XX, XX, XX, 63, // 32-47
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, XX, XX, XX, EQ, XX, XX, // 48-63
+    XX, 0 , 1 , 2 , 3 , 4 , 5 , 6 , 7 , 8 , 9 , 10, 11, 12, 13, 14, // 64-79
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, XX, XX, XX, XX, XX, // 80-95
+    XX, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, // 96-111
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, XX, XX, XX, XX, XX, // 112-127
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, // 128-255
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX
+};
+
+/**
+ * @name	base64_encoded_length
+ * @brief	characters needed to encode a number of bytes, padding included
+ * @param	bytes - (size_t) bytes to encode
+ * @retval	size_t - characters, not counting a terminating nul
+ */
+size_t base64_encoded_length(size_t bytes) {
+    return ((bytes + 2) / 3) * 4;
+}
+
+/**
+ * @name	base64_decoded_length
+ * @brief	most bytes that a number of characters can decode to
+ * @param	chars - (size_t) characters handed to one base64_decode_update call
+ * @retval	size_t - bytes the destination must hold
+ */
+size_t base64_decoded_length(size_t chars) {
+    // A call may also finish a group left over from the last one
+    return (chars / 4) * 3 + 3;
+}
+
+// Encodes whole 3-byte groups, returns the characters written
+static size_t encode_groups(const unsigned char *src, size_t bytes, char *dst) {
+    char *out = dst;
+
+#if defined(BASE64_NEON)
+    const uint8x16x4_t table = {{
+        vld1q_u8((const uint8_t *)TO_BASE64),
+        vld1q_u8((const uint8_t *)TO_BASE64 + 16),
+        vld1q_u8((const uint8_t *)TO_BASE64 + 32),
+        vld1q_u8((const uint8_t *)TO_BASE64 + 48)
+    }};
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+
+    while (bytes >= 48) {
+        const uint8x16x3_t in = vld3q_u8(src);
+        uint8x16x4_t indices;
+        indices.val[0] = vshrq_n_u8(in.val[0], 2);
+        indices.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+        indices.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+        indices.val[3] = vandq_u8(in.val[2], mask);
+
+        uint8x16x4_t chars;
+        chars.val[0] = vqtbl4q_u8(table, indices.val[0]);
+        chars.val[1] = vqtbl4q_u8(table, indices.val[1]);
+        chars.val[2] = vqtbl4q_u8(table, indices.val[2]);
+        chars.val[3] = vqtbl4q_u8(table, indices.val[3]);
+        vst4q_u8((uint8_t *)out, chars);
+
+        src += 48;
+        bytes -= 48;
+        out += 64;
+    }
+#elif defined(GC_SSSE3)
+    // Each 32-bit lane gets the 3 bytes of one group, then the multiplies
+    // move the four 6-bit indices into their own bytes
+    const __m128i spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                            '/' - 63, 'A', 0, 0);
+
+    // Reads 16 bytes for every 12 it encodes
+    while (bytes >= 16) {
+        const __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), spread);
+        const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        const __m128i indices = _mm_or_si128(t0, t1);
+
+        // Picks the offset from index to character by range
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        const __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        const __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, range), indices);
+        _mm_storeu_si128((__m128i *)out, chars);
+
+        src += 12;
+        bytes -= 12;
+        out += 16;
+    }
+#endif
+
+    while (bytes >= 3) {
+        out[0] = TO_BASE64[src[0] >> 2];
+        out[1] = TO_BASE64[((src[0] << 4) | (src[1] >> 4)) & 0x3f];
+        out[2] = TO_BASE64[((src[1] << 2) | (src[2] >> 6)) & 0x3f];
+        out[3] = TO_BASE64[src[2] & 0x3f];
+        src += 3;
+        bytes -= 3;
+        out += 4;
+    }
+    return (size_t)(out - dst);
+}
+
+void base64_encoder_init(base64_encoder *enc) {
+    enc->carry_bytes = 0;
+}
+
+/**
+ * @name	base64_encode_update
+ * @brief	encodes the next bytes of the data, holding back an incomplete group
+ * @param	enc - (base64_encoder *) encoder from base64_encoder_init
+ * @param	src - (const unsigned char *) bytes to encode
+ * @param	bytes - (size_t) number of bytes in src
+ * @param	dst - (char *) holds base64_encoded_length(bytes + 2) characters
+ * @retval	size_t - characters written, no terminating nul
+ */
+size_t base64_encode_update(base64_encoder *enc, const unsigned char *src, size_t bytes, char *dst) {
+    size_t written = 0;
+
+    if (enc->carry_bytes > 0) {
+        if (enc->carry_bytes + bytes < 3) {
+            memcpy(enc->carry + enc->carry_bytes, src, bytes);
+            enc->carry_bytes += (int)bytes;
+            return 0;
+        }
+
+        unsigned char group[3];
+        const size_t fill = 3 - enc->carry_bytes;
+        memcpy(group, enc->carry, enc->carry_bytes);
+        memcpy(group + enc->carry_bytes, src, fill);
+        written = encode_groups(group, 3, dst);
+        src += fill;
+        bytes -= fill;
+        enc->carry_bytes = 0;
+    }
+
+    const size_t whole = bytes - bytes % 3;
+    written += encode_groups(src, whole, dst + written);
+    enc->carry_bytes = (int)(bytes - whole);
+    memcpy(enc->carry, src + whole, enc->carry_bytes);
+    return written;
+}
+
+/**
+ * @name	base64_encode_finish
+ * @brief	writes the held back bytes and padding
+ * @param	enc - (base64_encoder *) encoder, ready for new data afterwards
+ * @param	dst - (char *) holds 4 characters
+ * @retval	size_t - characters written, no terminating nul
+ */
+size_t base64_encode_finish(base64_encoder *enc, char *dst) {
+    const unsigned char *carry = enc->carry;
+    const int carry_bytes = enc->carry_bytes;
+
+    enc->carry_bytes = 0;
+    if (carry_bytes == 0) {
+        return 0;
+    }
+
+    dst[0] = TO_BASE64[carry[0] >> 2];
+    if (carry_bytes == 1) {
+        dst[1] = TO_BASE64[(carry[0] << 4) & 0x3f];
+        dst[2] = '=';
+    } else {
+        dst[1] = TO_BASE64[((carry[0] << 4) | (carry[1] >> 4)) & 0x3f];
+        dst[2] = TO_BASE64[(carry[1] << 2) & 0x3f];
+    }
+    dst[3] = '=';
+    return 4;
+}
+
+/**
+ * @name	base64_encode
+ * @brief	encodes all of the data at once
+ * @param	src - (const unsigned char *) bytes to encode
+ * @param	bytes - (size_t) number of bytes in src
+ * @param	dst - (char *) holds base64_encoded_length(bytes) characters
+ * @retval	size_t - characters written, no terminating nul
+ */
+size_t base64_encode(const unsigned char *src, size_t bytes, char *dst) {
+    base64_encoder enc;
+    base64_encoder_init(&enc);
+
+    const size_t written = base64_encode_update(&enc, src, bytes, dst);
+    return written + base64_encode_finish(&enc, dst + written);
+}
+
+// Decodes whole groups of four alphabet characters, stopping ahead of the
+// first group with anything else in it
+static void decode_groups(const unsigned char **src, const unsigned char *end, unsigned char **dst) {
+    const unsigned char *in = *src;
+    unsigned char *out = *dst;
+
+#if defined(BASE64_NEON)
+    // The first half of the scalar table covers ASCII, the rest is invalid
+    const uint8x16x4_t table_lo = {{
+        vld1q_u8(FROM_BASE64), vld1q_u8(FROM_BASE64 + 16), vld1q_u8(FROM_BASE64 + 32), vld1q_u8(FROM_BASE64 + 48)
+    }};
+    const uint8x16x4_t table_hi = {{
+        vld1q_u8(FROM_BASE64 + 64), vld1q_u8(FROM_BASE64 + 80), vld1q_u8(FROM_BASE64 + 96), vld1q_u8(FROM_BASE64 + 112)
+    }};
+    const uint8x16_t offset = vdupq_n_u8(64);
+    const uint8x16_t high_bit = vdupq_n_u8(0x80);
+
+    while (end - in >= 64) {
+        const uint8x16x4_t chars = vld4q_u8(in);
+        uint8x16x4_t values;
+        int i;
+        for (i = 0; i < 4; ++i) {
+            const uint8x16_t c = chars.val[i];
+            values.val[i] = vqtbx4q_u8(vqtbl4q_u8(table_lo, c), table_hi, vsubq_u8(c, offset));
+        }
+
+        // Non-ASCII characters fall outside both tables, so flag them too
+        const uint8x16_t check = vorrq_u8(vorrq_u8(vorrq_u8(values.val[0], values.val[1]), vorrq_u8(values.val[2], values.val[3])),
+                                          vandq_u8(vorrq_u8(vorrq_u8(chars.val[0], chars.val[1]), vorrq_u8(chars.val[2], chars.val[3])), high_bit));
+        if (vmaxvq_u8(check) > 63) {
+            break;
+        }
+
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(values.val[0], 2), vshrq_n_u8(values.val[1], 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(values.val[1], 4), vshrq_n_u8(values.val[2], 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]);
+        vst3q_u8(out, bytes);
+
+        in += 64;
+        out += 48;
+    }
+#elif defined(GC_SSSE3)
+    // Classifies each character by its nibbles, any set bit in both lookups
+    // means it is outside the alphabet
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    while (end - in >= 16) {
+        const __m128i chars = _mm_loadu_si128((const __m128i *)in);
+        const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), nibble);
+        const __m128i lo_nibbles = _mm_and_si128(chars, nibble);
+        const __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(invalid, _mm_setzero_si128()))) {
+            break;
+        }
+
+        // '/' shares its high nibble with '+', so it gets its own offset
+        const __m128i is_slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+        const __m128i values = _mm_add_epi8(chars, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(is_slash, hi_nibbles)));
+
+        // Joins the four 6-bit values of each lane into 24 bits, big-endian
+        const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        const __m128i groups = _mm_shuffle_epi8(_mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000)), pack);
+
+        // Only 12 of the 16 bytes are data
+        _mm_storel_epi64((__m128i *)out, groups);
+        const int tail = _mm_cvtsi128_si32(_mm_srli_si128(groups, 8));
+        memcpy(out + 8, &tail, 4);
+
+        in += 16;
+        out += 12;
+    }
+#endif
+
+    while (end - in >= 4) {
+        const unsigned char a = FROM_BASE64[in[0]];
+        const unsigned char b = FROM_BASE64[in[1]];
+        const unsigned char c = FROM_BASE64[in[2]];
+        const unsigned char d = FROM_BASE64[in[3]];
+        if ((a | b | c | d) & 0xc0) {
+            break;
+        }
+
+        out[0] = (unsigned char)((a << 2) | (b >> 4));
+        out[1] = (unsigned char)((b << 4) | (c >> 2));
+        out[2] = (unsigned char)((c << 6) | d);
+        in += 4;
+        out += 3;
+    }
+
+    *src = in;
+    *dst = out;
+}
+
+void base64_decoder_init(base64_decoder *dec) {
+    dec->bits = 0;
+    dec->bit_count = 0;
+    dec->done = false;
+    dec->error = false;
+}
+
+/**
+ * @name	base64_decode_update
+ * @brief	decodes the next characters of the data
+ * @param	dec - (base64_decoder *) decoder from base64_decoder_init, sets
+ *			done at the padding and error at a character outside the alphabet
+ * @param	src - (const char *) characters to decode, need not be whole groups
+ * @param	chars - (size_t) number of characters in src
+ * @param	dst - (unsigned char *) holds base64_decoded_length(chars) bytes
+ * @retval	size_t - bytes written
+ */
+size_t base64_decode_update(base64_decoder *dec, const char *src, size_t chars, unsigned char *dst) {
+    const unsigned char *in = (const unsigned char *)src;
+    const unsigned char *end = in + chars;
+    unsigned char *out = dst;
+    unsigned int bits = dec->bits;
+    int bit_count = dec->bit_count;
+
+    if (dec->done || dec->error) {
+        return 0;
+    }
+
+    while (in < end) {
+        // Whole groups only line up between bytes
+        if (bit_count == 0) {
+            decode_groups(&in, end, &out);
+            if (in == end) {
+                break;
+            }
+        }
+
+        const unsigned char value = FROM_BASE64[*in++];
+        if (value < 64) {
+            bits = (bits << 6) | value;
+            bit_count += 6;
+            if (bit_count >= 8) {
+                bit_count -= 8;
+                *out++ = (unsigned char)(bits >> bit_count);
+                bits &= (1u << bit_count) - 1;
+            }
+        } else if (value == EQ) {
+            dec->done = true;
+            break;
+        } else if (value != WS) {
+            dec->error = true;
+            break;
+        }
+    }
+
+    dec->bits = bits;
+    dec->bit_count = bit_count;
+    return (size_t)(out - dst);
+}
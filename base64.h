@@ -0,0 +1,59 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef BASE64_H
+#define BASE64_H
+
+#include "core/types.h"
+#include <stddef.h>
+
+/*
+ * Base64 (RFC 4648, "+/" alphabet) in pieces, so images can be encoded as
+ * they are compressed and decoded as they are read.  Encoding pads the end
+ * with '='.  Decoding skips whitespace, stops at the first '=' and fails on
+ * any other character outside the alphabet.
+ */
+typedef struct base64_encoder_t {
+	unsigned char carry[2]; // Bytes waiting for a third
+	int carry_bytes;
+} base64_encoder;
+
+typedef struct base64_decoder_t {
+	unsigned int bits;      // Decoded bits not yet written out
+	int bit_count;
+	bool done;              // Reached the padding
+	bool error;
+} base64_decoder;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t base64_encoded_length(size_t bytes);
+size_t base64_decoded_length(size_t chars);
+
+void base64_encoder_init(base64_encoder *enc);
+size_t base64_encode_update(base64_encoder *enc, const unsigned char *src, size_t bytes, char *dst);
+size_t base64_encode_finish(base64_encoder *enc, char *dst);
+size_t base64_encode(const unsigned char *src, size_t bytes, char *dst);
+
+void base64_decoder_init(base64_decoder *dec);
+size_t base64_decode_update(base64_decoder *dec, const char *src, size_t chars, unsigned char *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
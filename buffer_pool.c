@@ -0,0 +1,240 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 buffer_pool.c
+ * @brief	size-classed buffers for decoded texels and decode scratch
+ */
+#include "core/buffer_pool.h"
+#include "core/deps/uthash/uthash.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Smaller requests share the smallest class, four classes per power of 2 above it
+#define MIN_CLASS_SHIFT 12
+#define CLASS_COUNT (4 * 19 + 1) /* up to 1 GB */
+
+typedef struct pool_buffer_t {
+    void *data;
+    size_t capacity;
+    int size_class;
+    struct pool_buffer_t *next; // idle list
+    UT_hash_handle hh;
+} pool_buffer;
+
+// Buffers handed out are found by their data pointer, idle ones wait in
+// their class list and are not in the hash
+static pool_buffer *m_in_use = NULL;
+static pool_buffer *m_idle[CLASS_COUNT] = {NULL};
+static size_t m_idle_bytes = 0;
+static size_t m_max_bytes = BUFFER_POOL_MAX_BYTES;
+static pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Class of a request and its capacity, or -1 for requests too large to pool
+static int get_size_class(size_t size, size_t *capacity) {
+    if (size <= ((size_t)1 << MIN_CLASS_SHIFT)) {
+        *capacity = (size_t)1 << MIN_CLASS_SHIFT;
+        return 0;
+    }
+
+    int shift = MIN_CLASS_SHIFT;
+    while ((size - 1) >> (shift + 1)) {
+        ++shift;
+    }
+
+    const size_t base = (size_t)1 << shift;
+    const size_t step = base >> 2;
+    const size_t steps = (size - base + step - 1) / step;
+    const int size_class = (shift - MIN_CLASS_SHIFT) * 4 + (int)steps;
+    if (size_class >= CLASS_COUNT) {
+        return -1;
+    }
+
+    *capacity = base + steps * step;
+    return size_class;
+}
+
+// Frees idle buffers until at most max_bytes are left, largest classes first
+static void trim_idle(size_t max_bytes) {
+    pool_buffer *freed = NULL;
+    int size_class;
+
+    pthread_mutex_lock(&m_mutex);
+    for (size_class = CLASS_COUNT - 1; size_class >= 0 && m_idle_bytes > max_bytes; --size_class) {
+        while (m_idle[size_class] && m_idle_bytes > max_bytes) {
+            pool_buffer *buffer = m_idle[size_class];
+            m_idle[size_class] = buffer->next;
+            m_idle_bytes -= buffer->capacity;
+            buffer->next = freed;
+            freed = buffer;
+        }
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    while (freed) {
+        pool_buffer *next = freed->next;
+        free(freed->data);
+        free(freed);
+        freed = next;
+    }
+}
+
+/**
+ * @name	buffer_pool_alloc
+ * @brief	gets a buffer, reusing an idle one of the same size class
+ * @param	size - (size_t) bytes needed
+ * @retval	void* - buffer of at least size bytes aligned like malloc, or NULL
+ *			if it cannot allocate
+ */
+void *buffer_pool_alloc(size_t size) {
+    size_t capacity;
+    int size_class = get_size_class(size, &capacity);
+    if (size_class < 0) {
+        return malloc(size);
+    }
+
+    pthread_mutex_lock(&m_mutex);
+    pool_buffer *buffer = m_idle[size_class];
+    if (buffer) {
+        m_idle[size_class] = buffer->next;
+        m_idle_bytes -= buffer->capacity;
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    if (!buffer) {
+        buffer = (pool_buffer *)malloc(sizeof(pool_buffer));
+        if (!buffer) {
+            return NULL;
+        }
+
+        buffer->data = malloc(capacity);
+        if (!buffer->data) {
+            // idle buffers of other sizes may be what is in the way
+            trim_idle(0);
+            buffer->data = malloc(capacity);
+        }
+        if (!buffer->data) {
+            free(buffer);
+            return NULL;
+        }
+        buffer->capacity = capacity;
+        buffer->size_class = size_class;
+    }
+
+    buffer->next = NULL;
+    pthread_mutex_lock(&m_mutex);
+    HASH_ADD_PTR(m_in_use, data, buffer);
+    pthread_mutex_unlock(&m_mutex);
+    return buffer->data;
+}
+
+/**
+ * @name	buffer_pool_realloc
+ * @brief	grows a buffer, keeping its contents, like realloc()
+ * @param	data - (void *) buffer from the pool or malloc, may be NULL
+ * @param	size - (size_t) bytes needed
+ * @retval	void* - the buffer, moved if it had no room, or NULL if it cannot
+ *			allocate, leaving data as it was
+ */
+void *buffer_pool_realloc(void *data, size_t size) {
+    if (!data) {
+        return buffer_pool_alloc(size);
+    }
+
+    pool_buffer *buffer = NULL;
+    pthread_mutex_lock(&m_mutex);
+    HASH_FIND_PTR(m_in_use, &data, buffer);
+    size_t capacity = buffer ? buffer->capacity : 0;
+    pthread_mutex_unlock(&m_mutex);
+
+    if (!buffer) {
+        return realloc(data, size);
+    } else if (capacity >= size) {
+        return data;
+    }
+
+    void *grown = buffer_pool_alloc(size);
+    if (grown) {
+        memcpy(grown, data, capacity);
+        buffer_pool_release(data);
+    }
+    return grown;
+}
+
+/**
+ * @name	buffer_pool_release
+ * @brief	gives a buffer back, it is kept for reuse while the idle buffers fit
+ *			in the limit and freed otherwise
+ * @param	data - (void *) buffer from the pool or malloc, may be NULL
+ * @retval	NONE
+ */
+void buffer_pool_release(void *data) {
+    if (!data) {
+        return;
+    }
+
+    pool_buffer *buffer = NULL;
+    pthread_mutex_lock(&m_mutex);
+    HASH_FIND_PTR(m_in_use, &data, buffer);
+    if (buffer) {
+        HASH_DEL(m_in_use, buffer);
+        if (m_idle_bytes + buffer->capacity <= m_max_bytes) {
+            buffer->next = m_idle[buffer->size_class];
+            m_idle[buffer->size_class] = buffer;
+            m_idle_bytes += buffer->capacity;
+            buffer = NULL;
+            data = NULL;
+        }
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    free(data);
+    free(buffer);
+}
+
+/**
+ * @name	buffer_pool_trim
+ * @brief	frees every idle buffer, for memory warnings
+ * @retval	NONE
+ */
+void buffer_pool_trim() {
+    trim_idle(0);
+}
+
+/**
+ * @name	buffer_pool_set_max_bytes
+ * @brief	sets the memory idle buffers may hold, freeing those past it
+ * @param	bytes - (size_t) limit in bytes, zero frees every released buffer
+ * @retval	NONE
+ */
+void buffer_pool_set_max_bytes(size_t bytes) {
+    pthread_mutex_lock(&m_mutex);
+    m_max_bytes = bytes;
+    pthread_mutex_unlock(&m_mutex);
+    trim_idle(bytes);
+}
+
+/**
+ * @name	buffer_pool_get_bytes
+ * @brief	gets the memory idle buffers hold right now
+ * @retval	size_t - bytes
+ */
+size_t buffer_pool_get_bytes() {
+    pthread_mutex_lock(&m_mutex);
+    size_t bytes = m_idle_bytes;
+    pthread_mutex_unlock(&m_mutex);
+    return bytes;
+}
@@ -0,0 +1,48 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Size-classed buffers for decoded texels and decode scratch, shared by the
+ * decode threads.  Sizes round up to a quarter of a power of 2, so a
+ * released buffer serves the next image of about the same size without
+ * going back to malloc.  Idle buffers past BUFFER_POOL_MAX_BYTES are freed,
+ * and buffer_pool_trim() frees the rest under memory pressure.
+ *
+ * Buffers from the pool must go back through buffer_pool_release() or
+ * buffer_pool_realloc(), which also take plain malloc'd buffers.
+ */
+#define BUFFER_POOL_MAX_BYTES (16 * 1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *buffer_pool_alloc(size_t size);
+void *buffer_pool_realloc(void *data, size_t size);
+void buffer_pool_release(void *data);
+void buffer_pool_trim();
+void buffer_pool_set_max_bytes(size_t bytes);
+size_t buffer_pool_get_bytes();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,232 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 canvas_spill.c
+ * @brief	canvas pixels compressed in memory on a worker thread
+ */
+#include "core/canvas_spill.h"
+#include "core/lz.h"
+#include "core/buffer_pool.h"
+#include "core/list.h"
+#include "core/log.h"
+#include "core/platform/threads.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+struct canvas_spill_t {
+    unsigned char *pixels; // NULL once compressed
+    size_t size;
+    unsigned char *packed;
+    size_t packed_size;
+    bool compressing; // the worker has it, wait on m_done_cond before touching it
+    bool abandoned; // freed while compressing, the worker frees it when done
+
+    struct canvas_spill_t *next;
+    struct canvas_spill_t *prev;
+};
+
+static pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t m_queued_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t m_done_cond = PTHREAD_COND_INITIALIZER;
+static canvas_spill *m_queue = NULL;
+static ThreadsThread m_thread = THREADS_INVALID_THREAD;
+static bool m_running = false;
+
+static void destroy_spill(canvas_spill *spill) {
+    buffer_pool_release(spill->pixels);
+    free(spill->packed);
+    free(spill);
+}
+
+static void canvas_spill_run(void *unused) {
+    pthread_mutex_lock(&m_mutex);
+
+    while (m_running) {
+        canvas_spill *spill = m_queue;
+        if (!spill) {
+            pthread_cond_wait(&m_queued_cond, &m_mutex);
+            continue;
+        }
+
+        LIST_REMOVE(&m_queue, spill);
+        spill->compressing = true;
+        pthread_mutex_unlock(&m_mutex);
+
+        unsigned char *packed = (unsigned char *)malloc(lz_compress_bound(spill->size));
+        size_t packed_size = 0;
+        if (packed) {
+            packed_size = lz_compress(spill->pixels, spill->size, packed);
+            if (packed_size < spill->size) {
+                unsigned char *shrunk = (unsigned char *)realloc(packed, packed_size);
+                packed = shrunk ? shrunk : packed;
+            } else {
+                // noise does not compress, keep the pixels as they are
+                free(packed);
+                packed = NULL;
+            }
+        }
+
+        pthread_mutex_lock(&m_mutex);
+        spill->compressing = false;
+        if (spill->abandoned) {
+            free(packed);
+            destroy_spill(spill);
+        } else if (packed) {
+            buffer_pool_release(spill->pixels);
+            spill->pixels = NULL;
+            spill->packed = packed;
+            spill->packed_size = packed_size;
+        }
+        pthread_cond_broadcast(&m_done_cond);
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+}
+
+/**
+ * @name	canvas_spill_queue
+ * @brief	takes read back canvas pixels and queues them to be compressed
+ * @param	pixels - (unsigned char *) pixels from malloc or buffer_pool_alloc(), owned
+ *			by the spill from now on
+ * @param	size - (size_t) size of the pixels in bytes
+ * @retval	canvas_spill* - spill to restore or free later, NULL if given no pixels or
+ *			out of memory, the pixels are then still the caller's
+ */
+canvas_spill *canvas_spill_queue(unsigned char *pixels, size_t size) {
+    if (!pixels) {
+        return NULL;
+    }
+
+    canvas_spill *spill = (canvas_spill *)malloc(sizeof(canvas_spill));
+    if (!spill) {
+        return NULL;
+    }
+    spill->pixels = pixels;
+    spill->size = size;
+    spill->packed = NULL;
+    spill->packed_size = 0;
+    spill->compressing = false;
+    spill->abandoned = false;
+    spill->next = spill->prev = NULL;
+
+    pthread_mutex_lock(&m_mutex);
+    if (!m_running) {
+        m_running = true;
+        m_thread = threads_create_thread(canvas_spill_run, NULL);
+    }
+    LIST_ADD(&m_queue, spill);
+    pthread_cond_signal(&m_queued_cond);
+    pthread_mutex_unlock(&m_mutex);
+
+    return spill;
+}
+
+/**
+ * @name	canvas_spill_restore
+ * @brief	gets the pixels back and frees the spill
+ * @param	spill - (canvas_spill *) spill from canvas_spill_queue(), may be NULL
+ * @retval	unsigned char* - pixels for the caller to give to buffer_pool_release(),
+ *			NULL if there were none
+ */
+unsigned char *canvas_spill_restore(canvas_spill *spill) {
+    if (!spill) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&m_mutex);
+    if (LIST_IN_LIST(&m_queue, spill)) {
+        // still waiting to be compressed, no need to now
+        LIST_REMOVE(&m_queue, spill);
+    }
+    while (spill->compressing) {
+        pthread_cond_wait(&m_done_cond, &m_mutex);
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    unsigned char *pixels = spill->pixels;
+    spill->pixels = NULL;
+    if (!pixels) {
+        pixels = (unsigned char *)buffer_pool_alloc(spill->size);
+        if (pixels && !lz_decompress(spill->packed, spill->packed_size, pixels, spill->size)) {
+            LOG("{canvas} WARNING: Spilled canvas is corrupt");
+            buffer_pool_release(pixels);
+            pixels = NULL;
+        }
+    }
+
+    destroy_spill(spill);
+    return pixels;
+}
+
+/**
+ * @name	canvas_spill_free
+ * @brief	drops a spill without restoring it
+ * @param	spill - (canvas_spill *) spill to free, may be NULL
+ * @retval	NONE
+ */
+void canvas_spill_free(canvas_spill *spill) {
+    if (!spill) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_mutex);
+    if (LIST_IN_LIST(&m_queue, spill)) {
+        LIST_REMOVE(&m_queue, spill);
+    }
+    if (spill->compressing) {
+        spill->abandoned = true;
+        spill = NULL;
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    if (spill) {
+        destroy_spill(spill);
+    }
+}
+
+/**
+ * @name	canvas_spill_get_bytes
+ * @brief	gets the memory a spill holds right now
+ * @param	spill - (canvas_spill *) spill to measure, may be NULL
+ * @retval	size_t - bytes, the full pixel size until compressed
+ */
+size_t canvas_spill_get_bytes(canvas_spill *spill) {
+    size_t bytes = 0;
+    if (spill) {
+        pthread_mutex_lock(&m_mutex);
+        bytes = spill->pixels ? spill->size : spill->packed_size;
+        pthread_mutex_unlock(&m_mutex);
+    }
+    return bytes;
+}
+
+/**
+ * @name	canvas_spill_shutdown
+ * @brief	stops the worker thread, spills left in the queue stay uncompressed
+ * @retval	NONE
+ */
+void canvas_spill_shutdown() {
+    pthread_mutex_lock(&m_mutex);
+    if (!m_running) {
+        pthread_mutex_unlock(&m_mutex);
+        return;
+    }
+    m_running = false;
+    pthread_cond_signal(&m_queued_cond);
+    pthread_mutex_unlock(&m_mutex);
+
+    threads_join_thread(&m_thread);
+}
@@ -0,0 +1,44 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef CANVAS_SPILL_H
+#define CANVAS_SPILL_H
+
+#include "core/types.h"
+
+/*
+ * Canvas pixels kept in memory while the canvas has no GL texture, after a
+ * context loss or after eviction under memory pressure.  The pixels read back
+ * on the GL thread are handed over as they are, a worker thread compresses
+ * them with lz_compress() and restoring them waits for the worker only if it
+ * is in the middle of that spill.
+ */
+typedef struct canvas_spill_t canvas_spill;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+canvas_spill *canvas_spill_queue(unsigned char *pixels, size_t size);
+unsigned char *canvas_spill_restore(canvas_spill *spill);
+void canvas_spill_free(canvas_spill *spill);
+size_t canvas_spill_get_bytes(canvas_spill *spill);
+void canvas_spill_shutdown();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
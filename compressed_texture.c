@@ -0,0 +1,522 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 compressed_texture.c
+ * @brief	compressed texture format table and CPU fallback decoders
+ */
+#include "core/compressed_texture.h"
+#include "core/texture_2d.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Block dimensions of ASTC formats, in the order of their GL enums
+static const unsigned char m_astc_blocks[14][2] = {
+    {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+    {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}
+};
+
+static int get_astc_index(int compression_type) {
+    if (compression_type >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR && compression_type <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR) {
+        return compression_type - GL_COMPRESSED_RGBA_ASTC_4x4_KHR;
+    }
+    if (compression_type >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR && compression_type <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR) {
+        return compression_type - GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR;
+    }
+    return -1;
+}
+
+/**
+ * @name	compressed_texture_get_family
+ * @brief	groups a compressed format with the ones sharing its GL extension
+ * @param	compression_type - (int) GL compressed internal format
+ * @retval	compressed_texture_family - family, or COMPRESSED_TEXTURE_UNKNOWN
+ */
+compressed_texture_family compressed_texture_get_family(int compression_type) {
+    switch (compression_type) {
+    case GL_ETC1_RGB8_OES:
+        return COMPRESSED_TEXTURE_ETC1;
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        return COMPRESSED_TEXTURE_ETC2;
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return COMPRESSED_TEXTURE_S3TC;
+    default:
+        return get_astc_index(compression_type) >= 0 ? COMPRESSED_TEXTURE_ASTC : COMPRESSED_TEXTURE_UNKNOWN;
+    }
+}
+
+/**
+ * @name	compressed_texture_get_block_info
+ * @brief	describes the fixed-size blocks a compressed format is made of
+ * @param	compression_type - (int) GL compressed internal format
+ * @param	block_width - (int *) out: texels across a block
+ * @param	block_height - (int *) out: texels down a block
+ * @param	block_bytes - (int *) out: bytes per block
+ * @retval	bool - false if the format is unknown
+ */
+bool compressed_texture_get_block_info(int compression_type, int *block_width, int *block_height, int *block_bytes) {
+    switch (compressed_texture_get_family(compression_type)) {
+    case COMPRESSED_TEXTURE_ETC1:
+    case COMPRESSED_TEXTURE_ETC2:
+    case COMPRESSED_TEXTURE_S3TC:
+        *block_width = 4;
+        *block_height = 4;
+        *block_bytes = (compression_type == GL_COMPRESSED_RGBA8_ETC2_EAC ||
+                        compression_type == GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC ||
+                        compression_type == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT ||
+                        compression_type == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) ? 16 : 8;
+        return true;
+    case COMPRESSED_TEXTURE_ASTC: {
+        int i = get_astc_index(compression_type);
+        *block_width = m_astc_blocks[i][0];
+        *block_height = m_astc_blocks[i][1];
+        *block_bytes = 16;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * @name	compressed_texture_get_size
+ * @brief	bytes of one mip level, partial blocks are stored whole
+ * @param	compression_type - (int) GL compressed internal format
+ * @param	width - (int) width of the level in texels
+ * @param	height - (int) height of the level in texels
+ * @retval	unsigned long - size of the level, or zero if the format is unknown
+ */
+unsigned long compressed_texture_get_size(int compression_type, int width, int height) {
+    int block_width, block_height, block_bytes;
+
+    if (!compressed_texture_get_block_info(compression_type, &block_width, &block_height, &block_bytes)) {
+        return 0;
+    }
+
+    return (unsigned long)((width + block_width - 1) / block_width) *
+           ((height + block_height - 1) / block_height) * block_bytes;
+}
+
+/**
+ * @name	compressed_texture_is_opaque
+ * @brief	checks if a compressed format has no alpha at all
+ * @param	compression_type - (int) GL compressed internal format
+ * @retval	bool - true if every texel of the format is opaque
+ */
+bool compressed_texture_is_opaque(int compression_type) {
+    switch (compression_type) {
+    case GL_ETC1_RGB8_OES:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @name	compressed_texture_is_supported
+ * @brief	checks if the GL context can sample a compressed format
+ * @param	compression_type - (int) GL compressed internal format
+ * @param	upload_type - (int *) out: format to upload the data as, ETC1 data
+ *			goes up as ETC2 on contexts without the ETC1 extension
+ * @retval	bool - true if the format can be uploaded
+ */
+bool compressed_texture_is_supported(int compression_type, int *upload_type) {
+    *upload_type = compression_type;
+
+    switch (compressed_texture_get_family(compression_type)) {
+    case COMPRESSED_TEXTURE_ETC1:
+        if (texture_2d_gl_caps & TEXTURE_CAP_ETC1) {
+            return true;
+        }
+        // ETC2 decoders read ETC1 blocks unchanged
+        *upload_type = GL_COMPRESSED_RGB8_ETC2;
+        return (texture_2d_gl_caps & TEXTURE_CAP_ETC2) != 0;
+    case COMPRESSED_TEXTURE_ETC2:
+        return (texture_2d_gl_caps & TEXTURE_CAP_ETC2) != 0;
+    case COMPRESSED_TEXTURE_S3TC:
+        return (texture_2d_gl_caps & TEXTURE_CAP_S3TC) != 0;
+    case COMPRESSED_TEXTURE_ASTC:
+        return (texture_2d_gl_caps & TEXTURE_CAP_ASTC) != 0;
+    default:
+        return false;
+    }
+}
+
+
+//// ETC1 / ETC2 / EAC
+
+static const int m_etc_modifiers[8][4] = {
+    {  2,   8,  -2,   -8},
+    {  5,  17,  -5,  -17},
+    {  9,  29,  -9,  -29},
+    { 13,  42, -13,  -42},
+    { 18,  60, -18,  -60},
+    { 24,  80, -24,  -80},
+    { 33, 106, -33, -106},
+    { 47, 183, -47, -183}
+};
+
+static const int m_etc_distances[8] = {3, 6, 11, 16, 20, 23, 27, 32};
+
+static const int m_eac_modifiers[16][8] = {
+    {-3, -6,  -9, -15, 2, 5, 8, 14},
+    {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5,  -8, -13, 1, 4, 7, 12},
+    {-2, -4,  -6, -13, 1, 3, 5, 12},
+    {-3, -6,  -8, -12, 2, 5, 7, 11},
+    {-3, -7,  -9, -11, 2, 6, 8, 10},
+    {-4, -7,  -8, -11, 3, 6, 7, 10},
+    {-3, -5,  -8, -11, 2, 4, 7, 10},
+    {-2, -6,  -8, -10, 1, 5, 7,  9},
+    {-2, -5,  -8, -10, 1, 4, 7,  9},
+    {-2, -4,  -8, -10, 1, 3, 7,  9},
+    {-2, -5,  -7, -10, 1, 4, 6,  9},
+    {-3, -4,  -7, -10, 2, 3, 6,  9},
+    {-1, -2,  -3, -10, 0, 1, 2,  9},
+    {-4, -6,  -8,  -9, 3, 5, 7,  8},
+    {-3, -5,  -7,  -9, 2, 4, 6,  8}
+};
+
+static inline int clamp255(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline unsigned int read_u32_be(const unsigned char *p) {
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+static inline void set_texel(unsigned char *block, int x, int y, int r, int g, int b, int a) {
+    unsigned char *texel = block + (y * 4 + x) * 4;
+    texel[0] = (unsigned char)clamp255(r);
+    texel[1] = (unsigned char)clamp255(g);
+    texel[2] = (unsigned char)clamp255(b);
+    texel[3] = (unsigned char)a;
+}
+
+/*
+ * Decodes an ETC1 or ETC2 RGB block to 4x4 RGBA texels in row order.  With
+ * punchthrough alpha the diff bit is the opaque flag instead: the individual
+ * mode is gone and index 2 of non-planar blocks is transparent black.
+ */
+static void decode_etc2_color(const unsigned char *src, unsigned char *block, bool etc2, bool punchthrough) {
+    unsigned int hi = read_u32_be(src), lo = read_u32_be(src + 4);
+    bool diff = (hi & 2) != 0;
+    bool opaque = !punchthrough || diff;
+    int x, y, c;
+
+    if (punchthrough) {
+        diff = true;
+    }
+
+    if (etc2 && diff) {
+        int r = (int)(hi >> 27) + ((int)((hi >> 24) & 7) ^ 4) - 4;
+        int g = (int)((hi >> 19) & 31) + ((int)((hi >> 16) & 7) ^ 4) - 4;
+        int b = (int)((hi >> 11) & 31) + ((int)((hi >> 8) & 7) ^ 4) - 4;
+
+        if (r < 0 || r > 31 || g < 0 || g > 31) {
+            int c1[3], c2[3], paint[4][3];
+
+            if (r < 0 || r > 31) { // T mode
+                c1[0] = (int)(((hi >> 27) & 3) << 2 | ((hi >> 24) & 3));
+                c1[1] = (int)((hi >> 20) & 15);
+                c1[2] = (int)((hi >> 16) & 15);
+                c2[0] = (int)((hi >> 12) & 15);
+                c2[1] = (int)((hi >> 8) & 15);
+                c2[2] = (int)((hi >> 4) & 15);
+                int d = m_etc_distances[((hi >> 2) & 3) << 1 | (hi & 1)];
+                for (c = 0; c < 3; ++c) {
+                    paint[0][c] = c1[c] * 17;
+                    paint[1][c] = clamp255(c2[c] * 17 + d);
+                    paint[2][c] = c2[c] * 17;
+                    paint[3][c] = clamp255(c2[c] * 17 - d);
+                }
+            } else { // H mode
+                c1[0] = (int)((hi >> 27) & 15);
+                c1[1] = (int)(((hi >> 24) & 7) << 1 | ((hi >> 20) & 1));
+                c1[2] = (int)(((hi >> 19) & 1) << 3 | ((hi >> 15) & 7));
+                c2[0] = (int)((hi >> 11) & 15);
+                c2[1] = (int)((hi >> 7) & 15);
+                c2[2] = (int)((hi >> 3) & 15);
+                int v1 = (c1[0] << 8) | (c1[1] << 4) | c1[2];
+                int v2 = (c2[0] << 8) | (c2[1] << 4) | c2[2];
+                int d = m_etc_distances[((hi >> 2) & 1) << 2 | (hi & 1) << 1 | (v1 >= v2 ? 1 : 0)];
+                for (c = 0; c < 3; ++c) {
+                    paint[0][c] = clamp255(c1[c] * 17 + d);
+                    paint[1][c] = clamp255(c1[c] * 17 - d);
+                    paint[2][c] = clamp255(c2[c] * 17 + d);
+                    paint[3][c] = clamp255(c2[c] * 17 - d);
+                }
+            }
+
+            for (x = 0; x < 4; ++x) {
+                for (y = 0; y < 4; ++y) {
+                    int i = x * 4 + y;
+                    int index = (int)(((lo >> (16 + i)) & 1) << 1 | ((lo >> i) & 1));
+                    if (!opaque && index == 2) {
+                        set_texel(block, x, y, 0, 0, 0, 0);
+                    } else {
+                        set_texel(block, x, y, paint[index][0], paint[index][1], paint[index][2], 255);
+                    }
+                }
+            }
+            return;
+        }
+
+        if (b < 0 || b > 31) { // Planar mode
+            int ro = (int)((hi >> 25) & 63);
+            int go = (int)(((hi >> 24) & 1) << 6 | ((hi >> 17) & 63));
+            int bo = (int)(((hi >> 16) & 1) << 5 | ((hi >> 11) & 3) << 3 | ((hi >> 7) & 7));
+            int rh = (int)(((hi >> 2) & 31) << 1 | (hi & 1));
+            int gh = (int)((lo >> 25) & 127);
+            int bh = (int)((lo >> 19) & 63);
+            int rv = (int)((lo >> 13) & 63);
+            int gv = (int)((lo >> 6) & 127);
+            int bv = (int)(lo & 63);
+
+            ro = (ro << 2) | (ro >> 4); rh = (rh << 2) | (rh >> 4); rv = (rv << 2) | (rv >> 4);
+            go = (go << 1) | (go >> 6); gh = (gh << 1) | (gh >> 6); gv = (gv << 1) | (gv >> 6);
+            bo = (bo << 2) | (bo >> 4); bh = (bh << 2) | (bh >> 4); bv = (bv << 2) | (bv >> 4);
+
+            for (y = 0; y < 4; ++y) {
+                for (x = 0; x < 4; ++x) {
+                    set_texel(block, x, y,
+                              (x * (rh - ro) + y * (rv - ro) + 4 * ro + 2) >> 2,
+                              (x * (gh - go) + y * (gv - go) + 4 * go + 2) >> 2,
+                              (x * (bh - bo) + y * (bv - bo) + 4 * bo + 2) >> 2, 255);
+                }
+            }
+            return;
+        }
+    }
+
+    // ETC1 individual and differential modes
+    int base[2][3];
+    for (c = 0; c < 3; ++c) {
+        int v = (int)((hi >> (24 - c * 8)) & 255);
+        if (diff) {
+            int b5 = v >> 3;
+            int b5_2 = b5 + ((v & 7) ^ 4) - 4;
+            base[0][c] = (b5 << 3) | (b5 >> 2);
+            base[1][c] = (b5_2 << 3) | (b5_2 >> 2);
+        } else {
+            base[0][c] = (v >> 4) * 17;
+            base[1][c] = (v & 15) * 17;
+        }
+    }
+
+    bool flip = (hi & 1) != 0;
+    int tables[2] = {(int)((hi >> 5) & 7), (int)((hi >> 2) & 7)};
+
+    for (x = 0; x < 4; ++x) {
+        for (y = 0; y < 4; ++y) {
+            int i = x * 4 + y;
+            int index = (int)(((lo >> (16 + i)) & 1) << 1 | ((lo >> i) & 1));
+            int half = flip ? (y >= 2) : (x >= 2);
+
+            if (!opaque && index == 2) {
+                set_texel(block, x, y, 0, 0, 0, 0);
+            } else {
+                int mod = (!opaque && index == 0) ? 0 : m_etc_modifiers[tables[half]][index];
+                set_texel(block, x, y, base[half][0] + mod, base[half][1] + mod, base[half][2] + mod, 255);
+            }
+        }
+    }
+}
+
+// Decodes an EAC alpha block into the alpha of 4x4 RGBA texels
+static void decode_eac_alpha(const unsigned char *src, unsigned char *block) {
+    int base = src[0];
+    int multiplier = src[1] >> 4;
+    const int *modifiers = m_eac_modifiers[src[1] & 15];
+    int x, y;
+
+    // 16 3-bit indices, big-endian and in column order
+    unsigned long long bits = 0;
+    for (x = 2; x < 8; ++x) {
+        bits = (bits << 8) | src[x];
+    }
+
+    for (x = 0; x < 4; ++x) {
+        for (y = 0; y < 4; ++y) {
+            int index = (int)((bits >> (45 - (x * 4 + y) * 3)) & 7);
+            block[(y * 4 + x) * 4 + 3] = (unsigned char)clamp255(base + modifiers[index] * multiplier);
+        }
+    }
+}
+
+
+//// S3TC
+
+static inline void expand_565(unsigned int c, int *rgb) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void decode_dxt_color(const unsigned char *src, unsigned char *block, bool four_color) {
+    unsigned int c0 = src[0] | (src[1] << 8), c1 = src[2] | (src[3] << 8);
+    unsigned int indices = src[4] | (src[5] << 8) | (src[6] << 16) | ((unsigned int)src[7] << 24);
+    int palette[4][4], i, c;
+
+    expand_565(c0, palette[0]);
+    expand_565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+    if (four_color || c0 > c1) {
+        for (c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+    } else {
+        for (c = 0; c < 3; ++c) {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+        palette[3][3] = 0;
+    }
+
+    for (i = 0; i < 16; ++i) {
+        const int *color = palette[(indices >> (i * 2)) & 3];
+        set_texel(block, i & 3, i >> 2, color[0], color[1], color[2], color[3]);
+    }
+}
+
+static void decode_dxt3_alpha(const unsigned char *src, unsigned char *block) {
+    int i;
+    for (i = 0; i < 16; ++i) {
+        int a = (src[i >> 1] >> ((i & 1) * 4)) & 15;
+        block[i * 4 + 3] = (unsigned char)(a * 17);
+    }
+}
+
+static void decode_dxt5_alpha(const unsigned char *src, unsigned char *block) {
+    int a0 = src[0], a1 = src[1], palette[8], i;
+    unsigned long long indices = 0;
+
+    for (i = 7; i >= 2; --i) {
+        indices = (indices << 8) | src[i];
+    }
+
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1) {
+        for (i = 1; i < 7; ++i) {
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+    } else {
+        for (i = 1; i < 5; ++i) {
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    for (i = 0; i < 16; ++i) {
+        block[i * 4 + 3] = (unsigned char)palette[(indices >> (i * 3)) & 7];
+    }
+}
+
+/**
+ * @name	compressed_texture_decompress
+ * @brief	decodes the base level of a compressed image on the CPU, for GPUs
+ *			without the format.  ETC1, ETC2, EAC and S3TC are supported
+ * @param	compression_type - (int) GL compressed internal format
+ * @param	data - (const unsigned char *) compressed base level
+ * @param	size - (unsigned long) bytes of compressed data
+ * @param	width - (int) width in texels
+ * @param	height - (int) height in texels
+ * @param	out_channels - (int *) out: 3 for opaque formats, otherwise 4
+ * @retval	unsigned char* - tightly packed texels to be freed by the caller, or NULL
+ */
+unsigned char *compressed_texture_decompress(int compression_type, const unsigned char *data, unsigned long size, int width, int height, int *out_channels) {
+    compressed_texture_family family = compressed_texture_get_family(compression_type);
+    int block_width, block_height, block_bytes;
+
+    if ((family != COMPRESSED_TEXTURE_ETC1 && family != COMPRESSED_TEXTURE_ETC2 && family != COMPRESSED_TEXTURE_S3TC) ||
+        width <= 0 || height <= 0 || size < compressed_texture_get_size(compression_type, width, height)) {
+        return NULL;
+    }
+    compressed_texture_get_block_info(compression_type, &block_width, &block_height, &block_bytes);
+
+    bool opaque = compression_type == GL_ETC1_RGB8_OES || compression_type == GL_COMPRESSED_RGB8_ETC2 ||
+                  compression_type == GL_COMPRESSED_SRGB8_ETC2 || compression_type == GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    int channels = opaque ? 3 : 4;
+    unsigned char *pixels = (unsigned char *)malloc((size_t)width * height * channels);
+    if (!pixels) {
+        return NULL;
+    }
+
+    unsigned char block[4 * 4 * 4];
+    int bx, by, x, y, c;
+
+    for (by = 0; by < height; by += 4) {
+        for (bx = 0; bx < width; bx += 4, data += block_bytes) {
+            switch (compression_type) {
+            case GL_ETC1_RGB8_OES:
+                decode_etc2_color(data, block, false, false);
+                break;
+            case GL_COMPRESSED_RGB8_ETC2:
+            case GL_COMPRESSED_SRGB8_ETC2:
+                decode_etc2_color(data, block, true, false);
+                break;
+            case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+            case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+                decode_etc2_color(data, block, true, true);
+                break;
+            case GL_COMPRESSED_RGBA8_ETC2_EAC:
+            case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+                decode_etc2_color(data + 8, block, true, false);
+                decode_eac_alpha(data, block);
+                break;
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+                decode_dxt_color(data, block, false);
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+                decode_dxt_color(data + 8, block, true);
+                decode_dxt3_alpha(data, block);
+                break;
+            default: // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                decode_dxt_color(data + 8, block, true);
+                decode_dxt5_alpha(data, block);
+                break;
+            }
+
+            for (y = 0; y < 4 && by + y < height; ++y) {
+                for (x = 0; x < 4 && bx + x < width; ++x) {
+                    unsigned char *out = pixels + ((long)(by + y) * width + bx + x) * channels;
+                    for (c = 0; c < channels; ++c) {
+                        out[c] = block[(y * 4 + x) * 4 + c];
+                    }
+                }
+            }
+        }
+    }
+
+    *out_channels = channels;
+    return pixels;
+}
@@ -0,0 +1,74 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef COMPRESSED_TEXTURE_H
+#define COMPRESSED_TEXTURE_H
+
+#include "core/types.h"
+
+// Compressed internal formats, not every GL header defines them
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_SRGB8_ETC2 0x9275
+#define GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9276
+#define GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9277
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#define GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC 0x9279
+#endif
+
+// ASTC 4x4 through 12x12, the sRGB formats follow at the same offsets
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#define GL_COMPRESSED_RGBA_ASTC_12x12_KHR 0x93BD
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR 0x93D0
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR 0x93DD
+#endif
+
+// Families of compressed formats, in the order they are preferred
+typedef enum compressed_texture_family_t {
+	COMPRESSED_TEXTURE_UNKNOWN = 0,
+	COMPRESSED_TEXTURE_ASTC,
+	COMPRESSED_TEXTURE_ETC2,
+	COMPRESSED_TEXTURE_S3TC,
+	COMPRESSED_TEXTURE_ETC1
+} compressed_texture_family;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+compressed_texture_family compressed_texture_get_family(int compression_type);
+bool compressed_texture_get_block_info(int compression_type, int *block_width, int *block_height, int *block_bytes);
+unsigned long compressed_texture_get_size(int compression_type, int width, int height);
+bool compressed_texture_is_opaque(int compression_type);
+bool compressed_texture_is_supported(int compression_type, int *upload_type);
+unsigned char *compressed_texture_decompress(int compression_type, const unsigned char *data, unsigned long size, int width, int height, int *out_channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
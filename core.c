@@ -22,9 +22,12 @@
 #include "core/config.h"
 #include "core/rgba.h"
 #include "core/texture_manager.h"
+#include "core/texture_format.h"
+#include "core/image_export.h"
 #include "core/tealeaf_canvas.h"
 #include "core/tealeaf_context.h"
 #include "core/tealeaf_shaders.h"
+#include "core/draw_textures.h"
 #include "core/url_loader.h"
 #include "core/log.h"
 #include "core/events.h"
@@ -114,6 +117,11 @@ void core_init(const char *entry_point,
         set_halfsized_textures(false);
     }
 
+    // read the spritesheet sizes now rather than on the first image load
+    texture_manager_load_sheet_index();
+    // texture formats must be known before any image is decoded
+    texture_format_load_manifest();
+
     texture_manager_load_texture(texture_manager_get(), config_get_splash());
 
     LOG("{core} Initialization complete");
@@ -128,7 +136,11 @@ void core_init(const char *entry_point,
 void core_init_gl(int framebuffer_name) {
     LOG("{core} Initializing OpenGL");
 
+    // Texture sizing depends on what the context supports
+    texture_2d_detect_gl_caps();
+
     tealeaf_shaders_init();
+    draw_textures_init();
     m_framebuffer_name = framebuffer_name;
 
     // If frame buffer id was invalid,
@@ -216,6 +228,7 @@ void core_tick(long dt) {
     if (js_ready) {
         core_timer_tick(dt);
         js_tick(dt);
+        image_export_tick();
     }
 
     // Tick the texture manager (load pending textures)
@@ -311,6 +324,7 @@ void core_on_screen_resize(int width, int height) {
  */
 void core_destroy() {
     destroy_js();
+    image_export_shutdown();
     texture_manager_destroy(texture_manager_get());
     sound_manager_halt();
 }
@@ -24,6 +24,7 @@ extern "C" {
 #endif
 
 extern int use_halfsized_textures;
+extern int generate_mipmaps;
 
 void core_init(const char *entry_point,
                const char *tcp_host,
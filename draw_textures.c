@@ -25,10 +25,14 @@
 #include "core/graphics_utils.h"
 #include "platform/gl.h"
 #include <math.h>
+#include <stdlib.h>
 
 #define DRAW_TEXTURES_PROFILE 0
 #define MAX_BUFFER_SIZE 1024
 
+// Quads held back between flushes by the opaque pass, each takes a depth step
+#define MAX_SEGMENT_QUADS 1024
+
 
 static int lastName = -1;
 static int bufSize = 0;
@@ -52,6 +56,151 @@ typedef struct bufobj_t {
 } bufobj;
 
 static bufobj buffer[MAX_BUFFER_SIZE];
+
+/*
+ * Opaque pass
+ *
+ * Quads drawn to the screen between two flushes make up a segment.  While
+ * the pass is on they are held back: quads whose texels are all opaque and
+ * that draw source-over at full opacity go in the opaque list, the rest in
+ * the translucent list, each quad getting a depth nearer than the quads
+ * before it.  When the segment is flushed the opaque quads are drawn newest
+ * first with blending off and depth writes on, so pixels hidden by later
+ * quads fail the depth test instead of being shaded and blended.  The
+ * translucent quads follow in their original order, blended and depth tested
+ * but not written, and the result matches drawing every quad in order.
+ */
+typedef struct segment_vertex_t {
+    float s;
+    float t;
+    float x;
+    float y;
+    float z;
+} segment_vertex;
+
+typedef struct segment_batch_t {
+    int name;
+    float opacity;
+    int composite_op;
+    rgba filter_color;
+    int filter_type;
+    int first; // First vertex
+    int count; // Vertices
+} segment_batch;
+
+static bool opaque_pass = false;
+static int depth_bits = -1; // Of the screen, -1 until checked
+static context_2d *segment_ctx = NULL;
+static int segment_quads = 0;
+static segment_vertex *opaque_vertices = NULL; // Filled from the end, so the newest quads come first
+static int opaque_first = MAX_SEGMENT_QUADS * 6;
+static segment_batch *opaque_batches = NULL;
+static int opaque_batch_count = 0;
+static segment_vertex *translucent_vertices = NULL;
+static int translucent_count = 0;
+static segment_batch *translucent_batches = NULL;
+static int translucent_batch_count = 0;
+
+static void flush_buffer();
+static void flush_segment();
+
+/**
+ * @name	draw_textures_init
+ * @brief	forgets what was learned about the GL context, call when it is made or remade
+ * @retval	NONE
+ */
+void draw_textures_init() {
+    // the new screen may have a depth buffer of another size, or none
+    depth_bits = -1;
+}
+
+/**
+ * @name	draw_textures_set_opaque_pass
+ * @brief	turns the opaque pass on or off, see above.  It needs a depth
+ *			buffer on the screen and does nothing for a screen without one
+ * @param	enabled - (bool) true to draw opaque quads front to back first
+ * @retval	NONE
+ */
+void draw_textures_set_opaque_pass(bool enabled) {
+    draw_textures_flush();
+    if (enabled == opaque_pass) {
+        return;
+    }
+
+    opaque_pass = enabled;
+    if (enabled) {
+        depth_bits = -1;
+        opaque_vertices = (segment_vertex *)malloc(MAX_SEGMENT_QUADS * 6 * sizeof(segment_vertex));
+        opaque_batches = (segment_batch *)malloc(MAX_SEGMENT_QUADS * sizeof(segment_batch));
+        translucent_vertices = (segment_vertex *)malloc(MAX_SEGMENT_QUADS * 6 * sizeof(segment_vertex));
+        translucent_batches = (segment_batch *)malloc(MAX_SEGMENT_QUADS * sizeof(segment_batch));
+    } else {
+        free(opaque_vertices);
+        free(opaque_batches);
+        free(translucent_vertices);
+        free(translucent_batches);
+        opaque_vertices = translucent_vertices = NULL;
+        opaque_batches = translucent_batches = NULL;
+    }
+    LOG("{drawtex} opaque_pass=%d", enabled);
+}
+
+/**
+ * @name	draw_textures_get_opaque_pass
+ * @brief	checks if the opaque pass is on
+ * @retval	bool - true if opaque quads are drawn front to back first
+ */
+bool draw_textures_get_opaque_pass() {
+    return opaque_pass;
+}
+
+static void set_segment_vertex(segment_vertex *v, float s, float t, float x, float y, float z) {
+    v->s = s;
+    v->t = t;
+    v->x = x;
+    v->y = y;
+    v->z = z;
+}
+
+// Writes the two triangles of a quad, corners in the order given by matrix_3x3_multiply
+static void write_segment_quad(segment_vertex *v, float sMin, float tMin, float sMax, float tMax,
+                               float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, float z) {
+    set_segment_vertex(v, sMin, tMax, x4, y4, z);
+    set_segment_vertex(v + 1, sMax, tMax, x3, y3, z);
+    set_segment_vertex(v + 2, sMin, tMin, x1, y1, z);
+    set_segment_vertex(v + 3, sMax, tMax, x3, y3, z);
+    set_segment_vertex(v + 4, sMax, tMin, x2, y2, z);
+    set_segment_vertex(v + 5, sMin, tMin, x1, y1, z);
+}
+
+static bool segment_batch_matches(const segment_batch *batch, int name, float opacity, int composite_op, const rgba *filter_color, int filter_type) {
+    return batch->name == name && batch->opacity == opacity && batch->composite_op == composite_op &&
+           batch->filter_type == filter_type && rgba_equals((rgba *)&batch->filter_color, (rgba *)filter_color);
+}
+
+static void segment_batch_init(segment_batch *batch, int name, float opacity, int composite_op, const rgba *filter_color, int filter_type, int first) {
+    batch->name = name;
+    batch->opacity = opacity;
+    batch->composite_op = composite_op;
+    batch->filter_color = *filter_color;
+    batch->filter_type = filter_type;
+    batch->first = first;
+    batch->count = 6;
+}
+
+// Checks if a draw to a context can be held back for the opaque pass
+static bool use_segment(context_2d *ctx, int composite_op) {
+    if (!opaque_pass || !ctx->on_screen || is_full_canvas_composite_operation(composite_op)) {
+        return false;
+    }
+
+    // the screen is bound while drawing to it
+    if (depth_bits < 0) {
+        GLTRACE(glGetIntegerv(GL_DEPTH_BITS, &depth_bits));
+        LOG("{drawtex} Screen depth bits=%d", depth_bits);
+    }
+    return depth_bits > 0;
+}
 /**
  * @name	draw_textures_item
  * @brief	takes the given options and queues a texture to be drawn.
@@ -59,8 +208,9 @@ static bufobj buffer[MAX_BUFFER_SIZE];
  *			a flush are found.
  * @param	model_view - (matrix_3x3) currently used modelview
  * @param	name - (int) gl texture id
- * @param	src_width - (int) width of the source texture
- * @param	src_height - (int) height of the source texture
+ * @param	src_width - (int) allocated width of the source texture, in the same units as src.
+ *			this is the padded size for power-of-2 textures and the image size otherwise
+ * @param	src_height - (int) allocated height of the source texture, in the same units as src
  * @param	orig_width - (deprecated)
  * @param	orig_height - (deprecated)
  * @param	src - (rect_2d) source rectangle to pull pixels off of from the given texture
@@ -70,18 +220,66 @@ static bufobj buffer[MAX_BUFFER_SIZE];
  * @param	composite_op - (int) coposite operation to use for rendering
  * @param	filter_color - (rgba*) the color object being used by the filter
  * @param	filter_type - (int) the type of filter being used currently
+ * @param	opaque - (bool) true if every texel drawn from src has full alpha,
+ *			see texture_2d_is_opaque_rect()
  * @retval	NONE
  */
-void draw_textures_item(context_2d *ctx, const matrix_3x3 *model_view, int name, int src_width, int src_height, int orig_width, int orig_height, rect_2d src, rect_2d dest, rect_2d clip, float opacity, int composite_op, rgba *filter_color, int filter_type) {
+void draw_textures_item(context_2d *ctx, const matrix_3x3 *model_view, int name, int src_width, int src_height, int orig_width, int orig_height, rect_2d src, rect_2d dest, rect_2d clip, float opacity, int composite_op, rgba *filter_color, int filter_type, bool opaque) {
 
     //ignore this item if clip height is 0
     if (clip.height == 0 || clip.width == 0) {
         return;
     }
 
+    if (use_segment(ctx, composite_op)) {
+        if (opacity <= 0) {
+            return;
+        }
+
+        flush_buffer();
+        if (segment_ctx != ctx || segment_quads == MAX_SEGMENT_QUADS) {
+            flush_segment();
+            segment_ctx = ctx;
+        }
+
+        float x1, y1, x2, y2, x3, y3, x4, y4;
+        matrix_3x3_multiply(model_view, &dest, &x1, &y1, &x2, &y2, &x3, &y3, &x4, &y4);
+        float sMin = src.x / (float)src_width;
+        float tMin = src.y / (float)src_height;
+        float sMax = (src.x + src.width) / (float)src_width;
+        float tMax = (src.y + src.height) / (float)src_height;
+
+        // later quads are nearer, the depth range is split in even steps
+        float z = 1 - 2 * (segment_quads + 1) / (float)(MAX_SEGMENT_QUADS + 1);
+        segment_quads++;
+
+        if (opaque && opacity >= 1 && is_source_over_composite_operation(composite_op)) {
+            opaque_first -= 6;
+            write_segment_quad(opaque_vertices + opaque_first, sMin, tMin, sMax, tMax, x1, y1, x2, y2, x3, y3, x4, y4, z);
+            segment_batch *last = opaque_batch_count ? &opaque_batches[opaque_batch_count - 1] : NULL;
+            if (last && segment_batch_matches(last, name, 1, source_over, filter_color, filter_type)) {
+                last->first = opaque_first;
+                last->count += 6;
+            } else {
+                segment_batch_init(&opaque_batches[opaque_batch_count++], name, 1, source_over, filter_color, filter_type, opaque_first);
+            }
+        } else {
+            write_segment_quad(translucent_vertices + translucent_count, sMin, tMin, sMax, tMax, x1, y1, x2, y2, x3, y3, x4, y4, z);
+            segment_batch *last = translucent_batch_count ? &translucent_batches[translucent_batch_count - 1] : NULL;
+            if (last && segment_batch_matches(last, name, opacity, composite_op, filter_color, filter_type)) {
+                last->count += 6;
+            } else {
+                segment_batch_init(&translucent_batches[translucent_batch_count++], name, opacity, composite_op, filter_color, filter_type, translucent_count);
+            }
+            translucent_count += 6;
+        }
+        return;
+    }
+    flush_segment();
+
     if (name != lastName || bufSize + 2 >= MAX_BUFFER_SIZE || lastOpacity != opacity || composite_op != last_composite_op  || !rgba_equals(&last_filter_color, filter_color) || last_filter_type != filter_type) {
         // TODO: PERFORMANCE: could send opacity to GPU too by interleaving a buffered color array
-        draw_textures_flush();
+        flush_buffer();
         lastName = name;
         lastOpacity = opacity;
         last_composite_op = composite_op;
@@ -133,7 +331,7 @@ void draw_textures_item(context_2d *ctx, const matrix_3x3 *model_view, int name,
     //preparement
     if (is_full_canvas_composite_operation(last_composite_op)) {
         set_up_full_compositing(ctx, (int)x1, (int)y1, (int)(x2 - x1), (int)(y3 - y1), last_composite_op);
-        draw_textures_flush();
+        flush_buffer();
     }
 }
 
@@ -141,12 +339,108 @@ void draw_textures_item(context_2d *ctx, const matrix_3x3 *model_view, int name,
 struct timeval lastFlush, prevTime, now;
 #endif
 
+// Binds the shader for an opacity and filter and the texture to draw from
+static void bind_draw_state(int name, float opacity, int filter_type, const rgba *filter_color) {
+    if (use_single_shader) {
+        tealeaf_shaders_bind(PRIMARY_SHADER);
+        GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, opacity, opacity, opacity, opacity));
+    } else {
+        //TODO: implement filters using filter_type on views properly
+        if (filter_type == FILTER_NONE) {
+            tealeaf_shaders_bind(PRIMARY_SHADER);
+            GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, opacity, opacity, opacity, opacity));
+        } else if (filter_type == FILTER_LINEAR_ADD) {
+            float r = filter_color->r * filter_color->a;
+            float g = filter_color->g * filter_color->a;
+            float b = filter_color->b * filter_color->a;
+            tealeaf_shaders_bind(LINEAR_ADD_SHADER);
+            GLTRACE(glUniform4f(global_shaders[current_shader].add_color, r, g, b, 0));
+            GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, opacity, opacity, opacity, opacity));
+        } else if (filter_type == FILTER_MULTIPLY) {
+            float r = 1 + (filter_color->r - 1) * filter_color->a;
+            float g = 1 + (filter_color->g - 1) * filter_color->a;
+            float b = 1 + (filter_color->b - 1) * filter_color->a;
+            tealeaf_shaders_bind(PRIMARY_SHADER);
+            GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, r * opacity, g * opacity, b * opacity, opacity));
+        } else if (filter_type == FILTER_TINT) {
+            float a = filter_color->a;
+            float t = 1 - a;
+            float r = filter_color->r * a;
+            float g = filter_color->g * a;
+            float b = filter_color->b * a;
+            tealeaf_shaders_bind(LINEAR_ADD_SHADER);
+            GLTRACE(glUniform4f(global_shaders[current_shader].add_color, r, g, b, 0));
+            GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, opacity * t, opacity * t, opacity * t, opacity));
+        }
+
+    }
+
+    GLTRACE(glActiveTexture(GL_TEXTURE0));
+    // filters and wrapping are set where the texture is made, and the min
+    // filter follows the mip levels in texture_manager_tick
+    GLTRACE(glBindTexture(GL_TEXTURE_2D, name));
+}
+
+static void draw_segment_batch(const segment_batch *batch, const segment_vertex *vertices) {
+    const segment_vertex *v = vertices + batch->first;
+    bind_draw_state(batch->name, batch->opacity, batch->filter_type, &batch->filter_color);
+    GLTRACE(glVertexAttribPointer(global_shaders[current_shader].vertex_coords, 3, GL_FLOAT, GL_FALSE, sizeof(segment_vertex), &v->x));
+    GLTRACE(glVertexAttribPointer(global_shaders[current_shader].tex_coords, 2, GL_FLOAT, GL_FALSE, sizeof(segment_vertex), &v->s));
+    GLTRACE(glDrawArrays(GL_TRIANGLES, 0, batch->count));
+}
+
+// Draws the segment held back by the opaque pass, opaque quads first
+static void flush_segment() {
+    int i;
+
+    if (segment_quads == 0) {
+        return;
+    }
+
+    if (opaque_batch_count) {
+        GLTRACE(glDepthMask(GL_TRUE));
+        GLTRACE(glClear(GL_DEPTH_BUFFER_BIT));
+        GLTRACE(glEnable(GL_DEPTH_TEST));
+        GLTRACE(glDepthFunc(GL_LESS));
+        GLTRACE(glDisable(GL_BLEND));
+        for (i = opaque_batch_count - 1; i >= 0; --i) {
+            draw_segment_batch(&opaque_batches[i], opaque_vertices);
+        }
+        GLTRACE(glDepthMask(GL_FALSE));
+    }
+
+    for (i = 0; i < translucent_batch_count; ++i) {
+        apply_composite_operation(translucent_batches[i].composite_op);
+        draw_segment_batch(&translucent_batches[i], translucent_vertices);
+    }
+
+    // other draws expect blending on and no depth test
+    if (opaque_batch_count) {
+        GLTRACE(glDisable(GL_DEPTH_TEST));
+        GLTRACE(glDepthMask(GL_TRUE));
+        GLTRACE(glEnable(GL_BLEND));
+    }
+
+    segment_ctx = NULL;
+    segment_quads = 0;
+    opaque_first = MAX_SEGMENT_QUADS * 6;
+    opaque_batch_count = 0;
+    translucent_count = 0;
+    translucent_batch_count = 0;
+}
+
 /**
  * @name	draw_textures_flush
  * @brief	renders all the textures queued to draw
  * @retval	NONE
  */
 void draw_textures_flush() {
+    flush_buffer();
+    flush_segment();
+}
+
+// Draws the quads buffered since the draw state last changed
+static void flush_buffer() {
     if (bufSize <= 0) {
         return;
     }
@@ -155,47 +449,7 @@ void draw_textures_flush() {
         int stride = sizeof(float) * 4;
 
         apply_composite_operation(last_composite_op);
-
-        if (use_single_shader) {
-            tealeaf_shaders_bind(PRIMARY_SHADER);
-            GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, lastOpacity, lastOpacity, lastOpacity, lastOpacity));
-        } else {
-            //TODO: implement filters using filter_type on views properly
-            if (last_filter_type == FILTER_NONE) {
-                tealeaf_shaders_bind(PRIMARY_SHADER);
-                GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, lastOpacity, lastOpacity, lastOpacity, lastOpacity));
-            } else if (last_filter_type == FILTER_LINEAR_ADD) {
-                float r = last_filter_color.r * last_filter_color.a;
-                float g = last_filter_color.g * last_filter_color.a;
-                float b = last_filter_color.b * last_filter_color.a;
-                tealeaf_shaders_bind(LINEAR_ADD_SHADER);
-                GLTRACE(glUniform4f(global_shaders[current_shader].add_color, r, g, b, 0));
-                GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, lastOpacity, lastOpacity, lastOpacity, lastOpacity));
-            } else if (last_filter_type == FILTER_MULTIPLY) {
-                float r = 1 + (last_filter_color.r - 1) * last_filter_color.a;
-                float g = 1 + (last_filter_color.g - 1) * last_filter_color.a;
-                float b = 1 + (last_filter_color.b - 1) * last_filter_color.a;
-                tealeaf_shaders_bind(PRIMARY_SHADER);
-                GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, r * lastOpacity, g * lastOpacity, b * lastOpacity, lastOpacity));
-            } else if (last_filter_type == FILTER_TINT) {
-                float a = last_filter_color.a;
-                float t = 1 - a;
-                float r = last_filter_color.r * a;
-                float g = last_filter_color.g * a;
-                float b = last_filter_color.b * a;
-                tealeaf_shaders_bind(LINEAR_ADD_SHADER);
-                GLTRACE(glUniform4f(global_shaders[current_shader].add_color, r, g, b, 0));
-                GLTRACE(glUniform4f(global_shaders[current_shader].draw_color, lastOpacity * t, lastOpacity * t, lastOpacity * t, lastOpacity));
-            }
-
-        }
-
-        GLTRACE(glActiveTexture(GL_TEXTURE0));
-        GLTRACE(glBindTexture(GL_TEXTURE_2D, lastName));
-        GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-        GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-        GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        bind_draw_state(lastName, lastOpacity, last_filter_type, &last_filter_color);
         GLTRACE(glVertexAttribPointer(global_shaders[current_shader].vertex_coords, 2, GL_FLOAT, GL_FALSE, stride, ((float *) buffer) + 2));
         //TexCoord0, XY (Also called ST. Also called UV), FLOAT.
         GLTRACE(glVertexAttribPointer(global_shaders[current_shader].tex_coords, 2, GL_FLOAT, GL_FALSE, stride, buffer));
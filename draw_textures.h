@@ -25,8 +25,10 @@ extern "C" {
 #endif
 
 void draw_textures_flush();
-void draw_textures_item(context_2d *ctx, const matrix_3x3 *model_view, int name, int src_width, int src_height, int orig_width, int orig_height, rect_2d src, rect_2d dest, rect_2d clip, float opacity, int composite_op, rgba *filter_color, int filter_type);
+void draw_textures_item(context_2d *ctx, const matrix_3x3 *model_view, int name, int src_width, int src_height, int orig_width, int orig_height, rect_2d src, rect_2d dest, rect_2d clip, float opacity, int composite_op, rgba *filter_color, int filter_type, bool opaque);
 void draw_textures_init();
+void draw_textures_set_opaque_pass(bool enabled);
+bool draw_textures_get_opaque_pass();
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,229 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 etc1.c
+ * @brief	fast ETC1 block encoder for textures decoded on the device
+ */
+#include "core/etc1.h"
+
+/*
+ * An ETC1 block covers 4x4 texels in 8 big-endian bytes.  The block is split
+ * into two 2x4 or 4x2 halves (the flip bit), each with a base color and one of
+ * eight intensity tables.  Base colors are 4 bits per channel each, or a 5-bit
+ * color plus a 3-bit signed delta for the second half (the diff bit).  Every
+ * texel then picks one of the four table offsets, which is added to all three
+ * channels of its half's base color.
+ *
+ * The encoder averages each half for its base color and picks each texel's
+ * offset from the mean channel error, so it makes one pass per table instead
+ * of searching colors.  Quality is below offline tools but it is fast enough
+ * to run on the decode threads.
+ */
+
+static const int m_modifiers[8][4] = {
+    {  2,   8,  -2,   -8},
+    {  5,  17,  -5,  -17},
+    {  9,  29,  -9,  -29},
+    { 13,  42, -13,  -42},
+    { 18,  60, -18,  -60},
+    { 24,  80, -24,  -80},
+    { 33, 106, -33, -106},
+    { 47, 183, -47, -183}
+};
+
+typedef struct etc1_half_t {
+	int base[3];         // Expanded 8-bit base color
+	int table;
+	unsigned int error;
+	unsigned int msb;    // Index bits, already in their block positions
+	unsigned int lsb;
+} etc1_half;
+
+static inline int clamp255(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/**
+ * @name	etc1_get_encoded_size
+ * @brief	bytes of ETC1 data for an image, partial blocks are stored whole
+ * @param	width - (int) width in texels
+ * @param	height - (int) height in texels
+ * @retval	unsigned long - size of the encoded image
+ */
+unsigned long etc1_get_encoded_size(int width, int height) {
+    return (unsigned long)((width + 3) >> 2) * ((height + 3) >> 2) * ETC1_BLOCK_BYTES;
+}
+
+// Picks the table and per-texel offsets for one half of a block
+static void fit_half(const unsigned char block[4][4][3], bool flip, int half, etc1_half *out) {
+    int table;
+
+    out->error = ~0u;
+
+    for (table = 0; table < 8; ++table) {
+        const int *mod = m_modifiers[table];
+        unsigned int error = 0, msb = 0, lsb = 0;
+        int i;
+
+        for (i = 0; i < 8; ++i) {
+            // Texels of the half, in column-major block order for the index bits
+            int x = flip ? (i >> 1) : (half * 2 + (i >> 2));
+            int y = flip ? (half * 2 + (i & 1)) : (i & 3);
+            const unsigned char *texel = block[y][x];
+
+            int target = (texel[0] - out->base[0] + texel[1] - out->base[1] + texel[2] - out->base[2]) / 3;
+            int best = 0, k;
+            for (k = 1; k < 4; ++k) {
+                int da = target - mod[k], db = target - mod[best];
+                if (da * da < db * db) {
+                    best = k;
+                }
+            }
+
+            int dr = clamp255(out->base[0] + mod[best]) - texel[0];
+            int dg = clamp255(out->base[1] + mod[best]) - texel[1];
+            int db = clamp255(out->base[2] + mod[best]) - texel[2];
+            error += dr * dr + dg * dg + db * db;
+
+            int bit = x * 4 + y;
+            msb |= (unsigned int)(best >> 1) << (16 + bit);
+            lsb |= (unsigned int)(best & 1) << bit;
+        }
+
+        if (error < out->error) {
+            out->error = error;
+            out->table = table;
+            out->msb = msb;
+            out->lsb = lsb;
+        }
+    }
+}
+
+static void average_half(const unsigned char block[4][4][3], bool flip, int half, int avg[3]) {
+    int sum[3] = {0, 0, 0};
+    int i, c;
+
+    for (i = 0; i < 8; ++i) {
+        int x = flip ? (i >> 1) : (half * 2 + (i >> 2));
+        int y = flip ? (half * 2 + (i & 1)) : (i & 3);
+        for (c = 0; c < 3; ++c) {
+            sum[c] += block[y][x][c];
+        }
+    }
+
+    for (c = 0; c < 3; ++c) {
+        avg[c] = (sum[c] + 4) >> 3;
+    }
+}
+
+// Encodes one orientation, returning the error and filling in the block words
+static unsigned int encode_orientation(const unsigned char block[4][4][3], bool flip, unsigned int *hi, unsigned int *lo) {
+    int avg[2][3], q[2][3];
+    bool diff = true;
+    int c;
+
+    average_half(block, flip, 0, avg[0]);
+    average_half(block, flip, 1, avg[1]);
+
+    // Prefer the 5-bit differential colors when the halves are close enough
+    for (c = 0; c < 3; ++c) {
+        q[0][c] = (avg[0][c] * 31 + 127) / 255;
+        q[1][c] = (avg[1][c] * 31 + 127) / 255;
+        int delta = q[1][c] - q[0][c];
+        if (delta < -4 || delta > 3) {
+            diff = false;
+        }
+    }
+
+    etc1_half halves[2];
+    for (c = 0; c < 3; ++c) {
+        if (diff) {
+            halves[0].base[c] = (q[0][c] << 3) | (q[0][c] >> 2);
+            halves[1].base[c] = (q[1][c] << 3) | (q[1][c] >> 2);
+        } else {
+            q[0][c] = (avg[0][c] * 15 + 127) / 255;
+            q[1][c] = (avg[1][c] * 15 + 127) / 255;
+            halves[0].base[c] = q[0][c] * 17;
+            halves[1].base[c] = q[1][c] * 17;
+        }
+    }
+
+    fit_half(block, flip, 0, &halves[0]);
+    fit_half(block, flip, 1, &halves[1]);
+
+    unsigned int colors = 0;
+    for (c = 0; c < 3; ++c) {
+        int shift = 24 - c * 8;
+        if (diff) {
+            colors |= (unsigned int)((q[0][c] << 3) | ((q[1][c] - q[0][c]) & 7)) << shift;
+        } else {
+            colors |= (unsigned int)((q[0][c] << 4) | q[1][c]) << shift;
+        }
+    }
+
+    *hi = colors | (halves[0].table << 5) | (halves[1].table << 2) | (diff ? 2 : 0) | (flip ? 1 : 0);
+    *lo = halves[0].msb | halves[1].msb | halves[0].lsb | halves[1].lsb;
+    return halves[0].error + halves[1].error;
+}
+
+static void write_u32_be(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+/**
+ * @name	etc1_encode_image
+ * @brief	encodes the color channels of an image as ETC1.  texels past the
+ *			right and bottom edges of partial blocks repeat the edge texels
+ * @param	pixels - (const unsigned char *) tightly packed 8-bit texels
+ * @param	width - (int) width in texels
+ * @param	height - (int) height in texels
+ * @param	channels - (int) 3 for RGB or 4 for RGBA, alpha is ignored
+ * @param	out - (unsigned char *) buffer of etc1_get_encoded_size() bytes
+ * @retval	NONE
+ */
+void etc1_encode_image(const unsigned char *pixels, int width, int height, int channels, unsigned char *out) {
+    unsigned char block[4][4][3];
+    int bx, by, x, y, c;
+
+    for (by = 0; by < height; by += 4) {
+        for (bx = 0; bx < width; bx += 4) {
+            for (y = 0; y < 4; ++y) {
+                int sy = by + y < height ? by + y : height - 1;
+                for (x = 0; x < 4; ++x) {
+                    int sx = bx + x < width ? bx + x : width - 1;
+                    const unsigned char *texel = pixels + ((long)sy * width + sx) * channels;
+                    for (c = 0; c < 3; ++c) {
+                        block[y][x][c] = texel[c];
+                    }
+                }
+            }
+
+            unsigned int hi, lo, flip_hi, flip_lo;
+            unsigned int error = encode_orientation((const unsigned char (*)[4][3])block, false, &hi, &lo);
+            if (encode_orientation((const unsigned char (*)[4][3])block, true, &flip_hi, &flip_lo) < error) {
+                hi = flip_hi;
+                lo = flip_lo;
+            }
+
+            write_u32_be(out, hi);
+            write_u32_be(out + 4, lo);
+            out += ETC1_BLOCK_BYTES;
+        }
+    }
+}
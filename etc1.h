@@ -0,0 +1,35 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef ETC1_H
+#define ETC1_H
+
+#include "core/types.h"
+#include "core/compressed_texture.h"
+
+#define ETC1_BLOCK_BYTES 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+unsigned long etc1_get_encoded_size(int width, int height);
+void etc1_encode_image(const unsigned char *pixels, int width, int height, int channels, unsigned char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -84,3 +84,20 @@ bool is_full_canvas_composite_operation(int composite_op) {
             composite_op == destination_in || composite_op == destination_atop);
 }
 
+// True if the operation blends like source-over, which leaves opaque pixels as drawn
+bool is_source_over_composite_operation(int composite_op) {
+    switch (composite_op) {
+    case source_atop:
+    case source_in:
+    case source_out:
+    case destination_atop:
+    case destination_in:
+    case destination_out:
+    case destination_over:
+    case lighter:
+        return false;
+
+    default:
+        return true;
+    }
+}
@@ -8,5 +8,6 @@
 void apply_composite_operation(int composite_op);
 void set_up_full_compositing(context_2d *ctx, int x, int y, int width, int height, int composite_op);
 bool is_full_canvas_composite_operation(int composite_op);
+bool is_source_over_composite_operation(int composite_op);
 
 #endif
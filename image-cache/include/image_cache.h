@@ -16,6 +16,7 @@
 #ifndef IMAGE_CACHE_H_
 #define IMAGE_CACHE_H_
 
+#include <stdbool.h>
 #include "uthash/uthash.h"
 
 struct image_data {
@@ -43,6 +44,11 @@ void image_cache_init(const char *path, image_cache_cb);
 void image_cache_destroy();
 void image_cache_remove(const char *url);
 void image_cache_load(const char *url);
+bool image_cache_reload(const char *url);
+
+// Storage for images re-encoded on the device, keyed by the source file contents
+char *image_cache_load_encoded(const void *source, size_t source_size, unsigned int variant, size_t *size);
+bool image_cache_save_encoded(const void *source, size_t source_size, unsigned int variant, const void *bytes, size_t size);
 
 #if __cplusplus
 } //extern C
@@ -78,6 +78,7 @@ void threads_join_thread(ThreadsThread *thread) {
 #define FILENAME_PREFIX "I$"
 #define FILENAME_HASH_BYTES 16 /* = 128 bits */
 #define FILENAME_LENGTH (FILENAME_PREFIX_BYTES + FILENAME_HASH_BYTES*2)
+#define ENCODED_PREFIX "E$" /* re-encoded images, same length as image files */
 
 
 //// Module Internal
@@ -394,14 +395,14 @@ static void clear_work_items() {
 
 static const char *HEX_CONV = "0123456789ABCDEF";
 
-static char *get_filename_from_url(const char *url) {
+static char *get_filename_from_hash(const char *prefix, const void *key, size_t key_len, uint32_t seed) {
     unsigned char result[FILENAME_HASH_BYTES];
 
-    MurmurHash3_x86_128(url, (int)strlen(url), 0, result);
+    MurmurHash3_x86_128(key, (int)key_len, seed, result);
 
     char *filename = malloc(FILENAME_PREFIX_BYTES + FILENAME_HASH_BYTES*2+1);
 
-    memcpy(filename, FILENAME_PREFIX, FILENAME_PREFIX_BYTES);
+    memcpy(filename, prefix, FILENAME_PREFIX_BYTES);
 
     int i;
     for (i = 0; i < FILENAME_HASH_BYTES; ++i) {
@@ -413,6 +414,10 @@ static char *get_filename_from_url(const char *url) {
     return filename;
 }
 
+static char *get_filename_from_url(const char *url) {
+    return get_filename_from_hash(FILENAME_PREFIX, url, strlen(url), FILENAME_SEED);
+}
+
 #define DC 0
 static const unsigned char FROM_HEX[256] = {
     DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // 0-15
@@ -961,16 +966,19 @@ static void clean_cache() {
         while ((entry = readdir(dir))) {
             const char *filename = entry->d_name;
 
-            if (filename[0] == FILENAME_PREFIX[0] &&
-                    filename[1] == FILENAME_PREFIX[1] &&
-                    strlen(filename) == FILENAME_LENGTH) {
+            bool is_image = filename[0] == FILENAME_PREFIX[0] && filename[1] == FILENAME_PREFIX[1];
+            bool is_encoded = filename[0] == ENCODED_PREFIX[0] && filename[1] == ENCODED_PREFIX[1];
+
+            if ((is_image || is_encoded) && strlen(filename) == FILENAME_LENGTH) {
 
                 char *path = get_full_path(filename);
 
                 if (count >= CACHE_MAX_SIZE) {
                     remove(path);
-                    kill_etag_for_url_hash(filename + FILENAME_PREFIX_BYTES);
-                    update_cache = true;
+                    if (is_image) {
+                        kill_etag_for_url_hash(filename + FILENAME_PREFIX_BYTES);
+                        update_cache = true;
+                    }
                     DLOG("{image-cache} Removed cache file %s (ran out of room)", path);
                 } else {
                     struct stat attrib;
@@ -979,8 +987,10 @@ static void clean_cache() {
 
                         if (delta > CACHE_MAX_TIME) {
                             remove(path);
-                            kill_etag_for_url_hash(filename + FILENAME_PREFIX_BYTES);
-                            update_cache = true;
+                            if (is_image) {
+                                kill_etag_for_url_hash(filename + FILENAME_PREFIX_BYTES);
+                                update_cache = true;
+                            }
                             DLOG("{image-cache} Removed cache file %s (file too old %d)", path, delta);
                         } else {
                             ++count;
@@ -1109,6 +1119,7 @@ void image_cache_destroy() {
     clear_cache();
     clear_work_items();
     free(m_file_cache_path);
+    m_file_cache_path = NULL;
 
     LOG("{image-cache} ...Good night.");
 }
@@ -1157,3 +1168,91 @@ void image_cache_load(const char *url) {
     pthread_cond_signal(&m_request_cond);
     pthread_mutex_unlock(&m_request_mutex);
 }
+
+// Like image_cache_load but only from the disk cache, returning false if the
+// image is not there.  Used to decode an image again, for example at another size
+bool image_cache_reload(const char *url) {
+    if (!image_exists_in_cache(url)) {
+        return false;
+    }
+
+    DLOG("{image-cache} Reloading from cache: %s", url);
+    queue_work_item(url, 0, 0, true, false);
+    return true;
+}
+
+/*
+ * Encoded images are derived from image file contents, such as a texture
+ * compressed on the device, and live next to the cached images so they share
+ * the same expiry.  They are keyed by a hash of the source file contents so
+ * they never go stale, and the variant tells apart encodings of one source.
+ */
+
+char *image_cache_load_encoded(const void *source, size_t source_size, unsigned int variant, size_t *size) {
+    if (!m_file_cache_path) {
+        return NULL;
+    }
+
+    char *filename = get_filename_from_hash(ENCODED_PREFIX, source, source_size, variant);
+    char *path = get_full_path(filename);
+    char *bytes = NULL;
+
+    pthread_mutex_lock(&m_file_io_mutex);
+
+    FILE *f = fopen(path, "rb");
+    if (f) {
+        long len = -1;
+        if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+            bytes = (char *)malloc((size_t)len);
+            if (bytes && fread(bytes, 1, (size_t)len, f) == (size_t)len) {
+                *size = (size_t)len;
+                DLOG("{image-cache} Read encoded image %s bytes=%d", path, (int)len);
+            } else {
+                free(bytes);
+                bytes = NULL;
+            }
+        }
+        fclose(f);
+    }
+
+    pthread_mutex_unlock(&m_file_io_mutex);
+
+    free(filename);
+    free(path);
+    return bytes;
+}
+
+bool image_cache_save_encoded(const void *source, size_t source_size, unsigned int variant, const void *bytes, size_t size) {
+    if (!m_file_cache_path) {
+        return false;
+    }
+
+    bool success = true;
+    char *filename = get_filename_from_hash(ENCODED_PREFIX, source, source_size, variant);
+    char *path = get_full_path(filename);
+
+    pthread_mutex_lock(&m_file_io_mutex);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        LOG("{image-cache} WARNING: Unable to open to save file %s errno=%d", path, errno);
+        success = false;
+    } else {
+        size_t bytes_written = fwrite(bytes, 1, size, f);
+        fclose(f);
+
+        if (bytes_written != size) {
+            success = false;
+            LOG("{image-cache} ERROR: Wrote %zu but expected %zu bytes for %s errno=%d", bytes_written, size, path, errno);
+            remove(path);
+        } else {
+            DLOG("{image-cache} Saved encoded image %s bytes=%d", path, (int)size);
+        }
+    }
+
+    pthread_mutex_unlock(&m_file_io_mutex);
+
+    free(filename);
+    free(path);
+    return success;
+}
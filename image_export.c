@@ -0,0 +1,316 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 image_export.c
+ * @brief	PNG and JPEG exports encoded on a worker thread
+ */
+#include "core/image_export.h"
+#include "core/image_writer.h"
+#include "core/buffer_pool.h"
+#include "core/events.h"
+#include "core/list.h"
+#include "core/log.h"
+#include "core/platform/threads.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct image_export_job_t {
+    int id;
+    unsigned char *pixels; // freed once encoded
+    int width;
+    int height;
+    int channels;
+    char *path;            // NULL for Base64 exports
+    char *name;            // file name, or the image type for Base64
+    char *base64;
+    bool ok;
+    bool cancelled;        // canceled while encoding, the result is dropped
+
+    struct image_export_job_t *next;
+    struct image_export_job_t *prev;
+} image_export_job;
+
+static pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t m_queued_cond = PTHREAD_COND_INITIALIZER;
+static image_export_job *m_queue = NULL;
+static image_export_job *m_done = NULL;
+static image_export_job *m_encoding = NULL;
+static int m_queued_count = 0;
+static int m_next_id = 1;
+static ThreadsThread m_thread = THREADS_INVALID_THREAD;
+static bool m_running = false;
+static bool m_stopping = false; // image_export_shutdown() is joining the worker, new jobs are refused
+
+static void destroy_job(image_export_job *job) {
+    buffer_pool_release(job->pixels);
+    free(job->path);
+    free(job->name);
+    free(job->base64);
+    free(job);
+}
+
+static void image_export_run(void *unused) {
+    pthread_mutex_lock(&m_mutex);
+
+    while (m_running) {
+        image_export_job *job = m_queue;
+        if (!job) {
+            pthread_cond_wait(&m_queued_cond, &m_mutex);
+            continue;
+        }
+
+        LIST_REMOVE(&m_queue, job);
+        --m_queued_count;
+        m_encoding = job;
+        pthread_mutex_unlock(&m_mutex);
+
+        if (job->path) {
+            job->ok = write_image_to_file(job->path, job->name, job->pixels, job->width, job->height, job->channels);
+        } else {
+            job->base64 = write_image_to_base64(job->name, job->pixels, job->width, job->height, job->channels);
+            job->ok = job->base64 != NULL;
+        }
+        buffer_pool_release(job->pixels);
+        job->pixels = NULL;
+
+        pthread_mutex_lock(&m_mutex);
+        m_encoding = NULL;
+        if (job->cancelled) {
+            destroy_job(job);
+        } else {
+            LIST_ADD(&m_done, job);
+        }
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+}
+
+static int queue_job(image_export_job *job) {
+    int id = 0;
+
+    pthread_mutex_lock(&m_mutex);
+    if (!m_stopping && m_queued_count < IMAGE_EXPORT_MAX_QUEUED) {
+        if (!m_running) {
+            m_running = true;
+            m_thread = threads_create_thread(image_export_run, NULL);
+        }
+        id = job->id = m_next_id++;
+        LIST_ADD(&m_queue, job);
+        ++m_queued_count;
+        pthread_cond_signal(&m_queued_cond);
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    return id;
+}
+
+// Gives the pixels back to a caller whose job was refused
+static void refuse_job(image_export_job *job) {
+    job->pixels = NULL;
+    destroy_job(job);
+}
+
+static image_export_job *new_job(unsigned char *pixels, int width, int height, int channels, const char *path, const char *name) {
+    if (!pixels || !name) {
+        return NULL;
+    }
+
+    image_export_job *job = (image_export_job *)calloc(1, sizeof(image_export_job));
+    if (!job) {
+        return NULL;
+    }
+    job->pixels = pixels;
+    job->width = width;
+    job->height = height;
+    job->channels = channels;
+    job->path = path ? strdup(path) : NULL;
+    job->name = strdup(name);
+
+    // out of memory, the caller keeps the pixels as for any refusal
+    if (!job->name || (path && !job->path)) {
+        refuse_job(job);
+        return NULL;
+    }
+    return job;
+}
+
+/**
+ * @name	image_export_queue_file
+ * @brief	queues pixels to be written to a file, PNG or JPEG by the file's extension
+ * @param	pixels - (unsigned char *) pixels from malloc or buffer_pool_alloc(), owned
+ *			by the export unless it is refused
+ * @param	width - (int) width in pixels
+ * @param	height - (int) height in pixels
+ * @param	channels - (int) 3 or 4
+ * @param	path - (const char *) directory to write to
+ * @param	name - (const char *) file name, ending in .png, .jpg or .jpeg
+ * @retval	int - id of the export for its event and image_export_cancel(), 0 if refused
+ */
+int image_export_queue_file(unsigned char *pixels, int width, int height, int channels, const char *path, const char *name) {
+    image_export_job *job = new_job(pixels, width, height, channels, path, name);
+    if (!job || !path) {
+        if (job) {
+            refuse_job(job);
+        }
+        return 0;
+    }
+
+    const int id = queue_job(job);
+    if (!id) {
+        LOG("{export} WARNING: Too many exports queued, refusing %s", name);
+        refuse_job(job);
+    }
+    return id;
+}
+
+/**
+ * @name	image_export_queue_base64
+ * @brief	queues pixels to be encoded as Base64 text for the completion event
+ * @param	pixels - (unsigned char *) pixels from malloc or buffer_pool_alloc(), owned
+ *			by the export unless it is refused
+ * @param	width - (int) width in pixels
+ * @param	height - (int) height in pixels
+ * @param	channels - (int) 3 or 4
+ * @param	image_type - (const char *) "PNG", "JPG" or "JPEG"
+ * @retval	int - id of the export for its event and image_export_cancel(), 0 if refused
+ */
+int image_export_queue_base64(unsigned char *pixels, int width, int height, int channels, const char *image_type) {
+    image_export_job *job = new_job(pixels, width, height, channels, NULL, image_type);
+    if (!job) {
+        return 0;
+    }
+
+    const int id = queue_job(job);
+    if (!id) {
+        LOG("{export} WARNING: Too many exports queued, refusing a %s", image_type);
+        refuse_job(job);
+    }
+    return id;
+}
+
+/**
+ * @name	image_export_cancel
+ * @brief	drops an export, no event is dispatched for it
+ * @param	id - (int) id from one of the queue functions
+ * @retval	bool - false if it already finished or is unknown, an export
+ *			being encoded is dropped afterwards but a file export still writes its file
+ */
+bool image_export_cancel(int id) {
+    image_export_job *job = NULL;
+    bool found = false;
+
+    pthread_mutex_lock(&m_mutex);
+    if (m_encoding && m_encoding->id == id) {
+        m_encoding->cancelled = true;
+        found = true;
+    } else {
+        image_export_job *item = m_queue;
+        while (item) {
+            if (item->id == id) {
+                job = item;
+                break;
+            }
+            LIST_ITERATE(&m_queue, item);
+        }
+        if (job) {
+            LIST_REMOVE(&m_queue, job);
+            --m_queued_count;
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    if (job) {
+        destroy_job(job);
+    }
+    return found;
+}
+
+static void notify_export(image_export_job *job) {
+    const size_t data_len = job->base64 ? strlen(job->base64) : 0;
+    const size_t event_len = data_len + 128;
+    char *event_str = (char *)malloc(event_len);
+    if (!event_str) {
+        return;
+    }
+
+    if (job->base64) {
+        snprintf(event_str, event_len, "{\"id\":%d,\"ok\":true,\"data\":\"%s\",\"name\":\"imageExport\",\"priority\":0}", job->id, job->base64);
+    } else {
+        snprintf(event_str, event_len, "{\"id\":%d,\"ok\":%s,\"name\":\"imageExport\",\"priority\":0}", job->id, job->ok ? "true" : "false");
+    }
+    core_dispatch_event(event_str);
+    free(event_str);
+}
+
+/**
+ * @name	image_export_tick
+ * @brief	dispatches events for finished exports, call on the JS thread
+ * @retval	NONE
+ */
+void image_export_tick() {
+    image_export_job *done;
+
+    pthread_mutex_lock(&m_mutex);
+    done = m_done;
+    m_done = NULL;
+    pthread_mutex_unlock(&m_mutex);
+
+    // oldest first, the list adds at the tail
+    while (done) {
+        image_export_job *job = done;
+        LIST_REMOVE(&done, job);
+        notify_export(job);
+        destroy_job(job);
+    }
+}
+
+/**
+ * @name	image_export_shutdown
+ * @brief	stops the worker after the export it is encoding, drops the rest without events.
+ *			exports queued while it stops are refused
+ * @retval	NONE
+ */
+void image_export_shutdown() {
+    pthread_mutex_lock(&m_mutex);
+    if (!m_running) {
+        pthread_mutex_unlock(&m_mutex);
+        return;
+    }
+    m_running = false;
+    m_stopping = true;
+    pthread_cond_signal(&m_queued_cond);
+    pthread_mutex_unlock(&m_mutex);
+
+    threads_join_thread(&m_thread);
+
+    pthread_mutex_lock(&m_mutex);
+    while (m_queue) {
+        image_export_job *job = m_queue;
+        LIST_REMOVE(&m_queue, job);
+        destroy_job(job);
+    }
+    while (m_done) {
+        image_export_job *job = m_done;
+        LIST_REMOVE(&m_done, job);
+        destroy_job(job);
+    }
+    m_queued_count = 0;
+    m_stopping = false;
+    pthread_mutex_unlock(&m_mutex);
+}
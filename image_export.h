@@ -0,0 +1,48 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef IMAGE_EXPORT_H
+#define IMAGE_EXPORT_H
+
+#include "core/types.h"
+
+/*
+ * Image exports encoded on a worker thread, so saving or sharing a canvas does
+ * not stall the frame.  A job owns the pixels read back from GL, encodes them
+ * as a PNG or JPEG and writes a file or Base64 text.  image_export_tick()
+ * then dispatches an event on the JS thread:
+ *
+ *   {"id":3,"ok":true,"data":"iVBORw0...","name":"imageExport","priority":0}
+ *
+ * "data" is only there for Base64 exports.  At most IMAGE_EXPORT_MAX_QUEUED
+ * jobs wait behind the one being encoded, further jobs are refused.
+ */
+#define IMAGE_EXPORT_MAX_QUEUED 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int image_export_queue_file(unsigned char *pixels, int width, int height, int channels, const char *path, const char *name);
+int image_export_queue_base64(unsigned char *pixels, int width, int height, int channels, const char *image_type);
+bool image_export_cancel(int id);
+void image_export_tick();
+void image_export_shutdown();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,122 +14,474 @@
  */
 
 #include "core/image_loader.h"
+#include "core/compressed_texture.h"
+#include "core/texture_2d.h"
+#include "core/buffer_pool.h"
+#include "core/base64.h"
+#include "core/qoi.h"
+#include "platform/gl.h"
 #include "log.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
 
 #include "core/deps/turbojpeg/turbojpeg.h"
+#include "core/deps/turbojpeg/jpeglib.h"
 
 #define TEXTURE_LOAD_ERROR 0
 
 
-//// Conversion from Base64
-
-#define DC 0
-
-static const unsigned char FROM_BASE64[256] = {
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // 0-15
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // 16-31
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, 62, DC, DC, DC, 63, // 32-47
-    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, DC, DC, DC, DC, DC, DC, // 48-63
-    DC, 0 , 1 , 2 , 3 , 4 , 5 , 6 , 7 , 8 , 9 , 10, 11, 12, 13, 14, // 64-79
-    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, DC, DC, DC, DC, DC, // 80-95
-    DC, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, // 96-111
-    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, DC, DC, DC, DC, DC, // 112-127
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // 128-
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // Extended
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // ASCII
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // Extended
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // ASCII
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // Extended
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, // ASCII
-    DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC, DC
-};
+unsigned short readShort(unsigned char *bits) {
+    return (bits[0] << 8) + bits[1];
+}
+
+
+//// KTX containers
+
+/*
+ * KTX 1 and KTX 2 files hold one format each.  To ship several formats of an
+ * image in one asset, KTX files may be concatenated, each starting on a
+ * 4-byte boundary, and the best one the GPU supports is used.  Only 2D
+ * textures without supercompression are read.
+ */
+
+#define KTX_MAX_LEVELS 16
+#define KTX_MAX_IMAGES 8
+
+static const unsigned char KTX1_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+typedef struct ktx_image_t {
+    int compression_type; // zero for uncompressed 8-bit texels
+    int channels;
+    int width;
+    int height;
+    int num_levels;
+    int row_alignment; // rows of uncompressed levels start on this many bytes, 4 in KTX 1
+    const unsigned char *levels[KTX_MAX_LEVELS];
+    unsigned long level_sizes[KTX_MAX_LEVELS];
+    unsigned long end; // offset just past the image in the file
+} ktx_image;
+
+static unsigned int ktx_read_u32(const unsigned char *p, bool swap) {
+    if (swap) {
+        return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+    }
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long ktx_read_u64(const unsigned char *p) {
+    return (unsigned long long)ktx_read_u32(p, false) | ((unsigned long long)ktx_read_u32(p + 4, false) << 32);
+}
+
+// Bytes per row of an uncompressed level including the padding KTX 1 adds
+static unsigned long ktx_row_bytes(const ktx_image *image, int width) {
+    unsigned long align = (unsigned long)image->row_alignment;
+    return ((unsigned long)width * image->channels + align - 1) / align * align;
+}
 
-#undef DC
+// Maps the Vulkan formats KTX 2 uses to GL internal formats, zero if unknown
+static int ktx2_get_compression_type(unsigned int vk_format, int *channels) {
+    *channels = 4;
 
+    if (vk_format >= 157 && vk_format <= 184) { // VK_FORMAT_ASTC_4x4_UNORM_BLOCK...
+        unsigned int i = (vk_format - 157) >> 1;
+        return (vk_format & 1) ? GL_COMPRESSED_RGBA_ASTC_4x4_KHR + i : GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR + i;
+    }
 
-static int GetBinaryLengthFromBase64Length(const char *encoded_buffer, int bytes) {
-    if (bytes <= 0) {
+    switch (vk_format) {
+    case 131: case 132: // VK_FORMAT_BC1_RGB_*_BLOCK
+        *channels = 3;
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case 133: case 134:
+        return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case 135: case 136:
+        return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+    case 137: case 138:
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case 147: // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK
+        *channels = 3;
+        return GL_COMPRESSED_RGB8_ETC2;
+    case 148:
+        *channels = 3;
+        return GL_COMPRESSED_SRGB8_ETC2;
+    case 149:
+        return GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+    case 150:
+        return GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+    case 151:
+        return GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case 152:
+        return GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+    default:
         return 0;
     }
+}
 
-    // Skip characters from end until one is a valid BASE64 character
-    while (bytes >= 1) {
-        unsigned char ch = encoded_buffer[bytes - 1];
+static bool ktx_check_levels(ktx_image *image, const unsigned char *bits, unsigned long length) {
+    int level;
 
-        if (ch == '0' || FROM_BASE64[ch] != 0) {
-            break;
+    if (image->width <= 0 || image->height <= 0 || image->num_levels <= 0) {
+        return false;
+    }
+
+    for (level = 0; level < image->num_levels; ++level) {
+        int width = image->width >> level, height = image->height >> level;
+        unsigned long expected = image->compression_type ?
+            compressed_texture_get_size(image->compression_type, width ? width : 1, height ? height : 1) :
+            ktx_row_bytes(image, width ? width : 1) * (height ? height : 1);
+
+        if (image->level_sizes[level] < expected || image->levels[level] < bits ||
+            (unsigned long)(image->levels[level] - bits) + image->level_sizes[level] > length) {
+            return false;
+        }
+        image->level_sizes[level] = expected;
+    }
+
+    return true;
+}
+
+static bool parse_ktx1(const unsigned char *bits, unsigned long length, ktx_image *image) {
+    if (length < 64) {
+        return false;
+    }
+
+    unsigned int endianness = ktx_read_u32(bits + 12, false);
+    bool swap = endianness == 0x01020304;
+    if (!swap && endianness != 0x04030201) {
+        return false;
+    }
+
+    unsigned int gl_type = ktx_read_u32(bits + 16, swap);
+    unsigned int gl_format = ktx_read_u32(bits + 24, swap);
+    unsigned int internal_format = ktx_read_u32(bits + 28, swap);
+    unsigned int kv_bytes = ktx_read_u32(bits + 60, swap);
+    unsigned int num_levels = ktx_read_u32(bits + 56, swap);
+
+    image->width = (int)ktx_read_u32(bits + 36, swap);
+    image->height = (int)ktx_read_u32(bits + 40, swap);
+    image->num_levels = num_levels ? (int)num_levels : 1;
+    image->row_alignment = 4;
+
+    if (ktx_read_u32(bits + 44, swap) > 1 || ktx_read_u32(bits + 48, swap) != 0 || ktx_read_u32(bits + 52, swap) != 1 ||
+        image->num_levels > KTX_MAX_LEVELS || kv_bytes > length - 64) {
+        return false;
+    }
+
+    if (gl_type == 0) {
+        image->compression_type = (int)internal_format;
+        image->channels = (internal_format == GL_ETC1_RGB8_OES || internal_format == GL_COMPRESSED_RGB8_ETC2 ||
+                           internal_format == GL_COMPRESSED_SRGB8_ETC2 || internal_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) ? 3 : 4;
+        if (!compressed_texture_get_size(image->compression_type, 1, 1)) {
+            return false;
         }
+    } else if (gl_type == GL_UNSIGNED_BYTE && (gl_format == GL_RGBA || gl_format == GL_RGB || gl_format == GL_LUMINANCE)) {
+        image->compression_type = 0;
+        image->channels = gl_format == GL_RGBA ? 4 : gl_format == GL_RGB ? 3 : 1;
+    } else {
+        return false;
+    }
 
-        --bytes;
+    // Each level is its size then its data, padded to 4 bytes
+    unsigned long offset = 64 + kv_bytes;
+    int level;
+    for (level = 0; level < image->num_levels; ++level) {
+        if (offset + 4 > length) {
+            return false;
+        }
+        unsigned long size = ktx_read_u32(bits + offset, swap);
+        image->levels[level] = bits + offset + 4;
+        image->level_sizes[level] = size;
+        offset += 4 + ((size + 3) & ~3UL);
     }
+    image->end = offset;
 
-    return (bytes * 3) / 4;
+    return ktx_check_levels(image, bits, length);
 }
 
-static int ReadBase64(const char *encoded_buffer, int encoded_bytes, void *decoded_buffer, int decoded_bytes) {
-    // Skip characters from end until one is a valid BASE64 character
-    while (encoded_bytes >= 1) {
-        unsigned char ch = encoded_buffer[encoded_bytes - 1];
+static bool parse_ktx2(const unsigned char *bits, unsigned long length, ktx_image *image) {
+    if (length < 80) {
+        return false;
+    }
 
-        if (ch == '0' || FROM_BASE64[ch] != 0) {
-            break;
+    unsigned int num_levels = ktx_read_u32(bits + 40, false);
+    image->width = (int)ktx_read_u32(bits + 20, false);
+    image->height = (int)ktx_read_u32(bits + 24, false);
+    image->num_levels = num_levels ? (int)num_levels : 1;
+    image->row_alignment = 1;
+
+    if (ktx_read_u32(bits + 28, false) > 1 || ktx_read_u32(bits + 32, false) > 1 || ktx_read_u32(bits + 36, false) != 1 ||
+        ktx_read_u32(bits + 44, false) != 0 || image->num_levels > KTX_MAX_LEVELS ||
+        80 + (unsigned long)image->num_levels * 24 > length) {
+        return false;
+    }
+
+    unsigned int vk_format = ktx_read_u32(bits + 12, false);
+    if (vk_format == 37 || vk_format == 43) { // VK_FORMAT_R8G8B8A8_UNORM / _SRGB
+        image->compression_type = 0;
+        image->channels = 4;
+    } else if (vk_format == 23 || vk_format == 29) { // VK_FORMAT_R8G8B8_UNORM / _SRGB
+        image->compression_type = 0;
+        image->channels = 3;
+    } else if (!(image->compression_type = ktx2_get_compression_type(vk_format, &image->channels))) {
+        return false;
+    }
+
+    // The file ends after whichever of the levels and metadata comes last
+    unsigned long long end = (unsigned long long)ktx_read_u32(bits + 48, false) + ktx_read_u32(bits + 52, false);
+    unsigned long long kvd_end = (unsigned long long)ktx_read_u32(bits + 56, false) + ktx_read_u32(bits + 60, false);
+    unsigned long long sgd_end = ktx_read_u64(bits + 64) + ktx_read_u64(bits + 72);
+    end = end > kvd_end ? end : kvd_end;
+    end = end > sgd_end ? end : sgd_end;
+
+    int level;
+    for (level = 0; level < image->num_levels; ++level) {
+        const unsigned char *entry = bits + 80 + level * 24;
+        unsigned long long offset = ktx_read_u64(entry);
+        unsigned long long size = ktx_read_u64(entry + 8);
+        if (offset > length || size > length - offset) {
+            return false;
         }
+        image->levels[level] = bits + offset;
+        image->level_sizes[level] = (unsigned long)size;
+        end = end > offset + size ? end : offset + size;
+    }
+    image->end = (unsigned long)end;
+
+    return ktx_check_levels(image, bits, length);
+}
+
+static bool is_ktx(const unsigned char *bits, unsigned long length) {
+    return length >= 12 && (!memcmp(bits, KTX1_IDENTIFIER, 12) || !memcmp(bits, KTX2_IDENTIFIER, 12));
+}
 
-        --encoded_bytes;
+/*
+ * Loads the best image of a KTX file for this GPU.  Compressed data comes back
+ * as it is with all its levels laid out one after another, uncompressed or
+ * CPU-decoded data has the base level only.
+ */
+static unsigned char *load_ktx_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels, long *size, int *compression_type, int *num_levels) {
+    ktx_image images[KTX_MAX_IMAGES];
+    int count = 0, best = -1, best_upload = 0, i;
+    unsigned long offset = 0;
+
+    // Read every image in the file
+    while (count < KTX_MAX_IMAGES && offset < (unsigned long)bits_length && is_ktx(bits + offset, bits_length - offset)) {
+        const unsigned char *start = bits + offset;
+        unsigned long remaining = bits_length - offset;
+        ktx_image *image = &images[count];
+        bool ok = start[5] == '1' ? parse_ktx1(start, remaining, image) : parse_ktx2(start, remaining, image);
+        if (!ok) {
+            LOG("{resources} WARNING: Skipping unsupported KTX image %d", count);
+            break;
+        }
+        offset += (image->end + 3) & ~3UL;
+        ++count;
     }
 
-    if (encoded_bytes <= 0 || decoded_bytes <= 0 ||
-            decoded_bytes < (encoded_bytes * 3) / 4) {
-        return 0;
+    // Pick the most preferred format the GPU samples directly
+    for (i = 0; i < count; ++i) {
+        int upload_type = 0;
+        if (images[i].compression_type && compressed_texture_is_supported(images[i].compression_type, &upload_type) &&
+            (best < 0 || compressed_texture_get_family(images[i].compression_type) < compressed_texture_get_family(images[best].compression_type))) {
+            best = i;
+            best_upload = upload_type;
+        }
     }
 
-    const unsigned char *from = (const unsigned char*)( encoded_buffer );
-    unsigned char *to = (unsigned char*)( decoded_buffer );
+    if (best >= 0) {
+        ktx_image *image = &images[best];
+
+        // ES 2 samples only complete power-of-2 mip chains
+        int full_levels = 1, w = image->width, h = image->height;
+        while (w > 1 || h > 1) {
+            w >>= 1;
+            h >>= 1;
+            ++full_levels;
+        }
+        bool po2 = !(image->width & (image->width - 1)) && !(image->height & (image->height - 1));
+        int levels = image->num_levels;
+        if (levels < full_levels || (!po2 && !(texture_2d_gl_caps & TEXTURE_CAP_ETC2))) {
+            levels = 1;
+        } else {
+            levels = full_levels;
+        }
 
-    unsigned char a, b, c, d;
+        unsigned long total = 0;
+        for (i = 0; i < levels; ++i) {
+            total += image->level_sizes[i];
+        }
 
-    int ii, jj, end;
-    for (ii = 0, jj = 0, end = encoded_bytes - 3; ii < end; ii += 4, jj += 3) {
-        a = FROM_BASE64[from[ii]];
-        b = FROM_BASE64[from[ii+1]];
-        c = FROM_BASE64[from[ii+2]];
-        d = FROM_BASE64[from[ii+3]];
+        unsigned char *data = (unsigned char *)malloc(total);
+        if (!data) {
+            return NULL;
+        }
+        unsigned char *out = data;
+        for (i = 0; i < levels; ++i) {
+            memcpy(out, image->levels[i], image->level_sizes[i]);
+            out += image->level_sizes[i];
+        }
 
-        to[jj] = (a << 2) | (b >> 4);
-        to[jj+1] = (b << 4) | (c >> 2);
-        to[jj+2] = (c << 6) | d;
+        *width = image->width;
+        *height = image->height;
+        *channels = image->channels;
+        *size = (long)total;
+        *compression_type = best_upload;
+        *num_levels = levels;
+        return data;
     }
 
-    switch (encoded_bytes & 3) {
-    case 3: // 3 characters left
-        a = FROM_BASE64[from[ii]];
-        b = FROM_BASE64[from[ii+1]];
-        c = FROM_BASE64[from[ii+2]];
+    // Otherwise decode the base level of the first image we can read
+    for (i = 0; i < count; ++i) {
+        ktx_image *image = &images[i];
+        unsigned char *data = NULL;
+        int decoded_channels = image->channels;
+
+        if (image->compression_type) {
+            data = compressed_texture_decompress(image->compression_type, image->levels[0], image->level_sizes[0],
+                                                 image->width, image->height, &decoded_channels);
+            if (data) {
+                LOG("{resources} WARNING: Decoding KTX format 0x%x on the CPU", image->compression_type);
+            }
+        } else {
+            // Drop the row padding, texels come back tightly packed
+            const unsigned long row_bytes = (unsigned long)image->width * image->channels;
+            const unsigned long stride = ktx_row_bytes(image, image->width);
+            data = (unsigned char *)malloc(row_bytes * image->height);
+            if (data) {
+                int y;
+                for (y = 0; y < image->height; ++y) {
+                    memcpy(data + y * row_bytes, image->levels[0] + y * stride, row_bytes);
+                }
+            }
+        }
+
+        if (data) {
+            *width = image->width;
+            *height = image->height;
+            *channels = decoded_channels;
+            *size = (long)image->width * image->height * decoded_channels;
+            return data;
+        }
+    }
 
-        to[jj] = (a << 2) | (b >> 4);
-        to[jj+1] = (b << 4) | (c >> 2);
-        return jj+2;
+    LOG("{resources} WARNING: No KTX image in a format this device can use");
+    return NULL;
+}
 
-    case 2: // 2 characters left
-        a = FROM_BASE64[from[ii]];
-        b = FROM_BASE64[from[ii+1]];
+//// Header probe
+
+static unsigned int read_u32_be(const unsigned char *p) {
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
 
-        to[jj] = (a << 2) | (b >> 4);
-        return jj+1;
+// Walks the chunks ahead of the image data, a palette with transparency
+// expands to RGBA like load_png_from_memory does
+static bool probe_png(const unsigned char *bits, long bits_length, int *width, int *height, int *channels) {
+    if (bits_length < 33 || memcmp(bits + 12, "IHDR", 4)) {
+        return false;
     }
 
-    return jj;
+    *width = (int)read_u32_be(bits + 16);
+    *height = (int)read_u32_be(bits + 20);
+    const int color_type = bits[25];
+    switch (color_type) {
+    case PNG_COLOR_TYPE_GRAY: *channels = 1; break;
+    case PNG_COLOR_TYPE_GRAY_ALPHA: *channels = 2; break;
+    case PNG_COLOR_TYPE_RGB_ALPHA: *channels = 4; break;
+    default: *channels = 3; break;
+    }
+
+    if (color_type == PNG_COLOR_TYPE_PALETTE) {
+        long offset = 8;
+        while (offset + 8 <= bits_length) {
+            const unsigned char *chunk = bits + offset;
+            if (!memcmp(chunk + 4, "tRNS", 4)) {
+                *channels = 4;
+                break;
+            } else if (!memcmp(chunk + 4, "IDAT", 4)) {
+                break;
+            }
+            // length, type, data and CRC
+            const long length = (long)read_u32_be(chunk);
+            if (length < 0 || length > bits_length) {
+                break;
+            }
+            offset += 12 + length;
+        }
+    }
+    return *width > 0 && *height > 0;
 }
 
-unsigned short readShort(unsigned char *bits) {
-    return (bits[0] << 8) + bits[1];
+// Finds the start of frame marker, which follows the tables
+static bool probe_jpg(const unsigned char *bits, long bits_length, int *width, int *height, int *channels) {
+    long offset = 2;
+    while (offset + 4 <= bits_length) {
+        if (bits[offset] != 0xFF) {
+            return false;
+        }
+
+        const unsigned char marker = bits[offset + 1];
+        if (marker == 0xFF) {
+            // fill byte
+            ++offset;
+            continue;
+        } else if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            // standalone markers carry no length
+            offset += 2;
+            continue;
+        } else if (marker == 0xD9 || marker == 0xDA) {
+            // end of image or start of scan before any frame
+            return false;
+        }
+
+        const long length = ((long)bits[offset + 2] << 8) | bits[offset + 3];
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (offset + 9 > bits_length) {
+                return false;
+            }
+            *height = (bits[offset + 5] << 8) | bits[offset + 6];
+            *width = (bits[offset + 7] << 8) | bits[offset + 8];
+            // decoded to RGB whatever the components
+            *channels = 3;
+            return *width > 0 && *height > 0;
+        }
+        offset += 2 + length;
+    }
+    return false;
+}
+
+/*
+ * Reads the size of a PNG, JPEG, QOI or PKM image from its header without
+ * decoding it.  channels is the count the decode gives.  Returns false for
+ * other formats or a header that does not parse.
+ */
+bool probe_image_from_memory(const unsigned char *bits, long bits_length, int *width, int *height, int *channels) {
+    if (!bits || bits_length < 16) {
+        return false;
+    }
+
+    if (!png_sig_cmp((png_bytep)bits, 0, 8)) {
+        return probe_png(bits, bits_length, width, height, channels);
+    } else if (!strncmp("PKM 10", (const char*) bits, 6)) {
+        // same size as load_image_from_memory reports
+        *width = readShort((unsigned char *)bits + 8);
+        *height = readShort((unsigned char *)bits + 10);
+        *channels = 3;
+        return *width > 0 && *height > 0;
+    } else if (bits[0] == 0xFF && bits[1] == 0xD8) {
+        return probe_jpg(bits, bits_length, width, height, channels);
+    } else if (!memcmp(bits, "qoif", 4)) {
+        return qoi_read_header(bits, (unsigned long)bits_length, width, height, channels);
+    }
+    return false;
 }
 
-unsigned char *load_image_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels, long *size, int *compression_type) {
+unsigned char *load_image_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels, long *size, int *compression_type, int *num_levels) {
     unsigned char *data = NULL;
     *size = 0;
     *compression_type = 0;
+    *num_levels = 1;
 
     // must have at least 8 bytes be read
     if (bits_length >= 8) {
@@ -139,6 +491,7 @@ unsigned char *load_image_from_memory(unsigned char *bits, long bits_length, int
         int is_png = !png_sig_cmp(header, 0, 8);
         int is_pkm = !is_png && !strncmp("PKM 10", (char*) header, 6);
         int is_jpg = !is_png && !is_pkm && header[0] == 0xFF && header[1] == 0xD8;
+        int is_qoi = !memcmp("qoif", header, 4);
 
         if (is_png) {
             data = load_png_from_memory(bits, bits_length, width, height, channels);
@@ -152,17 +505,28 @@ unsigned char *load_image_from_memory(unsigned char *bits, long bits_length, int
             // originalWidth -> 2 bytes
             // originalHeight -> 2 bytes
             if (bits_length > sizeof(unsigned char) * 16) {
-                *compression_type = 36196;// Opengl Constant for GL_ETC1_RGB8_OES (ETC1 compression)
+                int upload_type;
                 *channels = 3;
                 *width = readShort(bits + 8);
                 *height = readShort(bits + 10);
-                *size = sizeof(unsigned char) * (bits_length - 16);
-                data = (unsigned char*) malloc(*size);
-                memcpy(data, bits + 16, *size);
+                if (compressed_texture_is_supported(GL_ETC1_RGB8_OES, &upload_type)) {
+                    *compression_type = upload_type;
+                    *size = sizeof(unsigned char) * (bits_length - 16);
+                    data = (unsigned char*) malloc(*size);
+                    memcpy(data, bits + 16, *size);
+                } else {
+                    data = compressed_texture_decompress(GL_ETC1_RGB8_OES, bits + 16, bits_length - 16, *width, *height, channels);
+                    *size = (*channels) * (*width) * (*height);
+                }
             }
         } else if (is_jpg) {
             data = load_jpg_from_memory(bits, bits_length, width, height, channels);
             *size = (*channels) * (*width) * (*height);
+        } else if (is_qoi) {
+            data = load_qoi_from_memory(bits, bits_length, width, height, channels);
+            *size = (*channels) * (*width) * (*height);
+        } else if (is_ktx(bits, bits_length)) {
+            data = load_ktx_from_memory(bits, bits_length, width, height, channels, size, compression_type, num_levels);
         } else {
             LOG("Unknown image type, skipping load");
         }
@@ -170,24 +534,6 @@ unsigned char *load_image_from_memory(unsigned char *bits, long bits_length, int
     return data;
 }
 
-unsigned char *load_image_from_base64(const char *base64image, int *width, int *height, int *channels) {
-    int len = (int)strlen(base64image);
-    int decoded_bytes = GetBinaryLengthFromBase64Length(base64image, len);
-
-    // Read base64 image into binary image data
-    char *decoded_buffer = (char *)malloc(decoded_bytes);
-    int read_bytes = ReadBase64(base64image, len, decoded_buffer, decoded_bytes);
-
-    // Load PNG/JPEG image
-    long size;
-    int compression_type;
-    unsigned char *image = load_image_from_memory((unsigned char *)decoded_buffer, read_bytes, width, height, channels, &size, &compression_type);
-
-    free(decoded_buffer);
-
-    return image;
-}
-
 struct bounded_buffer {
     unsigned char *pos;
     unsigned char *end;
@@ -214,8 +560,11 @@ static void readpng2_error_handler(png_structp png_ptr,
     longjmp(*jbuf, 1);
 }
 
-unsigned char *load_png_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels) {
+// Reads the PNG after its signature through read_fn
+static unsigned char *load_png(png_rw_ptr read_fn, void *io_ptr, int *width, int *height, int *channels) {
     jmp_buf jbuf;
+    unsigned char *volatile image_data = NULL;
+    png_bytep *volatile row_pointers = NULL;
 
     //create png struct
     png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &jbuf, readpng2_error_handler, NULL);
@@ -242,12 +591,12 @@ unsigned char *load_png_from_memory(unsigned char *bits, long bits_length, int *
 
     if (setjmp(jbuf)) {
         png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        free(row_pointers);
+        free(image_data);
         return NULL;
     }
 
-    //create a bounded buffer for reading (set the inital pos to 8 <right after the header>)
-    struct bounded_buffer buff = {bits + 8, bits + bits_length};
-    png_set_read_fn(png_ptr, &buff, png_image_bytes_read);
+    png_set_read_fn(png_ptr, io_ptr, read_fn);
     //let libpng know you already read the first 8 bytes
     png_set_sig_bytes(png_ptr, 8);
     // read all the info up to the image data
@@ -278,7 +627,7 @@ unsigned char *load_png_from_memory(unsigned char *bits, long bits_length, int *
     *channels = (int)png_get_channels(png_ptr, info_ptr);
     size_t rowbytes = png_get_rowbytes(png_ptr, info_ptr);
     // Allocate the image_data as a big block, to be given to opengl
-    unsigned char  *image_data = (unsigned char *) malloc(rowbytes * (*height));
+    image_data = (unsigned char *) malloc(rowbytes * (*height));
 
     if (!image_data) {
         //clean up memory and close stuff
@@ -287,7 +636,7 @@ unsigned char *load_png_from_memory(unsigned char *bits, long bits_length, int *
     }
 
     //row_pointers is for pointing to image_data for reading the png with libpng
-    png_bytep *row_pointers = (png_bytep *)malloc((*height) * sizeof(png_bytep));
+    row_pointers = (png_bytep *)malloc((*height) * sizeof(png_bytep));
 
     if (!row_pointers) {
         //clean up memory and close stuff
@@ -310,6 +659,12 @@ unsigned char *load_png_from_memory(unsigned char *bits, long bits_length, int *
     return image_data;
 }
 
+unsigned char *load_png_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels) {
+    //create a bounded buffer for reading (set the inital pos to 8 <right after the header>)
+    struct bounded_buffer buff = {bits + 8, bits + bits_length};
+    return load_png(png_image_bytes_read, &buff, width, height, channels);
+}
+
 unsigned char *load_jpg_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels) {
     int jpegSubsamp, w, h, pitch;
 
@@ -331,3 +686,460 @@ unsigned char *load_jpg_from_memory(unsigned char *bits, long bits_length, int *
     *channels = 3;
     return buffer;
 }
+
+unsigned char *load_qoi_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels) {
+    qoi_decoder dec;
+    if (!qoi_decoder_init(&dec, bits, (unsigned long)bits_length)) {
+        LOG("{resources} QOI image header is corrupted\n");
+        return NULL;
+    }
+
+    const size_t pitch = (size_t)dec.width * dec.channels;
+    unsigned char *data = (unsigned char *)malloc(pitch * dec.height);
+    if (!data) {
+        return NULL;
+    }
+
+    int y;
+    for (y = 0; y < dec.height; ++y) {
+        if (!qoi_decode_row(&dec, data + pitch * y)) {
+            LOG("{resources} QOI image is truncated\n");
+            free(data);
+            return NULL;
+        }
+    }
+
+    *width = dec.width;
+    *height = dec.height;
+    *channels = dec.channels;
+    return data;
+}
+
+//// Base64 images
+
+// Decoded bytes held at a time, the text is decoded as libpng asks for it
+#define BASE64_SOURCE_BYTES 4096
+
+typedef struct base64_source_t {
+    base64_decoder dec;
+    const char *pos;
+    const char *end;
+    unsigned char buf[BASE64_SOURCE_BYTES];
+    unsigned char *next;
+    size_t avail;
+} base64_source;
+
+static bool base64_source_fill(base64_source *src) {
+    const size_t chunk = ((BASE64_SOURCE_BYTES - 3) / 3) * 4;
+
+    while (src->avail == 0 && src->pos < src->end && !src->dec.done && !src->dec.error) {
+        size_t chars = (size_t)(src->end - src->pos);
+        if (chars > chunk) {
+            chars = chunk;
+        }
+        src->avail = base64_decode_update(&src->dec, src->pos, chars, src->buf);
+        src->next = src->buf;
+        src->pos += chars;
+    }
+    return src->avail > 0;
+}
+
+static size_t base64_source_read(base64_source *src, unsigned char *dst, size_t length) {
+    size_t read = 0;
+
+    while (read < length && base64_source_fill(src)) {
+        size_t bytes = length - read;
+        if (bytes > src->avail) {
+            bytes = src->avail;
+        }
+        memcpy(dst + read, src->next, bytes);
+        src->next += bytes;
+        src->avail -= bytes;
+        read += bytes;
+    }
+    return read;
+}
+
+static void png_base64_bytes_read(png_structp png_ptr, png_bytep data, png_size_t length) {
+    if (base64_source_read((base64_source *)png_get_io_ptr(png_ptr), data, length) != length) {
+        png_error(png_ptr, "Base64 image data ended early");
+    }
+}
+
+/*
+ * Decodes a Base64 image, optionally with a data URI header.  PNGs are
+ * inflated straight from the text, other formats are decoded to a buffer
+ * first and go through load_image_from_memory.
+ */
+unsigned char *load_image_from_base64(const char *base64image, int *width, int *height, int *channels) {
+    const char *comma;
+    if (!strncmp(base64image, "data:", 5) && (comma = strchr(base64image, ','))) {
+        base64image = comma + 1;
+    }
+    const size_t len = strlen(base64image);
+
+    base64_source *src = (base64_source *)malloc(sizeof(base64_source));
+    if (!src) {
+        return NULL;
+    }
+    base64_decoder_init(&src->dec);
+    src->pos = base64image;
+    src->end = base64image + len;
+    src->avail = 0;
+
+    unsigned char header[8];
+    if (base64_source_read(src, header, 8) == 8 && !png_sig_cmp(header, 0, 8)) {
+        unsigned char *image = load_png(png_base64_bytes_read, src, width, height, channels);
+        free(src);
+        return image;
+    }
+    free(src);
+
+    base64_decoder dec;
+    unsigned char *decoded = (unsigned char *)malloc(base64_decoded_length(len));
+    if (!decoded) {
+        return NULL;
+    }
+    base64_decoder_init(&dec);
+    const size_t decoded_bytes = base64_decode_update(&dec, base64image, len, decoded);
+    if (dec.error) {
+        LOG("{resources} Base64 image has characters outside the alphabet\n");
+        free(decoded);
+        return NULL;
+    }
+
+    long size;
+    int compression_type, num_levels;
+    unsigned char *image = load_image_from_memory(decoded, (long)decoded_bytes, width, height, channels, &size, &compression_type, &num_levels);
+
+    free(decoded);
+    return image;
+}
+
+//// Reduced proxies of large images
+
+// JPEGs of at least this many texels get a 1/8 proxy instead of 1/4
+#define PROXY_EIGHTH_TEXELS (2048 * 1024)
+
+static unsigned char *load_jpg_proxy_from_memory(unsigned char *bits, long bits_length, long min_texels, int *width, int *height, int *channels, int *factor) {
+    int jpegSubsamp, w, h;
+
+    tjhandle _jpegDecompressor = tjInitDecompress();
+    if (!_jpegDecompressor) {
+        return NULL;
+    }
+
+    unsigned char *buffer = NULL;
+    if (!tjDecompressHeader2(_jpegDecompressor, bits, bits_length, &w, &h, &jpegSubsamp) && (long)w * h >= min_texels) {
+        // DCT scaling drops most of the inverse transform, so this is a
+        // fraction of the cost of the full decode
+        tjscalingfactor scaling = {1, (long)w * h >= PROXY_EIGHTH_TEXELS ? 8 : 4};
+        int proxy_w = TJSCALED(w, scaling);
+        int proxy_h = TJSCALED(h, scaling);
+        int pitch = tjPixelSize[TJPF_RGB] * proxy_w;
+
+        // Same 8 extra bytes as load_jpg_from_memory
+        buffer = malloc(pitch * proxy_h + 8);
+        if (buffer && tjDecompress2(_jpegDecompressor, bits, bits_length, buffer, proxy_w, pitch, proxy_h, TJPF_RGB, TJFLAG_FASTDCT)) {
+            free(buffer);
+            buffer = NULL;
+        }
+
+        *width = w;
+        *height = h;
+        *channels = 3;
+        *factor = scaling.denom;
+    }
+
+    tjDestroy(_jpegDecompressor);
+    return buffer;
+}
+
+static unsigned char *load_png_proxy_from_memory(unsigned char *bits, long bits_length, long min_texels, int *width, int *height, int *channels, int *factor) {
+    jmp_buf jbuf;
+    unsigned char *volatile image_data = NULL;
+    unsigned char *volatile row = NULL;
+
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &jbuf, readpng2_error_handler, NULL);
+    if (!png_ptr) {
+        return NULL;
+    }
+
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr) {
+        png_destroy_read_struct(&png_ptr, (png_infopp) NULL, (png_infopp) NULL);
+        return NULL;
+    }
+
+    if (setjmp(jbuf)) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        free(image_data);
+        free(row);
+        return NULL;
+    }
+
+    struct bounded_buffer buff = {bits + 8, bits + bits_length};
+    png_set_read_fn(png_ptr, &buff, png_image_bytes_read);
+    png_set_sig_bytes(png_ptr, 8);
+    png_read_info(png_ptr, info_ptr);
+
+    int bit_depth, color_type, interlace_type;
+    png_uint_32 twidth, theight;
+    png_get_IHDR(png_ptr, info_ptr, &twidth, &theight, &bit_depth, &color_type, &interlace_type, NULL, NULL);
+
+    // Only Adam7 files start with a reduced image, the first pass holds
+    // every 8th pixel of every 8th row
+    if (interlace_type != PNG_INTERLACE_ADAM7 || bit_depth > 8 || (long)twidth * theight < min_texels) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        return NULL;
+    }
+
+    // Same conversions as load_png_from_memory
+    if (color_type & PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+    }
+
+    // No interlace handling, so rows come back pass by pass at their reduced width
+    png_read_update_info(png_ptr, info_ptr);
+    int ch = (int)png_get_channels(png_ptr, info_ptr);
+    int proxy_w = PNG_PASS_COLS(twidth, 0);
+    int proxy_h = PNG_PASS_ROWS(theight, 0);
+    size_t proxy_rowbytes = (size_t)proxy_w * ch;
+
+    // libpng may write a full-width row, so rows are read into scratch first
+    row = (unsigned char *)malloc(png_get_rowbytes(png_ptr, info_ptr));
+    image_data = (unsigned char *)malloc(proxy_rowbytes * proxy_h);
+    if (!row || !image_data) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        free(image_data);
+        free(row);
+        return NULL;
+    }
+
+    int y;
+    for (y = 0; y < proxy_h; ++y) {
+        png_read_row(png_ptr, row, NULL);
+        memcpy(image_data + y * proxy_rowbytes, row, proxy_rowbytes);
+    }
+
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+    free(row);
+
+    *width = twidth;
+    *height = theight;
+    *channels = ch;
+    *factor = 8;
+    return image_data;
+}
+
+/*
+ * Cheaply decodes a reduced copy of a large JPEG or interlaced PNG of at least
+ * min_texels, returning NULL for anything else.  Width and height are those
+ * of the full image, the proxy is tightly packed rows of ceil(width / factor)
+ * texels and there are ceil(height / factor) of them.
+ */
+unsigned char *load_image_proxy_from_memory(unsigned char *bits, long bits_length, long min_texels, int *width, int *height, int *channels, int *factor) {
+    if (bits_length < 8) {
+        return NULL;
+    }
+
+    if (!png_sig_cmp(bits, 0, 8)) {
+        return load_png_proxy_from_memory(bits, bits_length, min_texels, width, height, channels, factor);
+    } else if (bits[0] == 0xFF && bits[1] == 0xD8) {
+        return load_jpg_proxy_from_memory(bits, bits_length, min_texels, width, height, channels, factor);
+    }
+    return NULL;
+}
+
+//// Row streaming
+
+static image_rows_result load_png_rows_from_memory(unsigned char *bits, long bits_length, image_row_sink *sink) {
+    jmp_buf jbuf;
+    unsigned char *volatile row = NULL;
+
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, &jbuf, readpng2_error_handler, NULL);
+    if (!png_ptr) {
+        return IMAGE_ROWS_FAILED;
+    }
+
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr) {
+        png_destroy_read_struct(&png_ptr, (png_infopp) NULL, (png_infopp) NULL);
+        return IMAGE_ROWS_FAILED;
+    }
+
+    if (setjmp(jbuf)) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        buffer_pool_release(row);
+        return IMAGE_ROWS_FAILED;
+    }
+
+    struct bounded_buffer buff = {bits + 8, bits + bits_length};
+    png_set_read_fn(png_ptr, &buff, png_image_bytes_read);
+    png_set_sig_bytes(png_ptr, 8);
+    png_read_info(png_ptr, info_ptr);
+
+    int bit_depth, color_type, interlace_type;
+    png_uint_32 twidth, theight;
+    png_get_IHDR(png_ptr, info_ptr, &twidth, &theight, &bit_depth, &color_type, &interlace_type, NULL, NULL);
+
+    // Interlaced rows arrive pass by pass, and 16-bit ones are left to the
+    // full decode so they come out the same as before
+    if (interlace_type != PNG_INTERLACE_NONE || bit_depth > 8) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        return IMAGE_ROWS_UNSUPPORTED;
+    }
+
+    // Same conversions as load_png_from_memory
+    if (color_type & PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+    }
+
+    png_read_update_info(png_ptr, info_ptr);
+    if (!sink->begin(sink, (int)twidth, (int)theight, (int)png_get_channels(png_ptr, info_ptr))) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        return IMAGE_ROWS_UNSUPPORTED;
+    }
+
+    row = (unsigned char *)buffer_pool_alloc(png_get_rowbytes(png_ptr, info_ptr));
+    if (!row) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        return IMAGE_ROWS_FAILED;
+    }
+
+    int y;
+    for (y = 0; y < (int)theight; ++y) {
+        png_read_row(png_ptr, row, NULL);
+        sink->row(sink, row, y);
+    }
+
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+    buffer_pool_release(row);
+    return IMAGE_ROWS_DONE;
+}
+
+struct jpeg_error_jump {
+    struct jpeg_error_mgr pub;
+    jmp_buf jbuf;
+};
+
+static void jpeg_error_jump_exit(j_common_ptr cinfo) {
+    struct jpeg_error_jump *err = (struct jpeg_error_jump *)cinfo->err;
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    LOG("{resources} JPEG image is corrupted.  Error=%s\n", msg);
+
+    longjmp(err->jbuf, 1);
+}
+
+static image_rows_result load_jpg_rows_from_memory(unsigned char *bits, long bits_length, image_row_sink *sink) {
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_jump err;
+    unsigned char *volatile row = NULL;
+
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = jpeg_error_jump_exit;
+    if (setjmp(err.jbuf)) {
+        jpeg_destroy_decompress(&cinfo);
+        buffer_pool_release(row);
+        return IMAGE_ROWS_FAILED;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, bits, (unsigned long)bits_length);
+    jpeg_read_header(&cinfo, TRUE);
+
+    // The same output as tjDecompress2 with TJPF_RGB and TJFLAG_FASTDCT
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.dct_method = JDCT_FASTEST;
+
+    // Scaling in the DCT skips most of the inverse transform and upsampling
+    if (sink->reduce) {
+        int reduction = sink->reduce(sink, (int)cinfo.image_width, (int)cinfo.image_height);
+        if (reduction == 2 || reduction == 4) {
+            cinfo.scale_num = 1;
+            cinfo.scale_denom = reduction;
+        }
+    }
+    jpeg_start_decompress(&cinfo);
+
+    if (!sink->begin(sink, (int)cinfo.output_width, (int)cinfo.output_height, 3)) {
+        jpeg_destroy_decompress(&cinfo);
+        return IMAGE_ROWS_UNSUPPORTED;
+    }
+
+    row = (unsigned char *)buffer_pool_alloc((size_t)cinfo.output_width * 3);
+    if (!row) {
+        jpeg_destroy_decompress(&cinfo);
+        return IMAGE_ROWS_FAILED;
+    }
+
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW rows[1] = { row };
+        int y = (int)cinfo.output_scanline;
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        sink->row(sink, row, y);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    buffer_pool_release(row);
+    return IMAGE_ROWS_DONE;
+}
+
+static image_rows_result load_qoi_rows_from_memory(unsigned char *bits, long bits_length, image_row_sink *sink) {
+    qoi_decoder dec;
+    if (!qoi_decoder_init(&dec, bits, (unsigned long)bits_length)) {
+        return IMAGE_ROWS_FAILED;
+    }
+
+    if (!sink->begin(sink, dec.width, dec.height, dec.channels)) {
+        return IMAGE_ROWS_UNSUPPORTED;
+    }
+
+    unsigned char *row = (unsigned char *)buffer_pool_alloc((size_t)dec.width * dec.channels);
+    if (!row) {
+        return IMAGE_ROWS_FAILED;
+    }
+
+    int y;
+    for (y = 0; y < dec.height; ++y) {
+        if (!qoi_decode_row(&dec, row)) {
+            LOG("{resources} QOI image is truncated\n");
+            buffer_pool_release(row);
+            return IMAGE_ROWS_FAILED;
+        }
+        sink->row(sink, row, y);
+    }
+
+    buffer_pool_release(row);
+    return IMAGE_ROWS_DONE;
+}
+
+/*
+ * Decodes a PNG, JPEG or QOI image a row at a time into the sink, so the full image is
+ * never held by the decoder.  Returns IMAGE_ROWS_UNSUPPORTED without decoding
+ * anything for other formats and for interlaced or 16-bit PNGs, which
+ * load_image_from_memory takes whole.
+ */
+image_rows_result load_image_rows_from_memory(unsigned char *bits, long bits_length, image_row_sink *sink) {
+    if (bits_length < 8) {
+        return IMAGE_ROWS_UNSUPPORTED;
+    }
+
+    if (!png_sig_cmp(bits, 0, 8)) {
+        return load_png_rows_from_memory(bits, bits_length, sink);
+    } else if (bits[0] == 0xFF && bits[1] == 0xD8) {
+        return load_jpg_rows_from_memory(bits, bits_length, sink);
+    } else if (!memcmp(bits, "qoif", 4)) {
+        return load_qoi_rows_from_memory(bits, bits_length, sink);
+    }
+    return IMAGE_ROWS_UNSUPPORTED;
+}
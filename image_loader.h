@@ -23,14 +23,39 @@
 #include "core/deps/png/pngstruct.h"
 #endif
 
+#include "core/types.h"
+
+/*
+ * Decoded rows handed over one at a time, top to bottom, so a caller can
+ * process them into their final layout without a full-size copy of the image.
+ * reduce() may be NULL, decoders that scale for free (JPEG) pass it the full
+ * size and decode at the 1, 2 or 4 it returns, each side rounded up.  begin()
+ * gets the decoded size once the header is read and may decline the image.
+ */
+typedef struct image_row_sink_t {
+	int (*reduce)(struct image_row_sink_t *sink, int width, int height);
+	bool (*begin)(struct image_row_sink_t *sink, int width, int height, int channels);
+	void (*row)(struct image_row_sink_t *sink, const unsigned char *row, int y);
+} image_row_sink;
+
+typedef enum image_rows_result_t {
+	IMAGE_ROWS_DONE = 0,
+	IMAGE_ROWS_UNSUPPORTED, // not a PNG, JPEG or QOI image that streams, or declined by the sink, nothing was decoded
+	IMAGE_ROWS_FAILED // corrupt, the sink may have seen some rows
+} image_rows_result;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+bool probe_image_from_memory(const unsigned char *bits, long bits_length, int *width, int *height, int *channels);
+image_rows_result load_image_rows_from_memory(unsigned char *bits, long bits_length, image_row_sink *sink);
 unsigned char *load_image_from_base64(const char *base64image, int *width, int *height, int *channels);
-unsigned char *load_image_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels, long *size, int *compression_type);
+unsigned char *load_image_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels, long *size, int *compression_type, int *num_levels);
 unsigned char *load_png_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels);
 unsigned char *load_jpg_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels);
+unsigned char *load_qoi_from_memory(unsigned char *bits, long bits_length, int *width, int *height, int *channels);
+unsigned char *load_image_proxy_from_memory(unsigned char *bits, long bits_length, long min_texels, int *width, int *height, int *channels, int *factor);
 //png helper func
 void png_image_bytes_read(png_structp png_ptr, png_bytep data, png_size_t length);
 
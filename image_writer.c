@@ -1,68 +1,13 @@
 #include "core/image_writer.h"
+#include "core/base64.h"
+#include "core/platform/threads.h"
 
 #include "core/deps/turbojpeg/turbojpeg.h"
 
 #include "platform/log.h"
 
 #include <stdlib.h>
-
-/*
-	A base64 encoder NOT using OpenSSL (by a very snarky Chris Taylor)
-
-	int GetBase64LengthFromBinaryLength(int bytes)
-
-		Get size of string buffer (neglecting terminating nul character) required to represent
-	the given length of data (in bytes).
-
-	void WriteBase64(const void *buffer, int bytes, char *encoded_buffer)
-
-		Write base64 string.  Does not write terminating nul character.
-
-	buffer: Input data bytes
-	bytes: Number of bytes of input data
-	encoded_buffer: Output data string
-	encoded_bytes: Size of output data string (from GetBase64LengthFromBinaryLength)
- */
-
-size_t GetBase64LengthFromBinaryLength(size_t bytes) {
-    if (bytes <= 0) return 0;
-
-    return ((bytes + 2) / 3) * 4;
-}
-
-static const char *TO_BASE64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-void WriteBase64(const void *buffer, size_t bytes, char *encoded_buffer) {
-    const unsigned char *data = (const unsigned char *)buffer;
-
-    size_t ii, jj, end;
-    for (ii = 0, jj = 0, end = bytes - 2; ii < end; ii += 3, jj += 4) {
-        encoded_buffer[jj] = TO_BASE64[data[ii] >> 2];
-        encoded_buffer[jj+1] = TO_BASE64[((data[ii] << 4) | (data[ii+1] >> 4)) & 0x3f];
-        encoded_buffer[jj+2] = TO_BASE64[((data[ii+1] << 2) | (data[ii+2] >> 6)) & 0x3f];
-        encoded_buffer[jj+3] = TO_BASE64[data[ii+2] & 0x3f];
-    }
-
-    switch (ii - end) {
-    default:
-    case 2: // Nothing to write
-        break;
-
-    case 1: // Need to write final 1 byte
-        encoded_buffer[jj] = TO_BASE64[data[bytes-1] >> 2];
-        encoded_buffer[jj+1] = TO_BASE64[(data[bytes-1] << 4) & 0x3f];
-        encoded_buffer[jj+2] = '=';
-        encoded_buffer[jj+3] = '=';
-        break;
-
-    case 0: // Need to write final 2 bytes
-        encoded_buffer[jj] = TO_BASE64[data[bytes-2] >> 2];
-        encoded_buffer[jj+1] = TO_BASE64[((data[bytes-2] << 4) | (data[bytes-1] >> 4)) & 0x3f];
-        encoded_buffer[jj+2] = TO_BASE64[(data[bytes-1] << 2) & 0x3f];
-        encoded_buffer[jj+3] = '=';
-        break;
-    }
-}
+#include <zlib.h>
 
 char *write_image_to_base64(const char *image_type, unsigned char * data, int width, int height, int channels) {
     int file_type = -1;
@@ -88,37 +33,81 @@ char *write_image_to_base64(const char *image_type, unsigned char * data, int wi
     return base64;
 }
 
-//png helper funcs for writing to memory
+//png helper funcs for writing to memory or a file
+
+// zlib level for the fast preset
+#define PNG_FAST_LEVEL 1
+
+// Fewest rows worth deflating on their own thread
+#define PNG_BAND_MIN_ROWS 64
 
-/* structure to store PNG image bytes */
-struct mem_encode {
+static image_writer_png_preset m_png_preset = IMAGE_WRITER_PNG_DEFAULT;
+static int m_png_threads = 1;
+
+/**
+ * @name	image_writer_set_png_preset
+ * @brief	picks how PNGs are encoded for write_png_to_file and write_png_to_base64
+ * @param	preset - (image_writer_png_preset) filters and zlib level to use
+ * @param	threads - (int) most threads deflating a fast export, 1 for the calling thread only
+ * @retval	NONE
+ */
+void image_writer_set_png_preset(image_writer_png_preset preset, int threads) {
+    m_png_preset = preset;
+    m_png_threads = threads < 1 ? 1 : threads;
+}
+
+/* where the encoded PNG goes, a file or Base64 text in memory */
+struct png_output {
+    FILE *file;
     char *buffer;
     size_t size;
+    size_t capacity;
+    base64_encoder encoder;
 };
 
-void png_write_data_func(png_structp png_ptr, png_bytep data, png_size_t length) {
-    /* with libpng15 next line causes pointer deference error; use libpng12 */
-    struct mem_encode* p=(struct mem_encode*)png_get_io_ptr(png_ptr); /* was png_ptr->io_ptr */
-    size_t nsize = p->size + length;
+static bool png_output_write(struct png_output *out, const unsigned char *data, size_t length) {
+    if (out->file) {
+        return fwrite(data, 1, length, out->file) == length;
+    }
 
-    /* allocate or grow buffer */
-    if(p->buffer)
-        p->buffer = realloc(p->buffer, nsize);
-    else
-        p->buffer = malloc(nsize);
+    // room for the carried bytes, the final padded group and a nul
+    const size_t needed = out->size + base64_encoded_length(length + 2) + 5;
+    if (needed > out->capacity) {
+        // grow geometrically, libpng writes many small pieces
+        size_t capacity = out->capacity ? out->capacity : 4096;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
 
-    if(!p->buffer)
+        char *buffer = realloc(out->buffer, capacity);
+        if (!buffer) {
+            return false;
+        }
+        out->buffer = buffer;
+        out->capacity = capacity;
+    }
+
+    out->size += base64_encode_update(&out->encoder, data, length, out->buffer + out->size);
+    return true;
+}
+
+void png_write_data_func(png_structp png_ptr, png_bytep data, png_size_t length) {
+    if (!png_output_write((struct png_output *)png_get_io_ptr(png_ptr), data, length)) {
         png_error(png_ptr, "Write Error");
+    }
+}
 
-    /* copy new bytes to end of buffer */
-    memcpy(p->buffer + p->size, data, length);
-    p->size += length;
+static void png_flush_data_func(png_structp png_ptr) {
+    struct png_output *out = (struct png_output *)png_get_io_ptr(png_ptr);
+    if (out->file) {
+        fflush(out->file);
+    }
 }
 
-char *write_png_to_base64(unsigned char * data, int width, int height, int channels) {
-    struct mem_encode state;
-    state.buffer = NULL;
-    state.size = 0;
+static bool write_png_with_libpng(struct png_output *out, unsigned char *data, int width, int height, int channels) {
+    bool did_write = false;
+    // volatile as it is set after setjmp and freed after a longjmp
+    png_byte **volatile row_pointers = NULL;
 
     png_structp png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (png_ptr == NULL) {
@@ -140,7 +129,16 @@ char *write_png_to_base64(unsigned char * data, int width, int height, int chann
     png_set_IHDR (png_ptr, info_ptr, width, height, 8, channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGBA , PNG_INTERLACE_NONE,
                   PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
-    png_byte **row_pointers = (png_byte **) malloc(height * sizeof (png_byte *));
+    if (m_png_preset == IMAGE_WRITER_PNG_FAST) {
+        // One cheap filter instead of trying all five on every row
+        png_set_filter (png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+        png_set_compression_level (png_ptr, PNG_FAST_LEVEL);
+    }
+
+    row_pointers = (png_byte **) malloc(height * sizeof (png_byte *));
+    if (row_pointers == NULL) {
+        goto png_failure;
+    }
 
     int i = 0;
     int rowbytes = channels * width;
@@ -148,33 +146,229 @@ char *write_png_to_base64(unsigned char * data, int width, int height, int chann
         row_pointers[i] = (unsigned char*)(data + i * rowbytes);
     }
 
-    // Write the image data to fp
+    // Write the image data
 
-    png_set_write_fn(png_ptr, &state, png_write_data_func, NULL);
+    png_set_write_fn(png_ptr, out, png_write_data_func, png_flush_data_func);
     png_set_rows (png_ptr, info_ptr, row_pointers);
     png_write_png (png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
 
+    did_write = true;
+
+png_failure:
     // Only free the pointer to the row pointers as row pointers point
     // image data that does not belong to this function
     free (row_pointers);
-
-png_failure:
 png_create_info_struct_failed:
     png_destroy_write_struct (&png_ptr, &info_ptr);
 png_create_write_struct_failed:
+    return did_write;
+}
 
-    if (state.buffer == NULL) {
-        return NULL;
-    } else {
-        const size_t b64size = GetBase64LengthFromBinaryLength(state.size);
-        char *base64 = malloc(b64size + 1);
+/*
+ * Multi-threaded deflate for the fast preset.  The rows are split into bands
+ * and each band is Sub-filtered and deflated on its own thread.  Every band
+ * but the last ends on a sync flush, so the outputs join into one zlib stream
+ * and their Adler-32 checksums combine.  Bands do not share a dictionary, so
+ * the file is slightly larger than a single-threaded fast export.
+ */
+typedef struct png_band_t {
+    const unsigned char *rows;
+    int row_count;
+    int rowbytes;
+    int bpp;
+    bool last;
+    unsigned char *out;     // 2 bytes of room for the zlib header, then the deflate data
+    size_t out_size;        // deflate data only
+    unsigned long adler;
+    unsigned long filtered_bytes;
+    bool ok;
+} png_band;
+
+static void png_deflate_band(void *param) {
+    png_band *band = (png_band *)param;
+    z_stream strm;
+    int y;
+
+    memset(&strm, 0, sizeof(strm));
+    band->ok = false;
+    if (deflateInit2(&strm, PNG_FAST_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+
+    band->filtered_bytes = (unsigned long)(band->rowbytes + 1) * band->row_count;
+    // deflateBound leaves out the sync flush marker, the rest is the zlib header and checksum
+    const size_t bound = deflateBound(&strm, band->filtered_bytes) + 16;
+    unsigned char *filtered = (unsigned char *)malloc(band->rowbytes + 1);
+    band->out = (unsigned char *)malloc(bound + 6);
+    if (!filtered || !band->out) {
+        free(filtered);
+        deflateEnd(&strm);
+        return;
+    }
+
+    strm.next_out = band->out + 2;
+    strm.avail_out = (uInt)bound;
+    band->adler = adler32(0L, Z_NULL, 0);
+
+    for (y = 0; y < band->row_count; ++y) {
+        const unsigned char *row = band->rows + (size_t)y * band->rowbytes;
+        int x;
+
+        filtered[0] = PNG_FILTER_VALUE_SUB;
+        memcpy(filtered + 1, row, band->bpp);
+        for (x = band->bpp; x < band->rowbytes; ++x) {
+            filtered[x + 1] = (unsigned char)(row[x] - row[x - band->bpp]);
+        }
+        band->adler = adler32(band->adler, filtered, band->rowbytes + 1);
+
+        int flush = Z_NO_FLUSH;
+        if (y == band->row_count - 1) {
+            flush = band->last ? Z_FINISH : Z_SYNC_FLUSH;
+        }
 
-        WriteBase64(state.buffer, state.size, base64);
-        base64[b64size] = '\0';
+        strm.next_in = filtered;
+        strm.avail_in = band->rowbytes + 1;
+        const int ret = deflate(&strm, flush);
+        if ((ret != Z_OK && ret != Z_STREAM_END) || strm.avail_in != 0) {
+            break;
+        }
+    }
 
-        free(state.buffer);
-        return base64;
+    band->ok = y == band->row_count;
+    band->out_size = bound - strm.avail_out;
+    free(filtered);
+    deflateEnd(&strm);
+}
+
+static void write_u32_be(unsigned char *p, unsigned long v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static bool png_output_chunk(struct png_output *out, const char *type, const unsigned char *data, size_t length) {
+    unsigned char header[8], crc[4];
+
+    write_u32_be(header, (unsigned long)length);
+    memcpy(header + 4, type, 4);
+    uLong sum = crc32(crc32(0L, Z_NULL, 0), header + 4, 4);
+    if (length) {
+        sum = crc32(sum, data, (uInt)length);
     }
+    write_u32_be(crc, sum);
+
+    return png_output_write(out, header, 8) &&
+           (!length || png_output_write(out, data, length)) &&
+           png_output_write(out, crc, 4);
+}
+
+static bool write_png_in_bands(struct png_output *out, unsigned char *data, int width, int height, int channels, int band_count) {
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    png_band *bands = (png_band *)calloc(band_count, sizeof(png_band));
+    ThreadsThread *threads = (ThreadsThread *)calloc(band_count, sizeof(ThreadsThread));
+    const int rowbytes = width * channels;
+    bool did_write = false;
+    int i, y = 0;
+
+    if (!bands || !threads) {
+        free(bands);
+        free(threads);
+        return write_png_with_libpng(out, data, width, height, channels);
+    }
+
+    for (i = 0; i < band_count; ++i) {
+        const int next = (int)((long)height * (i + 1) / band_count);
+        bands[i].rows = data + (size_t)y * rowbytes;
+        bands[i].row_count = next - y;
+        bands[i].rowbytes = rowbytes;
+        bands[i].bpp = channels;
+        bands[i].last = i == band_count - 1;
+        y = next;
+    }
+
+    // The calling thread takes the first band
+    for (i = 1; i < band_count; ++i) {
+        threads[i] = threads_create_thread(png_deflate_band, &bands[i]);
+        if (threads[i] == THREADS_INVALID_THREAD) {
+            png_deflate_band(&bands[i]);
+        }
+    }
+    png_deflate_band(&bands[0]);
+
+    bool ok = bands[0].ok;
+    unsigned long adler = bands[0].adler;
+    for (i = 1; i < band_count; ++i) {
+        if (threads[i] != THREADS_INVALID_THREAD) {
+            threads_join_thread(&threads[i]);
+        }
+        ok = ok && bands[i].ok;
+        adler = adler32_combine(adler, bands[i].adler, (z_off_t)bands[i].filtered_bytes);
+    }
+
+    if (ok) {
+        unsigned char ihdr[13];
+        write_u32_be(ihdr, (unsigned long)width);
+        write_u32_be(ihdr + 4, (unsigned long)height);
+        ihdr[8] = 8;
+        ihdr[9] = channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGBA;
+        ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+        ihdr[11] = PNG_FILTER_TYPE_BASE;
+        ihdr[12] = PNG_INTERLACE_NONE;
+
+        // 32K window, fastest compression level
+        bands[0].out[0] = 0x78;
+        bands[0].out[1] = 0x01;
+        png_band *last = &bands[band_count - 1];
+        write_u32_be(last->out + 2 + last->out_size, adler);
+        last->out_size += 4;
+
+        did_write = png_output_write(out, signature, 8) && png_output_chunk(out, "IHDR", ihdr, 13);
+        for (i = 0; did_write && i < band_count; ++i) {
+            did_write = i == 0 ? png_output_chunk(out, "IDAT", bands[i].out, bands[i].out_size + 2)
+                               : png_output_chunk(out, "IDAT", bands[i].out + 2, bands[i].out_size);
+        }
+        did_write = did_write && png_output_chunk(out, "IEND", NULL, 0);
+    }
+
+    for (i = 0; i < band_count; ++i) {
+        free(bands[i].out);
+    }
+    free(bands);
+    free(threads);
+
+    // A band that could not be deflated leaves the whole image to libpng
+    if (!ok) {
+        return write_png_with_libpng(out, data, width, height, channels);
+    }
+    return did_write;
+}
+
+static bool write_png(struct png_output *out, unsigned char *data, int width, int height, int channels) {
+    int band_count = height / PNG_BAND_MIN_ROWS;
+    if (band_count > m_png_threads) {
+        band_count = m_png_threads;
+    }
+
+    if (m_png_preset == IMAGE_WRITER_PNG_FAST && band_count > 1 && (channels == 3 || channels == 4)) {
+        return write_png_in_bands(out, data, width, height, channels, band_count);
+    }
+    return write_png_with_libpng(out, data, width, height, channels);
+}
+
+char *write_png_to_base64(unsigned char * data, int width, int height, int channels) {
+    struct png_output out;
+    memset(&out, 0, sizeof(out));
+    base64_encoder_init(&out.encoder);
+
+    if (!write_png(&out, data, width, height, channels) || out.buffer == NULL) {
+        free(out.buffer);
+        return NULL;
+    }
+
+    out.size += base64_encode_finish(&out.encoder, out.buffer + out.size);
+    out.buffer[out.size] = '\0';
+    return out.buffer;
 }
 
 char *write_jpeg_to_base64(unsigned char * data, int width, int height, int channels) {
@@ -185,7 +379,7 @@ char *write_jpeg_to_base64(unsigned char * data, int width, int height, int chan
     unsigned char *buffer = 0;
     unsigned long buffer_size = 0;
 
-    int retval = tjCompress2(_jpegCompressor, buffer, width, 0, height,
+    int retval = tjCompress2(_jpegCompressor, data, width, 0, height,
                              channels == 3 ? TJPF_RGB : TJPF_RGBA,
                              &buffer, &buffer_size, TJSAMP_444, 90,
                              TJFLAG_FASTDCT);
@@ -194,11 +388,11 @@ char *write_jpeg_to_base64(unsigned char * data, int width, int height, int chan
     if (retval != 0 || !buffer) {
         LOG("WARNING: Unable to compress %d x %d base64 JPEG", width, height);
     } else {
-        const size_t b64size = GetBase64LengthFromBinaryLength(buffer_size);
-        char *base64 = malloc(b64size + 1);
+        base64 = malloc(base64_encoded_length(buffer_size) + 1);
 
-        WriteBase64(buffer, buffer_size, base64);
-        base64[b64size] = '\0';
+        if (base64) {
+            base64[base64_encode(buffer, buffer_size, base64)] = '\0';
+        }
     }
 
     if (buffer) {
@@ -243,12 +437,12 @@ bool write_jpeg_to_file(const char *path, const char *name, unsigned char *data,
     bool did_write = false;
 
     // append filename to path
-    size_t full_path_len = strlen(path) + strlen("/") + strlen(name);
+    size_t full_path_len = strlen(path) + strlen("/") + strlen(name) + 1;
     char *full_path = (char *)malloc(full_path_len);
-    memset(full_path, 0, full_path_len);
     sprintf(full_path, "%s%s%s", path, "/", name);
 
     FILE *outfile = fopen(full_path, "wb");
+    free(full_path);
 
     if (!outfile) {
         LOG("WARNING: Unable to open write path: %s", name);
@@ -258,7 +452,7 @@ bool write_jpeg_to_file(const char *path, const char *name, unsigned char *data,
         unsigned char *buffer = 0;
         unsigned long buffer_size = 0;
 
-        int retval = tjCompress2(_jpegCompressor, buffer, width, 0, height,
+        int retval = tjCompress2(_jpegCompressor, data, width, 0, height,
                                  channels == 3 ? TJPF_RGB : TJPF_RGBA,
                                  &buffer, &buffer_size, TJSAMP_444, 90,
                                  TJFLAG_FASTDCT);
@@ -288,60 +482,21 @@ bool write_png_to_file(const char *path, const char *name, unsigned char *data,
     bool did_write = false;
 
     // append path to filename
-    size_t full_path_len = strlen(path) + strlen("/") + strlen(name);
+    size_t full_path_len = strlen(path) + strlen("/") + strlen(name) + 1;
     char *full_path = (char *)malloc(full_path_len);
-    memset(full_path, 0, full_path_len);
     sprintf(full_path, "%s%s%s", path, "/", name);
 
     FILE *fp = fopen (full_path, "wb");
+    free(full_path);
     if (! fp) {
-        goto fopen_failed;
-    }
-
-    png_structp png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (png_ptr == NULL) {
-        goto png_create_write_struct_failed;
-    }
-
-    png_infop info_ptr = png_create_info_struct (png_ptr);
-    if (info_ptr == NULL) {
-        goto png_create_info_struct_failed;
-    }
-
-    // Set up error handling
-
-    if (setjmp (png_jmpbuf (png_ptr))) {
-        goto png_failure;
-    }
-
-    // Set image attributes
-
-    png_set_IHDR (png_ptr, info_ptr, width, height, 8, channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_RGBA , PNG_INTERLACE_NONE,
-                  PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
-    png_byte **row_pointers = (png_byte **) malloc(height * sizeof (png_byte *));
-    int i;
-    int rowbytes = channels * width;
-    for (i = 0; i < height; i++) {
-        row_pointers[i] = data + i * rowbytes;
+        LOG("WARNING: Unable to open write path: %s", name);
+        return false;
     }
 
-    // Write the image data to fp
-    png_init_io (png_ptr, fp);
-    png_set_rows (png_ptr, info_ptr, row_pointers);
-    png_write_png (png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
-
-    did_write = true;
-
-    // Only free the pointer to the row pointers as row pointers point
-    // image data that does not belong to this function
-    free (row_pointers);
+    struct png_output out;
+    memset(&out, 0, sizeof(out));
+    out.file = fp;
+    did_write = write_png(&out, data, width, height, channels);
 
-png_failure:
-png_create_info_struct_failed:
-    png_destroy_write_struct (&png_ptr, &info_ptr);
-png_create_write_struct_failed:
-    fclose (fp);
-fopen_failed:
-    return did_write;
+    return fclose (fp) == 0 && did_write;
 }
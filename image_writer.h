@@ -13,10 +13,28 @@
 
 enum IMAGE_TYPES {IMAGE_TYPE_JPEG, IMAGE_TYPE_PNG};
 
+/*
+ * PNG exports default to libpng's adaptive filtering at zlib's default level
+ * on the calling thread.  Callers that favour speed over file size opt in to
+ * the fast preset, the Sub filter on every row and zlib level 1, with
+ * image_writer_set_png_preset().  With more than one thread, fast exports of
+ * large images are split into bands of rows that deflate at the same time,
+ * like pigz, for a slightly larger file.  IMAGE_WRITER_PNG_THREADS is a
+ * reasonable thread count to ask for.
+ */
+typedef enum image_writer_png_preset_t {
+	IMAGE_WRITER_PNG_DEFAULT = 0,
+	IMAGE_WRITER_PNG_FAST
+} image_writer_png_preset;
+
+#define IMAGE_WRITER_PNG_THREADS 4
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+void image_writer_set_png_preset(image_writer_png_preset preset, int threads);
+
 bool write_image_to_file(const char *path, const char *name, unsigned char * data, int width, int height, int channels); 
 bool write_png_to_file(const char *path, const char *name, unsigned char * data, int width, int height, int channels);
 bool write_jpeg_to_file(const char *path, const char *name, unsigned char * data, int width, int height, int channels); 
@@ -0,0 +1,213 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 lz.c
+ * @brief	LZ4 style block compression for data kept in memory
+ */
+#include "core/lz.h"
+#include <stdint.h>
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5 /* the block always ends on literals */
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 14
+#define LZ_SKIP_SHIFT 6 /* step up through data that keeps missing */
+
+static inline uint32_t read_u32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash_u32(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static size_t write_length(unsigned char *dst, size_t op, size_t len) {
+    while (len >= 255) {
+        dst[op++] = 255;
+        len -= 255;
+    }
+    dst[op++] = (unsigned char)len;
+    return op;
+}
+
+static size_t write_sequence(unsigned char *dst, size_t op, const unsigned char *literals, size_t literal_len,
+                             size_t offset, size_t match_len) {
+    size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+    unsigned char token = (unsigned char)(((literal_len < 15 ? literal_len : 15) << 4) | (match_code < 15 ? match_code : 15));
+    dst[op++] = token;
+    if (literal_len >= 15) {
+        op = write_length(dst, op, literal_len - 15);
+    }
+    memcpy(dst + op, literals, literal_len);
+    op += literal_len;
+
+    if (match_len) {
+        dst[op++] = (unsigned char)(offset & 0xff);
+        dst[op++] = (unsigned char)(offset >> 8);
+        if (match_code >= 15) {
+            op = write_length(dst, op, match_code - 15);
+        }
+    }
+    return op;
+}
+
+/**
+ * @name	lz_compress_bound
+ * @brief	gives the most bytes lz_compress() can write for the given input
+ * @param	size - (size_t) bytes to compress
+ * @retval	size_t - size the output buffer needs
+ */
+size_t lz_compress_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+/**
+ * @name	lz_compress
+ * @brief	compresses a block of bytes
+ * @param	src - (const unsigned char *) bytes to compress
+ * @param	size - (size_t) number of bytes
+ * @param	dst - (unsigned char *) output of at least lz_compress_bound(size) bytes
+ * @retval	size_t - compressed size
+ */
+size_t lz_compress(const unsigned char *src, size_t size, unsigned char *dst) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    size_t ip = 0;
+    size_t anchor = 0;
+    size_t op = 0;
+
+    if (size > LZ_MIN_MATCH + LZ_LAST_LITERALS) {
+        const size_t match_limit = size - LZ_LAST_LITERALS;
+        const size_t last_start = match_limit - LZ_MIN_MATCH;
+        memset(table, 0, sizeof(table));
+
+        while (ip <= last_start) {
+            uint32_t seq = read_u32(src + ip);
+            uint32_t h = hash_u32(seq);
+            size_t candidate = table[h];
+            table[h] = (uint32_t)ip;
+
+            if (candidate >= ip || ip - candidate > LZ_MAX_OFFSET || read_u32(src + candidate) != seq) {
+                ip += 1 + ((ip - anchor) >> LZ_SKIP_SHIFT);
+                continue;
+            }
+
+            // back over literals that also match
+            while (ip > anchor && candidate > 0 && src[ip - 1] == src[candidate - 1]) {
+                ip--;
+                candidate--;
+            }
+
+            size_t len = LZ_MIN_MATCH;
+            while (ip + len < match_limit && src[candidate + len] == src[ip + len]) {
+                len++;
+            }
+
+            op = write_sequence(dst, op, src + anchor, ip - anchor, ip - candidate, len);
+            ip += len;
+            anchor = ip;
+
+            // index the end of the match so the next run finds it
+            if (ip <= last_start) {
+                table[hash_u32(read_u32(src + ip - 2))] = (uint32_t)(ip - 2);
+            }
+        }
+    }
+
+    return write_sequence(dst, op, src + anchor, size - anchor, 0, 0);
+}
+
+/**
+ * @name	lz_decompress
+ * @brief	decompresses a block from lz_compress(), checking it against its
+ *			expected size
+ * @param	src - (const unsigned char *) compressed bytes
+ * @param	size - (size_t) compressed size
+ * @param	dst - (unsigned char *) output buffer
+ * @param	dst_size - (size_t) exact size of the decompressed data
+ * @retval	bool - false if the block is corrupt or the wrong size
+ */
+bool lz_decompress(const unsigned char *src, size_t size, unsigned char *dst, size_t dst_size) {
+    size_t ip = 0;
+    size_t op = 0;
+
+    while (ip < size) {
+        unsigned char token = src[ip++];
+        unsigned char b;
+
+        size_t literal_len = token >> 4;
+        if (literal_len == 15) {
+            do {
+                if (ip >= size) {
+                    return false;
+                }
+                b = src[ip++];
+                literal_len += b;
+            } while (b == 255);
+        }
+        if (literal_len > size - ip || literal_len > dst_size - op) {
+            return false;
+        }
+        memcpy(dst + op, src + ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+
+        // the last sequence has no match
+        if (ip == size) {
+            break;
+        }
+
+        if (size - ip < 2) {
+            return false;
+        }
+        size_t offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return false;
+        }
+
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            do {
+                if (ip >= size) {
+                    return false;
+                }
+                b = src[ip++];
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LZ_MIN_MATCH;
+        if (match_len > dst_size - op) {
+            return false;
+        }
+
+        // matches may overlap the bytes they write, runs repeat a short pattern
+        const unsigned char *match = dst + op - offset;
+        if (offset >= match_len) {
+            memcpy(dst + op, match, match_len);
+        } else {
+            size_t i;
+            for (i = 0; i < match_len; ++i) {
+                dst[op + i] = match[i];
+            }
+        }
+        op += match_len;
+    }
+
+    return op == dst_size;
+}
@@ -0,0 +1,41 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef LZ_H
+#define LZ_H
+
+#include "core/types.h"
+
+/*
+ * Fast byte-oriented LZ compression for data kept in memory, like spilled
+ * canvases.  The block layout follows LZ4: each sequence is a token with the
+ * literal and match lengths, the literals, then a 2 byte match offset.  It
+ * trades ratio for speed, canvas pixels mostly compress on runs of clear or
+ * solid texels anyway.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t lz_compress_bound(size_t size);
+size_t lz_compress(const unsigned char *src, size_t size, unsigned char *dst);
+bool lz_decompress(const unsigned char *src, size_t size, unsigned char *dst, size_t dst_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,270 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+
+/**
+ * @file	 mipmap.c
+ * @brief	box filtered mip chains for uncompressed textures
+ */
+#include "core/mipmap.h"
+#include "core/util/detect.h"
+#include "core/buffer_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(GC_NEON)
+#include <arm_neon.h>
+#elif defined(GC_SSE2)
+#include <emmintrin.h>
+#endif
+
+// Average four color values, same rounding as the half-sizing in texture_2d.c
+#define COLOR_AVG4(x, y, z, w) (((unsigned short)( x ) + (unsigned short)( y ) + (unsigned short)( z ) + (unsigned short)( w ) + 2) >> 2)
+
+/**
+ * @name	mipmap_get_level_count
+ * @brief	counts the levels of a full mip chain, including the base level
+ * @param	width - (int) width of the base level
+ * @param	height - (int) height of the base level
+ * @retval	int - number of levels down to 1x1
+ */
+int mipmap_get_level_count(int width, int height) {
+    int levels = 1;
+
+    while (width > 1 || height > 1) {
+        width >>= 1;
+        height >>= 1;
+        ++levels;
+    }
+
+    return levels;
+}
+
+/**
+ * @name	mipmap_box_filter_row
+ * @brief	averages 2x2 blocks of two rows into one row of half the width.
+ *			the SIMD paths give the same result as the scalar one.  passing
+ *			the same row twice averages 1x2 blocks
+ * @param	row0 - (const unsigned char *) upper row, 2 * out_width texels
+ * @param	row1 - (const unsigned char *) lower row, 2 * out_width texels
+ * @param	out - (unsigned char *) output row
+ * @param	out_width - (int) texels to write
+ * @param	channels - (int) bytes per texel
+ * @retval	NONE
+ */
+void mipmap_box_filter_row(const unsigned char *row0, const unsigned char *row1, unsigned char *out, int out_width, int channels) {
+    int x = 0, c;
+
+    if (channels == 4) {
+#if defined(GC_NEON)
+        for (; x + 8 <= out_width; x += 8) {
+            uint8x16x4_t a = vld4q_u8(row0 + x * 8);
+            uint8x16x4_t b = vld4q_u8(row1 + x * 8);
+            uint8x8x4_t r;
+
+            for (c = 0; c < 4; ++c) {
+                // Pairwise sums of both rows, then (sum + 2) >> 2
+                r.val[c] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a.val[c]), b.val[c]), 2);
+            }
+            vst4_u8(out + x * 4, r);
+        }
+#elif defined(GC_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+
+        for (; x + 4 <= out_width; x += 4) {
+            __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+            __m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + x * 8 + 16));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+            __m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8 + 16));
+
+            // Column sums of texels 0-1, 2-3, 4-5 and 6-7, 16 bits per channel
+            __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+            __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+            // Add even texels to odd texels
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+            __m128i hi = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+            _mm_storeu_si128((__m128i *)(out + x * 4), _mm_packus_epi16(lo, hi));
+        }
+#endif
+    } else if (channels == 3) {
+#if defined(GC_NEON)
+        for (; x + 8 <= out_width; x += 8) {
+            uint8x16x3_t a = vld3q_u8(row0 + x * 6);
+            uint8x16x3_t b = vld3q_u8(row1 + x * 6);
+            uint8x8x3_t r;
+
+            for (c = 0; c < 3; ++c) {
+                r.val[c] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a.val[c]), b.val[c]), 2);
+            }
+            vst3_u8(out + x * 3, r);
+        }
+#elif defined(GC_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        const __m128i keep0 = _mm_set_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, -1, -1, -1);
+        const __m128i keep1 = _mm_slli_si128(keep0, 3);
+        const __m128i keep2 = _mm_slli_si128(keep0, 6);
+
+        // 3 texels a step, stores run 7 bytes past them into the next step
+        for (; x + 6 <= out_width; x += 3) {
+            const unsigned char *a = row0 + x * 6;
+            const unsigned char *b = row1 + x * 6;
+            __m128i a0 = _mm_loadu_si128((const __m128i *)a);
+            __m128i a3 = _mm_loadu_si128((const __m128i *)(a + 3));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)b);
+            __m128i b3 = _mm_loadu_si128((const __m128i *)(b + 3));
+
+            // Byte i sums with byte i + 3 of both rows, bytes 0-2, 6-8 and
+            // 12-14 are the 2x2 sums of the three output texels
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(a3, zero)),
+                                       _mm_add_epi16(_mm_unpacklo_epi8(b0, zero), _mm_unpacklo_epi8(b3, zero)));
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(a3, zero)),
+                                       _mm_add_epi16(_mm_unpackhi_epi8(b0, zero), _mm_unpackhi_epi8(b3, zero)));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+            __m128i avg = _mm_packus_epi16(lo, hi);
+
+            avg = _mm_or_si128(_mm_and_si128(avg, keep0),
+                               _mm_or_si128(_mm_and_si128(_mm_srli_si128(avg, 3), keep1),
+                                            _mm_and_si128(_mm_srli_si128(avg, 6), keep2)));
+            _mm_storeu_si128((__m128i *)(out + x * 3), avg);
+        }
+#endif
+    } else if (channels == 1) {
+#if defined(GC_NEON)
+        for (; x + 8 <= out_width; x += 8) {
+            uint8x16_t a = vld1q_u8(row0 + x * 2);
+            uint8x16_t b = vld1q_u8(row1 + x * 2);
+            vst1_u8(out + x, vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a), b), 2));
+        }
+#elif defined(GC_SSE2)
+        const __m128i even = _mm_set1_epi16(0x00FF);
+        const __m128i two = _mm_set1_epi16(2);
+
+        for (; x + 16 <= out_width; x += 16) {
+            __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x * 2));
+            __m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + x * 2 + 16));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x * 2));
+            __m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + x * 2 + 16));
+
+            // Even plus odd bytes of both rows
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, even), _mm_srli_epi16(a0, 8)),
+                                       _mm_add_epi16(_mm_and_si128(b0, even), _mm_srli_epi16(b0, 8)));
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, even), _mm_srli_epi16(a1, 8)),
+                                       _mm_add_epi16(_mm_and_si128(b1, even), _mm_srli_epi16(b1, 8)));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+            _mm_storeu_si128((__m128i *)(out + x), _mm_packus_epi16(lo, hi));
+        }
+#endif
+    }
+
+    for (; x < out_width; ++x) {
+        const unsigned char *a = row0 + x * 2 * channels;
+        const unsigned char *b = row1 + x * 2 * channels;
+
+        for (c = 0; c < channels; ++c) {
+            out[x * channels + c] = COLOR_AVG4(a[c], a[c + channels], b[c], b[c + channels]);
+        }
+    }
+}
+
+/**
+ * @name	mipmap_downsample
+ * @brief	writes the next level of a mip chain.  a side of 1 texel stays 1
+ *			and odd sides drop their last row or column
+ * @param	pixels - (const unsigned char *) level to reduce
+ * @param	width - (int) width of the level
+ * @param	height - (int) height of the level
+ * @param	channels - (int) bytes per texel
+ * @param	out - (unsigned char *) next level, max(width / 2, 1) by max(height / 2, 1)
+ * @retval	NONE
+ */
+void mipmap_downsample(const unsigned char *pixels, int width, int height, int channels, unsigned char *out) {
+    const int out_w = width > 1 ? width >> 1 : 1;
+    const int out_h = height > 1 ? height >> 1 : 1;
+    const int stride = width * channels;
+    int x, y, c;
+
+    if (width > 1 && height > 1) {
+        for (y = 0; y < out_h; ++y) {
+            const unsigned char *row0 = pixels + y * 2 * stride;
+            mipmap_box_filter_row(row0, row0 + stride, out + y * out_w * channels, out_w, channels);
+        }
+    } else {
+        // A single row or column, texels pair up along it
+        const int step = width > 1 ? channels : stride;
+        const int count = out_w * out_h;
+
+        for (x = 0; x < count; ++x) {
+            const unsigned char *a = pixels + x * 2 * step;
+            const unsigned char *b = a + step;
+
+            for (c = 0; c < channels; ++c) {
+                out[x * channels + c] = (unsigned char)(((unsigned short)a[c] + b[c] + 1) >> 1);
+            }
+        }
+    }
+}
+
+/**
+ * @name	mipmap_generate_chain
+ * @brief	appends a full mip chain to a base level
+ * @param	pixels - (unsigned char *) base level from malloc or buffer_pool_alloc(),
+ *			reallocated to hold the chain
+ * @param	width - (int) width of the base level
+ * @param	height - (int) height of the base level
+ * @param	channels - (int) bytes per texel
+ * @param	num_levels - (int *) output number of levels, including the base level
+ * @retval	unsigned char* - the chain, or NULL if it cannot allocate, leaving pixels as they were
+ */
+unsigned char *mipmap_generate_chain(unsigned char *pixels, int width, int height, int channels, int *num_levels) {
+    const int levels = mipmap_get_level_count(width, height);
+    unsigned long total = 0;
+    int level, w = width, h = height;
+
+    for (level = 0; level < levels; ++level) {
+        total += (unsigned long)w * h * channels;
+        w = w > 1 ? w >> 1 : 1;
+        h = h > 1 ? h >> 1 : 1;
+    }
+
+    unsigned char *chain = (unsigned char *)buffer_pool_realloc(pixels, total);
+    if (!chain) {
+        return NULL;
+    }
+
+    unsigned char *src = chain;
+    w = width;
+    h = height;
+    for (level = 1; level < levels; ++level) {
+        unsigned char *dst = src + (unsigned long)w * h * channels;
+        mipmap_downsample(src, w, h, channels, dst);
+        src = dst;
+        w = w > 1 ? w >> 1 : 1;
+        h = h > 1 ? h >> 1 : 1;
+    }
+
+    *num_levels = levels;
+    return chain;
+}
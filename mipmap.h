@@ -0,0 +1,42 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "core/types.h"
+
+/*
+ * Mip chains generated on the decode threads.  Levels are laid out one after
+ * another like the levels of a KTX file, each half the size of the one before
+ * rounding down, down to 1x1.  Texels are premultiplied, so each level is a
+ * plain 2x2 box average of the one above it.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int mipmap_get_level_count(int width, int height);
+void mipmap_box_filter_row(const unsigned char *row0, const unsigned char *row1, unsigned char *out, int out_width, int channels);
+void mipmap_downsample(const unsigned char *pixels, int width, int height, int channels, unsigned char *out);
+unsigned char *mipmap_generate_chain(unsigned char *pixels, int width, int height, int channels, int *num_levels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
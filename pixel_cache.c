@@ -0,0 +1,257 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 pixel_cache.c
+ * @brief	texels of evicted textures kept compressed in memory
+ */
+#include "core/pixel_cache.h"
+#include "core/canvas_spill.h"
+#include "core/buffer_pool.h"
+#include "core/texture_format.h"
+#include "core/deps/uthash/uthash.h"
+#include "core/log.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct pixel_cache_entry_t {
+    char *url;
+    unsigned int variant;
+    canvas_spill *spill;
+    size_t size; // uncompressed
+
+    int num_channels;
+    int width;
+    int height;
+    int original_width;
+    int original_height;
+    int scale;
+    int pixel_type;
+    int num_levels;
+    unsigned int content_hash[4];
+    bool content_hashed;
+
+    UT_hash_handle hh;
+} pixel_cache_entry;
+
+// uthash iterates in insertion order, so the head is the least recently
+// stored or evicted
+static pixel_cache_entry *m_entries = NULL;
+static pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t m_max_bytes = PIXEL_CACHE_MAX_BYTES;
+
+static void destroy_entry(pixel_cache_entry *entry) {
+    HASH_DEL(m_entries, entry);
+    canvas_spill_free(entry->spill);
+    free(entry->url);
+    free(entry);
+}
+
+// Drops the oldest entries until the rest fit, call with m_mutex held
+static void trim_entries() {
+    size_t bytes = 0;
+    pixel_cache_entry *entry = NULL;
+    pixel_cache_entry *tmp = NULL;
+    HASH_ITER(hh, m_entries, entry, tmp) {
+        bytes += canvas_spill_get_bytes(entry->spill);
+    }
+
+    HASH_ITER(hh, m_entries, entry, tmp) {
+        if (bytes <= m_max_bytes) {
+            break;
+        }
+        bytes -= canvas_spill_get_bytes(entry->spill);
+        destroy_entry(entry);
+    }
+}
+
+/**
+ * @name	pixel_cache_put
+ * @brief	takes the texels of a texture that was just uploaded
+ * @param	tex - (texture_2d *) texture whose pixel_data is taken, it is NULL
+ *			on return whether or not it was kept
+ * @param	variant - (unsigned int) what besides the url picked the texels
+ * @retval	NONE
+ */
+void pixel_cache_put(texture_2d *tex, unsigned int variant) {
+    unsigned char *pixels = tex->pixel_data;
+    tex->pixel_data = NULL;
+
+    int width = tex->width >> TEXTURE_SCALE_SHIFT(tex->scale);
+    int height = tex->height >> TEXTURE_SCALE_SHIFT(tex->scale);
+    size_t size = (size_t)texture_2d_gpu_bytes(width, height, texture_format_bytes_per_texel(tex->num_channels, tex->pixel_type),
+                                               0, tex->num_levels);
+    if (!pixels || !size || size > m_max_bytes) {
+        buffer_pool_release(pixels);
+        return;
+    }
+
+    pixel_cache_entry *entry = (pixel_cache_entry *)malloc(sizeof(pixel_cache_entry));
+    entry->url = strdup(tex->url);
+    entry->variant = variant;
+    entry->spill = canvas_spill_queue(pixels, size);
+    entry->size = size;
+    entry->num_channels = tex->num_channels;
+    entry->width = tex->width;
+    entry->height = tex->height;
+    entry->original_width = tex->originalWidth;
+    entry->original_height = tex->originalHeight;
+    entry->scale = tex->scale;
+    entry->pixel_type = tex->pixel_type;
+    entry->num_levels = tex->num_levels;
+    memcpy(entry->content_hash, tex->content_hash, sizeof(entry->content_hash));
+    entry->content_hashed = tex->content_hashed;
+
+    pthread_mutex_lock(&m_mutex);
+    pixel_cache_entry *old = NULL;
+    HASH_FIND(hh, m_entries, entry->url, strlen(entry->url), old);
+    if (old) {
+        destroy_entry(old);
+    }
+    HASH_ADD_KEYPTR(hh, m_entries, entry->url, strlen(entry->url), entry);
+    trim_entries();
+    pthread_mutex_unlock(&m_mutex);
+}
+
+/**
+ * @name	pixel_cache_contains
+ * @brief	checks for texels to load an image from
+ * @param	url - (const char *) url of the image
+ * @param	variant - (unsigned int) what besides the url picks the texels
+ * @retval	bool - true if pixel_cache_take() should find them
+ */
+bool pixel_cache_contains(const char *url, unsigned int variant) {
+    pixel_cache_entry *entry = NULL;
+    pthread_mutex_lock(&m_mutex);
+    HASH_FIND(hh, m_entries, url, strlen(url), entry);
+    bool found = entry && entry->variant == variant;
+    pthread_mutex_unlock(&m_mutex);
+    return found;
+}
+
+/**
+ * @name	pixel_cache_take
+ * @brief	loads a texture from its cached texels, which leave the cache
+ * @param	tex - (texture_2d *) texture to fill in, pixel_data and the fields
+ *			describing it are set on success
+ * @param	variant - (unsigned int) what besides the url picks the texels
+ * @retval	bool - true if the texture was filled in
+ */
+bool pixel_cache_take(texture_2d *tex, unsigned int variant) {
+    pixel_cache_entry *entry = NULL;
+    pthread_mutex_lock(&m_mutex);
+    HASH_FIND(hh, m_entries, tex->url, strlen(tex->url), entry);
+    if (entry) {
+        HASH_DEL(m_entries, entry);
+    }
+    pthread_mutex_unlock(&m_mutex);
+
+    if (!entry) {
+        return false;
+    }
+
+    unsigned char *pixels = NULL;
+    if (entry->variant == variant) {
+        pixels = canvas_spill_restore(entry->spill);
+    } else {
+        canvas_spill_free(entry->spill);
+    }
+
+    if (pixels) {
+        buffer_pool_release(tex->pixel_data);
+        tex->pixel_data = pixels;
+        tex->num_channels = entry->num_channels;
+        tex->width = entry->width;
+        tex->height = entry->height;
+        tex->originalWidth = entry->original_width;
+        tex->originalHeight = entry->original_height;
+        tex->scale = entry->scale;
+        tex->failed = false;
+        tex->compression_type = 0;
+        tex->pixel_type = entry->pixel_type;
+        tex->num_levels = entry->num_levels;
+        tex->proxy_shift = 0;
+        tex->uploaded_levels = 0;
+        memcpy(tex->content_hash, entry->content_hash, sizeof(entry->content_hash));
+        tex->content_hashed = entry->content_hashed;
+    }
+
+    free(entry->url);
+    free(entry);
+    return pixels != NULL;
+}
+
+/**
+ * @name	pixel_cache_touch
+ * @brief	keeps an entry longest, for the texels of a texture just evicted
+ * @param	url - (const char *) url of the image
+ * @retval	NONE
+ */
+void pixel_cache_touch(const char *url) {
+    pixel_cache_entry *entry = NULL;
+    pthread_mutex_lock(&m_mutex);
+    HASH_FIND(hh, m_entries, url, strlen(url), entry);
+    if (entry) {
+        HASH_DEL(m_entries, entry);
+        HASH_ADD_KEYPTR(hh, m_entries, entry->url, strlen(entry->url), entry);
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
+
+/**
+ * @name	pixel_cache_set_max_bytes
+ * @brief	sets the memory the cache may hold, dropping entries past it
+ * @param	bytes - (size_t) budget in bytes, zero turns the cache off
+ * @retval	NONE
+ */
+void pixel_cache_set_max_bytes(size_t bytes) {
+    pthread_mutex_lock(&m_mutex);
+    m_max_bytes = bytes;
+    trim_entries();
+    pthread_mutex_unlock(&m_mutex);
+}
+
+/**
+ * @name	pixel_cache_get_bytes
+ * @brief	gets the memory the cache holds right now
+ * @retval	size_t - bytes, counting entries not compressed yet at full size
+ */
+size_t pixel_cache_get_bytes() {
+    size_t bytes = 0;
+    pixel_cache_entry *entry = NULL;
+    pixel_cache_entry *tmp = NULL;
+    pthread_mutex_lock(&m_mutex);
+    HASH_ITER(hh, m_entries, entry, tmp) {
+        bytes += canvas_spill_get_bytes(entry->spill);
+    }
+    pthread_mutex_unlock(&m_mutex);
+    return bytes;
+}
+
+/**
+ * @name	pixel_cache_clear
+ * @brief	drops every entry
+ * @retval	NONE
+ */
+void pixel_cache_clear() {
+    pixel_cache_entry *entry = NULL;
+    pixel_cache_entry *tmp = NULL;
+    pthread_mutex_lock(&m_mutex);
+    HASH_ITER(hh, m_entries, entry, tmp) {
+        destroy_entry(entry);
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
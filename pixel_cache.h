@@ -0,0 +1,47 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef PIXEL_CACHE_H
+#define PIXEL_CACHE_H
+
+#include "core/types.h"
+#include "core/texture_2d.h"
+
+/*
+ * Texels of evicted textures kept compressed in memory, so loading the image
+ * again is a decompress instead of a read, decode, halfsize and pad.  Entries
+ * are compressed on the canvas_spill worker thread and the least recently
+ * stored or evicted are dropped past PIXEL_CACHE_MAX_BYTES.  The variant is
+ * whatever besides the url changes the texels, a mismatch counts as a miss.
+ */
+#define PIXEL_CACHE_MAX_BYTES (32 * 1024 * 1024)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void pixel_cache_put(texture_2d *tex, unsigned int variant);
+bool pixel_cache_contains(const char *url, unsigned int variant);
+bool pixel_cache_take(texture_2d *tex, unsigned int variant);
+void pixel_cache_touch(const char *url);
+void pixel_cache_set_max_bytes(size_t bytes);
+size_t pixel_cache_get_bytes();
+void pixel_cache_clear();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
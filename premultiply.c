@@ -0,0 +1,269 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 premultiply.c
+ * @brief	premultiplied alpha row kernels for decoded images
+ */
+#include "core/premultiply.h"
+#include "core/util/detect.h"
+
+#if defined(GC_NEON)
+#include <arm_neon.h>
+#elif defined(GC_SSE2)
+#include <emmintrin.h>
+#endif
+
+// Premultiply alpha value
+#define MULT_ALPHA(c, a) (unsigned char)(((unsigned short)( c ) * (unsigned short)( a ) + 128) >> 8)
+
+#if defined(GC_SSE2) && !defined(GC_NEON)
+// Premultiplies two texels held as 16-bit channels, alpha is multiplied by
+// 256 so it comes out as it went in
+static __m128i premultiply_epi16(__m128i v) {
+    const __m128i color_lanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i alpha_one = _mm_set_epi16(256, 0, 0, 0, 256, 0, 0, 0);
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_or_si128(_mm_and_si128(a, color_lanes), alpha_one);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(v, a), _mm_set1_epi16(128)), 8);
+}
+
+// Sums 2x2 blocks of 8 texels from each row, 16 bits per channel: lo holds
+// the sums for output texels 0-1 and hi those for 2-3
+static void box_sum_epi16(__m128i a0, __m128i a1, __m128i b0, __m128i b1, __m128i *lo, __m128i *hi) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+    __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+    __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+    __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+    *lo = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+    *hi = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+}
+
+// Divides sums of n texels like the scalar path: (s + 1) >> 1, (s + 1) / 3
+// and (s + 2) >> 2, with the reciprocals exact for sums below 32768.  A
+// single texel or none is kept as it is
+static __m128i average_epi16(__m128i s, __m128i n) {
+    const __m128i n2 = _mm_cmpeq_epi16(n, _mm_set1_epi16(2));
+    const __m128i n3 = _mm_cmpeq_epi16(n, _mm_set1_epi16(3));
+    const __m128i n4 = _mm_cmpeq_epi16(n, _mm_set1_epi16(4));
+    const __m128i n23 = _mm_or_si128(n2, n3);
+
+    __m128i bias = _mm_or_si128(_mm_and_si128(n23, _mm_set1_epi16(1)), _mm_and_si128(n4, _mm_set1_epi16(2)));
+    __m128i mul = _mm_or_si128(_mm_or_si128(_mm_and_si128(n2, _mm_set1_epi16((short)0x8000)),
+                                            _mm_and_si128(n3, _mm_set1_epi16(21846))),
+                               _mm_and_si128(n4, _mm_set1_epi16(0x4000)));
+    __m128i avg = _mm_mulhi_epu16(_mm_add_epi16(s, bias), mul);
+    return _mm_or_si128(avg, _mm_andnot_si128(_mm_or_si128(n23, n4), s));
+}
+#endif
+
+/**
+ * @name	premultiply_row
+ * @brief	premultiplies a row of RGBA texels
+ * @param	in - (const unsigned char *) unpremultiplied texels
+ * @param	out - (unsigned char *) output texels, may be the same as in
+ * @param	width - (int) texels in the row
+ * @retval	NONE
+ */
+void premultiply_row(const unsigned char *in, unsigned char *out, int width) {
+    int x = 0;
+
+#if defined(GC_NEON)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t p = vld4q_u8(in + x * 4);
+        int c;
+
+        for (c = 0; c < 3; ++c) {
+            // (c * a + 128) >> 8
+            uint8x8_t lo = vrshrn_n_u16(vmull_u8(vget_low_u8(p.val[c]), vget_low_u8(p.val[3])), 8);
+            uint8x8_t hi = vrshrn_n_u16(vmull_u8(vget_high_u8(p.val[c]), vget_high_u8(p.val[3])), 8);
+            p.val[c] = vcombine_u8(lo, hi);
+        }
+        vst4q_u8(out + x * 4, p);
+    }
+#elif defined(GC_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(in + x * 4));
+        __m128i lo = premultiply_epi16(_mm_unpacklo_epi8(p, zero));
+        __m128i hi = premultiply_epi16(_mm_unpackhi_epi8(p, zero));
+        _mm_storeu_si128((__m128i *)(out + x * 4), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        const unsigned char *p = in + x * 4;
+        unsigned char *o = out + x * 4;
+        unsigned short a = p[3];
+        o[0] = MULT_ALPHA(p[0], a);
+        o[1] = MULT_ALPHA(p[1], a);
+        o[2] = MULT_ALPHA(p[2], a);
+        o[3] = (unsigned char)a;
+    }
+}
+
+/**
+ * @name	premultiply_halve_row
+ * @brief	averages 2x2 blocks of two RGBA rows into one premultiplied row of
+ *			half the width, ignoring clear texels.  passing the same row twice
+ *			averages 1x2 blocks, for the last row of an odd height
+ * @param	row0 - (const unsigned char *) upper row, 2 * out_width texels
+ * @param	row1 - (const unsigned char *) lower row, 2 * out_width texels
+ * @param	out - (unsigned char *) output row
+ * @param	out_width - (int) texels to write
+ * @retval	NONE
+ */
+void premultiply_halve_row(const unsigned char *row0, const unsigned char *row1, unsigned char *out, int out_width) {
+    int x = 0;
+
+#if defined(GC_NEON)
+    const uint8x16_t one8 = vdupq_n_u8(1);
+
+    for (; x + 8 <= out_width; x += 8) {
+        uint8x16x4_t a = vld4q_u8(row0 + x * 8);
+        uint8x16x4_t b = vld4q_u8(row1 + x * 8);
+        uint8x8x4_t r;
+        uint16x8_t avg[4];
+        int c;
+
+        // Clear texels add nothing, not even to the count
+        uint8x16_t used_a = vtstq_u8(a.val[3], a.val[3]);
+        uint8x16_t used_b = vtstq_u8(b.val[3], b.val[3]);
+        uint16x8_t n = vpadalq_u8(vpaddlq_u8(vandq_u8(used_a, one8)), vandq_u8(used_b, one8));
+
+        // (s + 1) >> 1, (s + 1) / 3 and (s + 2) >> 2 by reciprocals, exact for
+        // sums below 32768.  A single texel or none is kept as it is
+        uint16x8_t n2 = vceqq_u16(n, vdupq_n_u16(2));
+        uint16x8_t n3 = vceqq_u16(n, vdupq_n_u16(3));
+        uint16x8_t n4 = vceqq_u16(n, vdupq_n_u16(4));
+        uint16x8_t n23 = vorrq_u16(n2, n3);
+        uint16x8_t bias = vorrq_u16(vandq_u16(n23, vdupq_n_u16(1)), vandq_u16(n4, vdupq_n_u16(2)));
+        uint16x8_t mul = vorrq_u16(vorrq_u16(vandq_u16(n2, vdupq_n_u16(0x8000)), vandq_u16(n3, vdupq_n_u16(21846))),
+                                   vandq_u16(n4, vdupq_n_u16(0x4000)));
+        uint16x8_t keep = vmvnq_u16(vorrq_u16(n23, n4));
+
+        for (c = 0; c < 4; ++c) {
+            uint16x8_t s = vpadalq_u8(vpaddlq_u8(vandq_u8(a.val[c], used_a)), vandq_u8(b.val[c], used_b));
+            uint16x8_t t = vaddq_u16(s, bias);
+            uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(t), vget_low_u16(mul)), 16);
+            uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(t), vget_high_u16(mul)), 16);
+            avg[c] = vbslq_u16(keep, s, vcombine_u16(lo, hi));
+        }
+
+        for (c = 0; c < 3; ++c) {
+            r.val[c] = vrshrn_n_u16(vmulq_u16(avg[c], avg[3]), 8);
+        }
+        r.val[3] = vmovn_u16(avg[3]);
+        vst4_u8(out + x * 4, r);
+    }
+#elif defined(GC_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+    const __m128i one8 = _mm_set1_epi8(1);
+
+    for (; x + 4 <= out_width; x += 4) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + x * 8 + 16));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8 + 16));
+
+        // Clear texels add nothing, not even to the count
+        __m128i clear_a0 = _mm_cmpeq_epi32(_mm_and_si128(a0, alpha_mask), zero);
+        __m128i clear_a1 = _mm_cmpeq_epi32(_mm_and_si128(a1, alpha_mask), zero);
+        __m128i clear_b0 = _mm_cmpeq_epi32(_mm_and_si128(b0, alpha_mask), zero);
+        __m128i clear_b1 = _mm_cmpeq_epi32(_mm_and_si128(b1, alpha_mask), zero);
+
+        __m128i lo, hi, n_lo, n_hi;
+        box_sum_epi16(_mm_andnot_si128(clear_a0, a0), _mm_andnot_si128(clear_a1, a1),
+                      _mm_andnot_si128(clear_b0, b0), _mm_andnot_si128(clear_b1, b1), &lo, &hi);
+        box_sum_epi16(_mm_andnot_si128(clear_a0, one8), _mm_andnot_si128(clear_a1, one8),
+                      _mm_andnot_si128(clear_b0, one8), _mm_andnot_si128(clear_b1, one8), &n_lo, &n_hi);
+
+        lo = premultiply_epi16(average_epi16(lo, n_lo));
+        hi = premultiply_epi16(average_epi16(hi, n_hi));
+        _mm_storeu_si128((__m128i *)(out + x * 4), _mm_packus_epi16(lo, hi));
+    }
+#endif
+
+    for (; x < out_width; ++x) {
+        const unsigned char *p0 = row0 + x * 8;
+        const unsigned char *p1 = row1 + x * 8;
+        unsigned char *o = out + x * 4;
+
+        // Accumulate pixels with color data, ignore the clear ones
+        unsigned short a0 = p0[3], a1 = p0[7], a2 = p1[3], a3 = p1[7];
+        unsigned short a = 0, r = 0, g = 0, b = 0, acnt = 0;
+        if (a0) {
+            a += a0;
+            ++acnt;
+            r += p0[0];
+            g += p0[1];
+            b += p0[2];
+        }
+        if (a1) {
+            a += a1;
+            ++acnt;
+            r += p0[4];
+            g += p0[5];
+            b += p0[6];
+        }
+        if (a2) {
+            a += a2;
+            ++acnt;
+            r += p1[0];
+            g += p1[1];
+            b += p1[2];
+        }
+        if (a3) {
+            a += a3;
+            ++acnt;
+            r += p1[4];
+            g += p1[5];
+            b += p1[6];
+        }
+
+        // Average the resulting colors
+        switch (acnt) {
+        case 2:
+            a = (a + 1) >> 1;
+            r = (r + 1) >> 1;
+            g = (g + 1) >> 1;
+            b = (b + 1) >> 1;
+            break;
+        case 3:
+            a = (a + 1) / 3;
+            r = (r + 1) / 3;
+            g = (g + 1) / 3;
+            b = (b + 1) / 3;
+            break;
+        case 4:
+            a = (a + 2) >> 2;
+            r = (r + 2) >> 2;
+            g = (g + 2) >> 2;
+            b = (b + 2) >> 2;
+            break;
+        default:
+            break;
+        }
+
+        o[0] = MULT_ALPHA(r, a);
+        o[1] = MULT_ALPHA(g, a);
+        o[2] = MULT_ALPHA(b, a);
+        o[3] = (unsigned char)a;
+    }
+}
@@ -0,0 +1,40 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef PREMULTIPLY_H
+#define PREMULTIPLY_H
+
+#include "core/types.h"
+
+/*
+ * Row kernels that turn decoded RGBA texels into premultiplied ones, with
+ * SSE2 and NEON paths that give exactly the results of the scalar ones.
+ * Colors are multiplied by (c * a + 128) >> 8.  Halving averages each 2x2
+ * block over its texels that are not clear, so clear texels do not darken
+ * the edges of a sprite, then premultiplies the average.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void premultiply_row(const unsigned char *in, unsigned char *out, int width);
+void premultiply_halve_row(const unsigned char *row0, const unsigned char *row1, unsigned char *out, int out_width);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
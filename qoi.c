@@ -0,0 +1,294 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 qoi.c
+ * @brief	QOI lossless image decoder and encoder
+ */
+#include "core/qoi.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Each pixel is one chunk: a full RGB or RGBA value, an index into the 64
+ * most recently seen pixels, a small difference from the previous pixel, or a
+ * run of up to 62 repeats of it.  Everything is byte aligned, so decoding is
+ * a tight loop with no entropy coder behind it.
+ */
+#define QOI_OP_INDEX 0x00 // 00xxxxxx
+#define QOI_OP_DIFF  0x40 // 01xxxxxx
+#define QOI_OP_LUMA  0x80 // 10xxxxxx
+#define QOI_OP_RUN   0xc0 // 11xxxxxx
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+#define QOI_MASK_2   0xc0
+
+// Well past any texture size, keeps width * height * channels in range
+#define QOI_PIXELS_MAX 400000000
+
+#define QOI_HASH(p) (((p).rgba.r * 3 + (p).rgba.g * 5 + (p).rgba.b * 7 + (p).rgba.a * 11) & 63)
+
+static const unsigned char m_padding[QOI_PADDING_BYTES] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+static unsigned int read_u32_be(const unsigned char *p) {
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | (unsigned int)p[3];
+}
+
+static void write_u32_be(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+/**
+ * @name	qoi_read_header
+ * @brief	reads the size of a QOI image without decoding it
+ * @param	bits - (const unsigned char *) the file contents
+ * @param	length - (unsigned long) bytes in bits
+ * @param	width - (int *) set to the width in pixels
+ * @param	height - (int *) set to the height in pixels
+ * @param	channels - (int *) set to 3 or 4, the channels a decode gives
+ * @retval	bool - false if bits is not a QOI image or the header is bad
+ */
+bool qoi_read_header(const unsigned char *bits, unsigned long length, int *width, int *height, int *channels) {
+    if (!bits || length < QOI_HEADER_BYTES + QOI_PADDING_BYTES || memcmp(bits, "qoif", 4)) {
+        return false;
+    }
+
+    const unsigned int w = read_u32_be(bits + 4);
+    const unsigned int h = read_u32_be(bits + 8);
+    const int c = bits[12];
+    if (w == 0 || h == 0 || h >= QOI_PIXELS_MAX / w || (c != 3 && c != 4)) {
+        return false;
+    }
+
+    *width = (int)w;
+    *height = (int)h;
+    *channels = c;
+    return true;
+}
+
+/**
+ * @name	qoi_decoder_init
+ * @brief	readies a decoder for the first row of an image
+ * @param	dec - (qoi_decoder *) decoder to set up, it keeps pointers into bits
+ * @param	bits - (const unsigned char *) the file contents
+ * @param	length - (unsigned long) bytes in bits
+ * @retval	bool - false if the header is bad
+ */
+bool qoi_decoder_init(qoi_decoder *dec, const unsigned char *bits, unsigned long length) {
+    if (!qoi_read_header(bits, length, &dec->width, &dec->height, &dec->channels)) {
+        return false;
+    }
+
+    memset(dec->index, 0, sizeof(dec->index));
+    dec->px.rgba.r = 0;
+    dec->px.rgba.g = 0;
+    dec->px.rgba.b = 0;
+    dec->px.rgba.a = 255;
+    dec->run = 0;
+    dec->pos = bits + QOI_HEADER_BYTES;
+    dec->end = bits + length - QOI_PADDING_BYTES;
+    return true;
+}
+
+/**
+ * @name	qoi_decode_row
+ * @brief	decodes the next row, runs may carry over from one row to the next
+ * @param	dec - (qoi_decoder *) decoder from qoi_decoder_init
+ * @param	row - (unsigned char *) receives width * channels bytes
+ * @retval	bool - false if the chunks ran out before the row was done
+ */
+bool qoi_decode_row(qoi_decoder *dec, unsigned char *row) {
+    const unsigned char *p = dec->pos;
+    const unsigned char *end = dec->end;
+    const int channels = dec->channels;
+    unsigned char *out = row;
+    unsigned char *row_end = row + (size_t)dec->width * channels;
+    qoi_rgba px = dec->px;
+    int run = dec->run;
+    bool ok = true;
+
+    while (out < row_end) {
+        if (run == 0) {
+            // The end marker keeps every chunk's reads within the file
+            if (p >= end) {
+                ok = false;
+                break;
+            }
+
+            const int b1 = *p++;
+            run = 1;
+            if (b1 == QOI_OP_RGB) {
+                px.rgba.r = p[0];
+                px.rgba.g = p[1];
+                px.rgba.b = p[2];
+                p += 3;
+            } else if (b1 == QOI_OP_RGBA) {
+                px.rgba.r = p[0];
+                px.rgba.g = p[1];
+                px.rgba.b = p[2];
+                px.rgba.a = p[3];
+                p += 4;
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                px = dec->index[b1];
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                px.rgba.r += ((b1 >> 4) & 0x03) - 2;
+                px.rgba.g += ((b1 >> 2) & 0x03) - 2;
+                px.rgba.b += (b1 & 0x03) - 2;
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                const int b2 = *p++;
+                const int vg = (b1 & 0x3f) - 32;
+                px.rgba.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                px.rgba.g += vg;
+                px.rgba.b += vg - 8 + (b2 & 0x0f);
+            } else {
+                run = (b1 & 0x3f) + 1;
+            }
+            dec->index[QOI_HASH(px)] = px;
+        }
+
+        // Write out as much of the run as fits in this row
+        int count = (int)((row_end - out) / channels);
+        if (count > run) {
+            count = run;
+        }
+        run -= count;
+        if (channels == 4) {
+            while (count--) {
+                memcpy(out, &px, 4);
+                out += 4;
+            }
+        } else {
+            while (count--) {
+                out[0] = px.rgba.r;
+                out[1] = px.rgba.g;
+                out[2] = px.rgba.b;
+                out += 3;
+            }
+        }
+    }
+
+    dec->pos = p;
+    dec->px = px;
+    dec->run = run;
+    return ok;
+}
+
+/**
+ * @name	qoi_encode
+ * @brief	encodes straight (not premultiplied) pixels as a QOI file
+ * @param	pixels - (const unsigned char *) tightly packed rows
+ * @param	width - (int) width in pixels
+ * @param	height - (int) height in pixels
+ * @param	channels - (int) 3 or 4, also written to the header
+ * @param	size - (unsigned long *) set to the bytes in the returned file
+ * @retval	unsigned char * - the file, free with free(), or NULL
+ */
+unsigned char *qoi_encode(const unsigned char *pixels, int width, int height, int channels, unsigned long *size) {
+    if (width <= 0 || height <= 0 || height >= QOI_PIXELS_MAX / width || (channels != 3 && channels != 4)) {
+        return NULL;
+    }
+
+    // Worst case is a full RGBA chunk for every pixel
+    const unsigned long pixel_count = (unsigned long)width * height;
+    unsigned char *bytes = (unsigned char *)malloc(QOI_HEADER_BYTES + pixel_count * (channels + 1) + QOI_PADDING_BYTES);
+    if (!bytes) {
+        return NULL;
+    }
+
+    memcpy(bytes, "qoif", 4);
+    write_u32_be(bytes + 4, (unsigned int)width);
+    write_u32_be(bytes + 8, (unsigned int)height);
+    bytes[12] = (unsigned char)channels;
+    bytes[13] = 0; // sRGB with linear alpha
+
+    qoi_rgba index[64];
+    qoi_rgba px, px_prev;
+    unsigned char *p = bytes + QOI_HEADER_BYTES;
+    int run = 0;
+    unsigned long i;
+
+    memset(index, 0, sizeof(index));
+    px_prev.rgba.r = 0;
+    px_prev.rgba.g = 0;
+    px_prev.rgba.b = 0;
+    px_prev.rgba.a = 255;
+    px = px_prev;
+
+    for (i = 0; i < pixel_count; ++i) {
+        const unsigned char *in = pixels + i * channels;
+        px.rgba.r = in[0];
+        px.rgba.g = in[1];
+        px.rgba.b = in[2];
+        if (channels == 4) {
+            px.rgba.a = in[3];
+        }
+
+        if (px.v == px_prev.v) {
+            ++run;
+            if (run == 62 || i == pixel_count - 1) {
+                *p++ = (unsigned char)(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0) {
+            *p++ = (unsigned char)(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        const int hash = QOI_HASH(px);
+        if (index[hash].v == px.v) {
+            *p++ = (unsigned char)(QOI_OP_INDEX | hash);
+        } else {
+            index[hash] = px;
+
+            if (px.rgba.a == px_prev.rgba.a) {
+                const signed char vr = (signed char)(px.rgba.r - px_prev.rgba.r);
+                const signed char vg = (signed char)(px.rgba.g - px_prev.rgba.g);
+                const signed char vb = (signed char)(px.rgba.b - px_prev.rgba.b);
+                const signed char vg_r = (signed char)(vr - vg);
+                const signed char vg_b = (signed char)(vb - vg);
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    *p++ = (unsigned char)(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+                    *p++ = (unsigned char)(QOI_OP_LUMA | (vg + 32));
+                    *p++ = (unsigned char)((vg_r + 8) << 4 | (vg_b + 8));
+                } else {
+                    *p++ = QOI_OP_RGB;
+                    *p++ = px.rgba.r;
+                    *p++ = px.rgba.g;
+                    *p++ = px.rgba.b;
+                }
+            } else {
+                *p++ = QOI_OP_RGBA;
+                *p++ = px.rgba.r;
+                *p++ = px.rgba.g;
+                *p++ = px.rgba.b;
+                *p++ = px.rgba.a;
+            }
+        }
+        px_prev = px;
+    }
+
+    memcpy(p, m_padding, QOI_PADDING_BYTES);
+    p += QOI_PADDING_BYTES;
+    *size = (unsigned long)(p - bytes);
+    return bytes;
+}
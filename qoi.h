@@ -0,0 +1,60 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef QOI_H
+#define QOI_H
+
+#include "core/types.h"
+
+/*
+ * QOI ("Quite OK Image") lossless images, for bundled assets that decode
+ * several times faster than PNG at a similar size.  A 14-byte header ("qoif",
+ * big-endian width and height, 3 or 4 channels, colorspace) is followed by
+ * byte-aligned chunks and an 8-byte end marker.  tools/qoi_convert makes them
+ * from PNGs at build time.
+ */
+#define QOI_HEADER_BYTES 14
+#define QOI_PADDING_BYTES 8
+
+typedef union qoi_rgba_t {
+	struct { unsigned char r, g, b, a; } rgba;
+	unsigned int v;
+} qoi_rgba;
+
+typedef struct qoi_decoder_t {
+	const unsigned char *pos;
+	const unsigned char *end;    // Start of the end marker
+	qoi_rgba index[64];          // Recently seen pixels by hash
+	qoi_rgba px;
+	int run;                     // Repeats of px still to write
+	int width;
+	int height;
+	int channels;
+} qoi_decoder;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool qoi_read_header(const unsigned char *bits, unsigned long length, int *width, int *height, int *channels);
+bool qoi_decoder_init(qoi_decoder *dec, const unsigned char *bits, unsigned long length);
+bool qoi_decode_row(qoi_decoder *dec, unsigned char *row);
+unsigned char *qoi_encode(const unsigned char *pixels, int width, int height, int channels, unsigned long *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
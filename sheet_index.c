@@ -0,0 +1,249 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 sheet_index.c
+ * @brief	binary spritesheet size index, see sheet_index.h for the format
+ */
+#include "core/sheet_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int read_u32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void write_u32(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+/**
+ * @name	sheet_index_load
+ * @brief	validates an index file and wraps it for lookups
+ * @param	data - (unsigned char *) file contents, owned by the index on success
+ * @param	size - (unsigned long) length of the file contents
+ * @retval	sheet_index* - the index, or NULL if the data is not a valid index
+ */
+sheet_index *sheet_index_load(unsigned char *data, unsigned long size) {
+    if (!data || size < SHEET_INDEX_HEADER_SIZE || memcmp(data, SHEET_INDEX_MAGIC, 4)) {
+        return NULL;
+    }
+
+    unsigned int count = read_u32(data + 4);
+    unsigned int strings_size = read_u32(data + 8);
+    unsigned long entries_size = (unsigned long)count * SHEET_INDEX_ENTRY_SIZE;
+
+    if (entries_size / SHEET_INDEX_ENTRY_SIZE != count ||
+        SHEET_INDEX_HEADER_SIZE + entries_size + strings_size != size ||
+        (strings_size > 0 && data[size - 1] != '\0')) {
+        return NULL;
+    }
+
+    // Every name must start inside the pool, the trailing NUL bounds the rest
+    const unsigned char *entries = data + SHEET_INDEX_HEADER_SIZE;
+    unsigned int i;
+    for (i = 0; i < count; ++i) {
+        if (read_u32(entries + i * SHEET_INDEX_ENTRY_SIZE) >= strings_size) {
+            return NULL;
+        }
+    }
+
+    sheet_index *index = (sheet_index *)malloc(sizeof(sheet_index));
+    index->data = data;
+    index->size = size;
+    index->count = count;
+    index->entries = entries;
+    index->strings = (const char *)(entries + entries_size);
+    index->strings_size = strings_size;
+    return index;
+}
+
+/**
+ * @name	sheet_index_lookup
+ * @brief	binary searches the index for a spritesheet
+ * @param	index - (sheet_index *) index to search
+ * @param	name - (const char *) url of the spritesheet
+ * @param	width - (int *) out: width of the sheet, if found
+ * @param	height - (int *) out: height of the sheet, if found
+ * @retval	bool - true if the sheet was found
+ */
+bool sheet_index_lookup(sheet_index *index, const char *name, int *width, int *height) {
+    unsigned int lo = 0, hi = index->count;
+
+    while (lo < hi) {
+        unsigned int mid = lo + ((hi - lo) >> 1);
+        const unsigned char *entry = index->entries + mid * SHEET_INDEX_ENTRY_SIZE;
+        int cmp = strcmp(name, index->strings + read_u32(entry));
+
+        if (cmp == 0) {
+            *width = (int)read_u32(entry + 4);
+            *height = (int)read_u32(entry + 8);
+            return true;
+        } else if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @name	sheet_index_get
+ * @brief	reads an entry by position, in name order
+ * @param	index - (sheet_index *) index to read
+ * @param	i - (unsigned int) position of the entry
+ * @param	name - (const char **) out: url of the spritesheet
+ * @param	width - (int *) out: width of the sheet
+ * @param	height - (int *) out: height of the sheet
+ * @retval	bool - false if the position is out of range
+ */
+bool sheet_index_get(sheet_index *index, unsigned int i, const char **name, int *width, int *height) {
+    if (i >= index->count) {
+        return false;
+    }
+
+    const unsigned char *entry = index->entries + i * SHEET_INDEX_ENTRY_SIZE;
+    *name = index->strings + read_u32(entry);
+    *width = (int)read_u32(entry + 4);
+    *height = (int)read_u32(entry + 8);
+    return true;
+}
+
+/**
+ * @name	sheet_index_destroy
+ * @brief	frees an index and the file contents it wraps
+ * @param	index - (sheet_index *) index to free
+ * @retval	NONE
+ */
+void sheet_index_destroy(sheet_index *index) {
+    if (index) {
+        free(index->data);
+        free(index);
+    }
+}
+
+static const char **m_sort_names = NULL;
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(m_sort_names[*(const unsigned int *)a], m_sort_names[*(const unsigned int *)b]);
+}
+
+/**
+ * @name	sheet_index_build
+ * @brief	serializes spritesheet sizes into the index format
+ * @param	names - (const char **) spritesheet urls, must be unique
+ * @param	widths - (const int *) width of each sheet
+ * @param	heights - (const int *) height of each sheet
+ * @param	count - (unsigned int) number of sheets
+ * @param	out_size - (unsigned long *) out: length of the returned data
+ * @retval	unsigned char* - index file contents to be freed by the caller, or NULL on failure
+ */
+unsigned char *sheet_index_build(const char **names, const int *widths, const int *heights, unsigned int count, unsigned long *out_size) {
+    unsigned int *order = (unsigned int *)malloc((count ? count : 1) * sizeof(unsigned int));
+    unsigned long strings_size = 0;
+    unsigned int i;
+
+    if (!order) {
+        return NULL;
+    }
+
+    for (i = 0; i < count; ++i) {
+        order[i] = i;
+        strings_size += strlen(names[i]) + 1;
+    }
+
+    // Not reentrant, indexes are only built by tools and once at startup
+    m_sort_names = names;
+    qsort(order, count, sizeof(unsigned int), compare_names);
+    m_sort_names = NULL;
+
+    unsigned long size = SHEET_INDEX_HEADER_SIZE + (unsigned long)count * SHEET_INDEX_ENTRY_SIZE + strings_size;
+    unsigned char *data = (unsigned char *)malloc(size);
+    if (!data) {
+        free(order);
+        return NULL;
+    }
+
+    memcpy(data, SHEET_INDEX_MAGIC, 4);
+    write_u32(data + 4, count);
+    write_u32(data + 8, (unsigned int)strings_size);
+
+    unsigned char *entry = data + SHEET_INDEX_HEADER_SIZE;
+    char *strings = (char *)(entry + (unsigned long)count * SHEET_INDEX_ENTRY_SIZE);
+    unsigned int offset = 0;
+
+    for (i = 0; i < count; ++i, entry += SHEET_INDEX_ENTRY_SIZE) {
+        unsigned int j = order[i];
+        size_t len = strlen(names[j]) + 1;
+
+        write_u32(entry, offset);
+        write_u32(entry + 4, (unsigned int)widths[j]);
+        write_u32(entry + 8, (unsigned int)heights[j]);
+        memcpy(strings + offset, names[j], len);
+        offset += (unsigned int)len;
+    }
+
+    free(order);
+    *out_size = size;
+    return data;
+}
+
+/**
+ * @name	sheet_index_build_from_json
+ * @brief	serializes a spritesheetSizeMap.json document into the index format.
+ *			entries without integer "w" and "h" members are skipped
+ * @param	root - (json_t *) object mapping sheet urls to {"w": width, "h": height}
+ * @param	out_size - (unsigned long *) out: length of the returned data
+ * @retval	unsigned char* - index file contents to be freed by the caller, or NULL on failure
+ */
+unsigned char *sheet_index_build_from_json(json_t *root, unsigned long *out_size) {
+    if (!json_is_object(root)) {
+        return NULL;
+    }
+
+    size_t max = json_object_size(root);
+    const char **names = (const char **)malloc((max ? max : 1) * sizeof(const char *));
+    int *widths = (int *)malloc((max ? max : 1) * sizeof(int));
+    int *heights = (int *)malloc((max ? max : 1) * sizeof(int));
+    unsigned int count = 0;
+    unsigned char *data = NULL;
+
+    if (names && widths && heights) {
+        const char *key;
+        json_t *value;
+        json_object_foreach(root, key, value) {
+            json_t *width_obj = json_object_get(value, "w");
+            json_t *height_obj = json_object_get(value, "h");
+            if (json_is_integer(width_obj) && json_is_integer(height_obj)) {
+                names[count] = key;
+                widths[count] = (int)json_integer_value(width_obj);
+                heights[count] = (int)json_integer_value(height_obj);
+                ++count;
+            }
+        }
+
+        data = sheet_index_build(names, widths, heights, count, out_size);
+    }
+
+    free(names);
+    free(widths);
+    free(heights);
+    return data;
+}
@@ -0,0 +1,61 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef SHEET_INDEX_H
+#define SHEET_INDEX_H
+
+#include "core/types.h"
+#include "core/deps/jansson/jansson.h"
+
+/*
+ * Binary spritesheet size index: a sorted string table that is searched in
+ * place, so loading it is a single read with no parsing.
+ *
+ * All integers are little-endian uint32:
+ *
+ *   magic "SSI1", entry count, string pool size
+ *   entries, sorted by name bytes: name offset in pool, width, height
+ *   string pool of NUL-terminated names
+ */
+#define SHEET_INDEX_MAGIC "SSI1"
+#define SHEET_INDEX_HEADER_SIZE 12
+#define SHEET_INDEX_ENTRY_SIZE 12
+
+typedef struct sheet_index_t {
+	unsigned char *data;
+	unsigned long size;
+	unsigned int count;
+	const unsigned char *entries;
+	const char *strings;
+	unsigned int strings_size;
+} sheet_index;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+sheet_index *sheet_index_load(unsigned char *data, unsigned long size);
+bool sheet_index_lookup(sheet_index *index, const char *name, int *width, int *height);
+bool sheet_index_get(sheet_index *index, unsigned int i, const char **name, int *width, int *height);
+void sheet_index_destroy(sheet_index *index);
+
+unsigned char *sheet_index_build(const char **names, const int *widths, const int *heights, unsigned int count, unsigned long *out_size);
+unsigned char *sheet_index_build_from_json(json_t *root, unsigned long *out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
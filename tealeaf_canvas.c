@@ -76,6 +76,9 @@ void tealeaf_canvas_bind_texture_buffer(context_2d *ctx) {
         return;
     }
 
+    // a canvas spilled under memory pressure needs its texture back first
+    texture_manager_restore_canvas(texture_manager_get(), tex);
+
     GLTRACE(glBindTexture(GL_TEXTURE_2D, tex->name));
     GLTRACE(glFinish());
     GLTRACE(glBindFramebuffer(GL_FRAMEBUFFER, canvas.offscreen_framebuffer));
@@ -23,8 +23,10 @@
 #include "core/draw_textures.h"
 #include "core/texture_2d.h"
 #include "core/texture_manager.h"
+#include "core/texture_atlas.h"
 #include "core/geometry.h"
 #include "core/image_writer.h"
+#include "core/image_export.h"
 #include "core/graphics_utils.h"
 #include <math.h>
 #include <stdlib.h>
@@ -245,6 +247,47 @@ char *context_2d_save_buffer_to_base64(context_2d *ctx, const char *image_type)
     free(buffer);
     return buf;
 }
+
+/**
+ * @name	context_2d_export_to_base64
+ * @brief	reads back the context's buffer and encodes it on the export worker,
+ *			the Base64 text arrives with an "imageExport" event
+ * @param	ctx - (context_2d *) context to export
+ * @param	image_type - (const char *) "PNG", "JPG" or "JPEG"
+ * @retval	int - id of the export, 0 if the export queue is full
+ */
+int context_2d_export_to_base64(context_2d *ctx, const char *image_type) {
+    tealeaf_canvas_context_2d_bind(ctx);
+    unsigned char *buffer = context_2d_read_pixels(ctx);
+    tealeaf_canvas_context_2d_bind(context_2d_get_onscreen());
+
+    int id = image_export_queue_base64(buffer, ctx->width, ctx->height, 4, image_type);
+    if (!id) {
+        free(buffer);
+    }
+    return id;
+}
+
+/**
+ * @name	context_2d_export_to_file
+ * @brief	reads back the context's buffer and writes it to a file on the export
+ *			worker, an "imageExport" event follows
+ * @param	ctx - (context_2d *) context to export
+ * @param	path - (const char *) directory to write to
+ * @param	name - (const char *) file name, the extension picks PNG or JPEG
+ * @retval	int - id of the export, 0 if the export queue is full
+ */
+int context_2d_export_to_file(context_2d *ctx, const char *path, const char *name) {
+    tealeaf_canvas_context_2d_bind(ctx);
+    unsigned char *buffer = context_2d_read_pixels(ctx);
+    tealeaf_canvas_context_2d_bind(context_2d_get_onscreen());
+
+    int id = image_export_queue_file(buffer, ctx->width, ctx->height, 4, path, name);
+    if (!id) {
+        free(buffer);
+    }
+    return id;
+}
 /**
  * @name	context_2d_delete
  * @brief	frees the given context
@@ -708,6 +751,11 @@ void context_2d_draw_point_sprites(context_2d *ctx, const char *url, float point
         return;
     }
 
+    // Point sprites span the whole texture, so they cannot share a page
+    if (!texture_atlas_detach(tex)) {
+        return;
+    }
+
     static GLfloat     *vertex_buffer = NULL;
     static unsigned int vertex_max = 64;
     tealeaf_shaders_bind(DRAWING_SHADER);
@@ -870,7 +918,7 @@ void context_2d_fillText(context_2d *ctx, texture_2d *img, const rect_2d *srcRec
     context_2d_bind(ctx);
 
     if (img && img->loaded) {
-        draw_textures_item(ctx, GET_MODEL_VIEW_MATRIX(ctx), img->name, img->width, img->height, img->originalWidth, img->originalHeight, *srcRect, *destRect, *GET_CLIPPING_BOUNDS(ctx), ctx->globalAlpha[ctx->mvp] * alpha, ctx->globalCompositeOperation[ctx->mvp], &ctx->filter_color, ctx->filter_type);
+        draw_textures_item(ctx, GET_MODEL_VIEW_MATRIX(ctx), img->name, img->width, img->height, img->originalWidth, img->originalHeight, *srcRect, *destRect, *GET_CLIPPING_BOUNDS(ctx), ctx->globalAlpha[ctx->mvp] * alpha, ctx->globalCompositeOperation[ctx->mvp], &ctx->filter_color, ctx->filter_type, false);
     }
 }
 
@@ -884,6 +932,48 @@ void context_2d_flush(context_2d *ctx) {
     draw_textures_flush();
 }
 
+/**
+ * @name	draw_texture
+ * @brief	queues a loaded texture to be drawn, remapping the source rect for atlas pages
+ * @param	ctx - (context_2d *) context to draw to
+ * @param	tex - (texture_2d *) loaded texture to draw from
+ * @param	srcRect - (const rect_2d *) source rectangle on the texture to draw from
+ * @param	destRect - (const rect_2d *) destination rect to draw to
+ * @retval	NONE
+ */
+static void draw_texture(context_2d *ctx, texture_2d *tex, const rect_2d *srcRect, const rect_2d *destRect) {
+    if (srcRect->width && srcRect->height) {
+        // Squared screen pixels per image pixel along each axis, source rects
+        // are in unscaled image pixels so these pick the level of detail
+        const matrix_3x3 *m = GET_MODEL_VIEW_MATRIX(ctx);
+        float sx = destRect->width / srcRect->width;
+        float sy = destRect->height / srcRect->height;
+        float scale_x2 = sx * sx * (m->m00 * m->m00 + m->m10 * m->m10);
+        float scale_y2 = sy * sy * (m->m01 * m->m01 + m->m11 * m->m11);
+        texture_manager_mark_drawn(tex, scale_x2 > scale_y2 ? scale_x2 : scale_y2);
+
+        // and per texel, less than half a pixel along both axes needs mipmaps
+        float texel2 = (float)(tex->scale * tex->scale);
+        if (tex->num_levels > 1 && scale_x2 * texel2 < 0.25f && scale_y2 * texel2 < 0.25f) {
+            texture_manager_mark_minified(tex);
+        }
+    }
+
+    // Opaque source rects skip blending in the opaque pass
+    const bool opaque = draw_textures_get_opaque_pass() && texture_2d_is_opaque_rect(tex, srcRect);
+
+    if (tex->atlas_page) {
+        // Remap the source rect into the shared page
+        rect_2d src = *srcRect;
+        int page_size = ATLAS_PAGE_SIZE * tex->scale;
+        src.x += tex->atlas_x * tex->scale;
+        src.y += tex->atlas_y * tex->scale;
+        draw_textures_item(ctx, GET_MODEL_VIEW_MATRIX(ctx), tex->name, page_size, page_size, tex->originalWidth, tex->originalHeight, src, *destRect, * GET_CLIPPING_BOUNDS(ctx), ctx->globalAlpha[ctx->mvp], ctx->globalCompositeOperation[ctx->mvp], &ctx->filter_color, ctx->filter_type, opaque);
+    } else {
+        draw_textures_item(ctx, GET_MODEL_VIEW_MATRIX(ctx), tex->name, tex->width, tex->height, tex->originalWidth, tex->originalHeight, *srcRect, *destRect, * GET_CLIPPING_BOUNDS(ctx), ctx->globalAlpha[ctx->mvp], ctx->globalCompositeOperation[ctx->mvp], &ctx->filter_color, ctx->filter_type, opaque);
+    }
+}
+
 /**
  * @name	context_2d_drawImage
  * @brief	darws an image to the given context using given options
@@ -900,7 +990,25 @@ void context_2d_drawImage(context_2d *ctx, int srcTex, const char *url, const re
     texture_2d *tex = texture_manager_load_texture(texture_manager_get(), url);
 
     if (tex && tex->loaded) {
-        draw_textures_item(ctx, GET_MODEL_VIEW_MATRIX(ctx), tex->name, tex->width, tex->height, tex->originalWidth, tex->originalHeight, *srcRect, *destRect, * GET_CLIPPING_BOUNDS(ctx), ctx->globalAlpha[ctx->mvp], ctx->globalCompositeOperation[ctx->mvp], &ctx->filter_color, ctx->filter_type);
+        draw_texture(ctx, tex, srcRect, destRect);
+    }
+}
+
+/**
+ * @name	context_2d_drawImage_handle
+ * @brief	draws an image to the given context, looking the texture up by interned handle
+ * @param	ctx - (context_2d *) context to draw to
+ * @param	handle - (int) handle from texture_manager_get_handle()
+ * @param	srcRect - (const rect_2d *) source rectangle on the texture to draw from
+ * @param	destRect - (const rect_2d *) destination rect to draw to
+ * @retval	NONE
+ */
+void context_2d_drawImage_handle(context_2d *ctx, int handle, const rect_2d *srcRect, const rect_2d *destRect) {
+    context_2d_bind(ctx);
+    texture_2d *tex = texture_manager_load_texture_by_handle(texture_manager_get(), handle);
+
+    if (tex && tex->loaded) {
+        draw_texture(ctx, tex, srcRect, destRect);
     }
 }
 
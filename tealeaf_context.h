@@ -81,6 +81,8 @@ context_2d *context_2d_init(tealeaf_canvas *canvas, const char *url, int dest_te
 
 unsigned char *context_2d_read_pixels(context_2d *ctx);
 char *context_2d_save_buffer_to_base64(context_2d *ctx, const char *image_type);
+int context_2d_export_to_base64(context_2d *ctx, const char *image_type);
+int context_2d_export_to_file(context_2d *ctx, const char *path, const char *name);
 
 void context_2d_delete(context_2d *ctx);
 void context_2d_resize(context_2d *ctx, int w, int h);
@@ -102,6 +104,7 @@ void context_2d_fillRect(context_2d *ctx, const rect_2d *rect, const rgba *color
 void context_2d_fillText(context_2d *ctx, texture_2d *img, const rect_2d *srcRect, const rect_2d *destRect, float alpha);
 void context_2d_flush(context_2d *ctx);
 void context_2d_drawImage(context_2d *ctx, int srcTex, const char *url, const rect_2d *srcRect, const rect_2d *destRect);
+void context_2d_drawImage_handle(context_2d *ctx, int handle, const rect_2d *srcRect, const rect_2d *destRect);
 void context_2d_draw_point_sprites(context_2d *ctx, const char *url, float point_size, float step_size, rgba *color, float x1, float y1, float x2, float y2);
 
 
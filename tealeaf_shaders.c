@@ -23,9 +23,12 @@
 #include "core/log.h"
 #include <stdlib.h>
 
+/* Vertex coordinates take a depth for the opaque pass in draw_textures.c,
+ * other draws give two components and the depth defaults to zero.
+ */
 static char *linear_add_vertex_shader_code = "														\
 																						\
-  attribute vec2 attr_vertex_coord;														\
+  attribute vec3 attr_vertex_coord;														\
   attribute vec2 attr_tex_coord;														\
   																						\
   uniform mat4 proj_matrix;																\
@@ -33,7 +36,7 @@ static char *linear_add_vertex_shader_code = "														\
   varying vec2 v_tex_coord;																\
 																						\
   void main(void) {																		\
-    gl_Position = proj_matrix * vec4(attr_vertex_coord, 0.0, 1.0);						\
+    gl_Position = proj_matrix * vec4(attr_vertex_coord, 1.0);							\
     v_tex_coord = attr_tex_coord;														\
   }																						\
 ";
@@ -62,7 +65,7 @@ static char *linear_add_fragment_shader_code = "													\
 
 static char *vertex_shader_code = "														\
 																						\
-  attribute vec2 attr_vertex_coord;														\
+  attribute vec3 attr_vertex_coord;														\
   attribute vec2 attr_tex_coord;														\
   																						\
   uniform mat4 proj_matrix;																\
@@ -70,7 +73,7 @@ static char *vertex_shader_code = "														\
   varying vec2 v_tex_coord;																\
 																						\
   void main(void) {																		\
-    gl_Position = proj_matrix * vec4(attr_vertex_coord, 0.0, 1.0);						\
+    gl_Position = proj_matrix * vec4(attr_vertex_coord, 1.0);							\
     v_tex_coord = attr_tex_coord;														\
   }																						\
 ";
@@ -21,17 +21,91 @@
 #include "platform/gl.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "core/tealeaf_canvas.h"
 #include "core/tealeaf_context.h"
 #include "core/log.h"
 #include "core/image_loader.h"
 #include "core/core.h"
+#include "core/texture_atlas.h"
+#include "core/texture_manager.h"
+#include "core/texture_format.h"
+#include "core/etc1.h"
+#include "core/compressed_texture.h"
+#include "core/mipmap.h"
+#include "core/premultiply.h"
+#include "core/canvas_spill.h"
+#include "core/buffer_pool.h"
+#include "core/image-cache/include/image_cache.h"
 
 // Enable this to print out the texture loader scaling and resizing operations
 //#define VERBOSE_LOAD_TEX
 
 static int offscreen_canvas_count = 0;
 
+// Capabilities of the current GL context, see texture_2d_detect_gl_caps()
+int texture_2d_gl_caps = 0;
+
+static bool has_gl_extension(const char *extensions, const char *name) {
+    size_t len = strlen(name);
+    const char *found = extensions;
+
+    while (found && (found = strstr(found, name))) {
+        // Must match a whole space-separated token
+        if ((found == extensions || found[-1] == ' ') && (found[len] == ' ' || found[len] == '\0')) {
+            return true;
+        }
+        found += len;
+    }
+
+    return false;
+}
+
+/**
+ * @name	texture_2d_detect_gl_caps
+ * @brief	queries the current GL context for texture features. must be called
+ *			on the GL thread once the context is ready
+ * @retval	NONE
+ */
+void texture_2d_detect_gl_caps() {
+    int caps = 0;
+    const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+
+    const char *version = (const char *)glGetString(GL_VERSION);
+
+#ifdef GL_ES
+    // ES 2.0 samples any size without mipmaps as long as it clamps to edge
+    caps |= TEXTURE_CAP_NPOT;
+
+    // "OpenGL ES 3.0 ...": ETC2 is core from 3.0
+    if (version && !strncmp(version, "OpenGL ES ", 10) && atoi(version + 10) >= 3) {
+        caps |= TEXTURE_CAP_ETC2;
+    }
+#else
+    if ((version && atoi(version) >= 2) || has_gl_extension(extensions, "GL_ARB_texture_non_power_of_two")) {
+        caps |= TEXTURE_CAP_NPOT;
+    }
+#endif
+
+    if (has_gl_extension(extensions, "GL_OES_compressed_ETC1_RGB8_texture")) {
+        caps |= TEXTURE_CAP_ETC1;
+    }
+    if (has_gl_extension(extensions, "GL_ARB_ES3_compatibility")) {
+        caps |= TEXTURE_CAP_ETC2;
+    }
+    if (has_gl_extension(extensions, "GL_EXT_texture_compression_s3tc")) {
+        caps |= TEXTURE_CAP_S3TC;
+    }
+    if (has_gl_extension(extensions, "GL_KHR_texture_compression_astc_ldr")) {
+        caps |= TEXTURE_CAP_ASTC;
+    }
+
+    texture_2d_gl_caps = caps;
+    LOG("{tex} Texture caps: npot=%d etc1=%d etc2=%d s3tc=%d astc=%d", (caps & TEXTURE_CAP_NPOT) != 0,
+        (caps & TEXTURE_CAP_ETC1) != 0, (caps & TEXTURE_CAP_ETC2) != 0, (caps & TEXTURE_CAP_S3TC) != 0,
+        (caps & TEXTURE_CAP_ASTC) != 0);
+}
+
 /**
  * @name	texture_2d_new_from_image
  * @brief	creates a new texture from an already created image
@@ -56,7 +130,7 @@ texture_2d *texture_2d_new_from_image(char *url, int name, int width, int height
     tex->is_text = false;
     tex->is_canvas = false;
     tex->ctx = NULL;
-    tex->saved_data = NULL;
+    tex->spill = NULL;
     tex->pixel_data = NULL;
     tex->loaded = false;
     tex->prev = tex->next = NULL;
@@ -65,7 +139,28 @@ texture_2d *texture_2d_new_from_image(char *url, int name, int width, int height
     tex->assumed_texture_bytes = width * height * 4;
     tex->used_texture_bytes = 0;
     tex->compression_type = 0;
+    tex->pixel_type = 0;
+    tex->num_levels = 1;
+    tex->proxy_shift = 0;
+    tex->uploaded_levels = 0;
+    tex->minified_epoch = -1;
+    tex->mipmapped = false;
+    tex->draw_scale2 = 0;
+    tex->lod_low_windows = 0;
+    memset(&tex->opacity, 0, sizeof(tex->opacity));
+    memset(&tex->pending_opacity, 0, sizeof(tex->pending_opacity));
+    tex->content_hashed = false;
+    tex->shared = NULL;
     tex->frame_epoch = 0;
+    tex->atlas_page = NULL;
+    tex->atlas_x = 0;
+    tex->atlas_y = 0;
+    tex->atlas_index = -1;
+    tex->handle = 0;
+    tex->load_requested_at = 0;
+    tex->load_latency_ms = 0;
+    tex->hits = 0;
+    tex->misses = 0;
     return tex;
 }
 
@@ -99,7 +194,7 @@ texture_2d *texture_2d_new_from_url(char *url) {
     tex->is_text = false;
     tex->is_canvas = false;
     tex->ctx = NULL;
-    tex->saved_data = NULL;
+    tex->spill = NULL;
     tex->pixel_data = NULL;
     tex->loaded = false;
     tex->prev = tex->next = NULL;
@@ -108,7 +203,28 @@ texture_2d *texture_2d_new_from_url(char *url) {
     tex->assumed_texture_bytes = 0;
     tex->used_texture_bytes = 0;
     tex->compression_type = 0;
+    tex->pixel_type = 0;
+    tex->num_levels = 1;
+    tex->proxy_shift = 0;
+    tex->uploaded_levels = 0;
+    tex->minified_epoch = -1;
+    tex->mipmapped = false;
+    tex->draw_scale2 = 0;
+    tex->lod_low_windows = 0;
+    memset(&tex->opacity, 0, sizeof(tex->opacity));
+    memset(&tex->pending_opacity, 0, sizeof(tex->pending_opacity));
+    tex->content_hashed = false;
+    tex->shared = NULL;
     tex->frame_epoch = 0;
+    tex->atlas_page = NULL;
+    tex->atlas_x = 0;
+    tex->atlas_y = 0;
+    tex->atlas_index = -1;
+    tex->handle = 0;
+    tex->load_requested_at = 0;
+    tex->load_latency_ms = 0;
+    tex->hits = 0;
+    tex->misses = 0;
     return tex;
 }
 
@@ -142,6 +258,7 @@ static inline int get_tex_from_data(int w, int h, const void *data) {
  */
 
 #define MIN_TEX_SIZE 1 /* Set minimum texture size */
+#define MIPMAP_MIN_SIZE 16 /* Smaller textures are not worth a mip chain */
 
 texture_2d *texture_2d_new_from_data(int width, int height, const void *data) {
     GLuint name;
@@ -155,8 +272,9 @@ texture_2d *texture_2d_new_from_data(int width, int height, const void *data) {
         h = MIN_TEX_SIZE;
     }
 
-    // Power up!
-    if ((w & (w-1))) {
+    // Power up! Unless the GPU takes any size
+    const bool npot = (texture_2d_gl_caps & TEXTURE_CAP_NPOT) != 0;
+    if (!npot && (w & (w-1))) {
         // Bump it up to the next power of 2 (stays the same if already po2)
         // NOTE: Result of w == 0 is 0, but above if-statement avoids this
         --w;
@@ -167,7 +285,7 @@ texture_2d *texture_2d_new_from_data(int width, int height, const void *data) {
         w |= w >> 16;
         ++w;
     }
-    if ((h & (h-1))) {
+    if (!npot && (h & (h-1))) {
         --h;
         h |= h >> 1;
         h |= h >> 2;
@@ -190,7 +308,7 @@ texture_2d *texture_2d_new_from_data(int width, int height, const void *data) {
     snprintf(tex->url, 64, "__canvas__%X", ++offscreen_canvas_count);
     tex->is_text = false;
     tex->is_canvas = true;
-    tex->saved_data = NULL;
+    tex->spill = NULL;
     tex->pixel_data = NULL;
     tex->loaded = true;
     tex->prev = tex->next = NULL;
@@ -199,7 +317,28 @@ texture_2d *texture_2d_new_from_data(int width, int height, const void *data) {
     tex->assumed_texture_bytes = width * height * 4;
     tex->used_texture_bytes = 0;
     tex->compression_type = 0;
+    tex->pixel_type = 0;
+    tex->num_levels = 1;
+    tex->proxy_shift = 0;
+    tex->uploaded_levels = 0;
+    tex->minified_epoch = -1;
+    tex->mipmapped = false;
+    tex->draw_scale2 = 0;
+    tex->lod_low_windows = 0;
+    memset(&tex->opacity, 0, sizeof(tex->opacity));
+    memset(&tex->pending_opacity, 0, sizeof(tex->pending_opacity));
+    tex->content_hashed = false;
+    tex->shared = NULL;
     tex->frame_epoch = 0;
+    tex->atlas_page = NULL;
+    tex->atlas_x = 0;
+    tex->atlas_y = 0;
+    tex->atlas_index = -1;
+    tex->handle = 0;
+    tex->load_requested_at = 0;
+    tex->load_latency_ms = 0;
+    tex->hits = 0;
+    tex->misses = 0;
     return tex;
 }
 
@@ -220,19 +359,190 @@ void texture_2d_resize_unsafe(texture_2d *tex, int width, int height) {
     tex->originalHeight = height;
 }
 
+/**
+ * @name	texture_2d_gpu_bytes
+ * @brief	computes the bytes a texture occupies on the GPU
+ * @param	width - (int) allocated width of the base level in texels
+ * @param	height - (int) allocated height of the base level in texels
+ * @param	num_channels - (int) bytes per texel for uncompressed textures,
+ *			see texture_format_bytes_per_texel()
+ * @param	compression_type - (int) GL compressed internal format, or zero
+ * @param	num_levels - (int) number of mip levels, including the base level
+ * @retval	long - bytes used, or zero if the compressed format is unknown
+ */
+long texture_2d_gpu_bytes(int width, int height, int num_channels, int compression_type, int num_levels) {
+    long total = 0;
+    int level;
+
+    if (compression_type && !compressed_texture_get_size(compression_type, 1, 1)) {
+        return 0;
+    }
+
+    for (level = 0; level < num_levels; ++level) {
+        if (compression_type) {
+            total += (long)compressed_texture_get_size(compression_type, width, height);
+        } else {
+            total += (long)width * height * num_channels;
+        }
+
+        width = width > 1 ? width >> 1 : 1;
+        height = height > 1 ? height >> 1 : 1;
+    }
+
+    return total;
+}
+
+/**
+ * @name	texture_2d_get_gpu_bytes
+ * @brief	computes the bytes a loaded texture occupies on the GPU
+ * @param	tex - (texture_2d *) texture to measure
+ * @retval	long - bytes used, or zero if unknown
+ */
+long texture_2d_get_gpu_bytes(texture_2d *tex) {
+    if (tex->atlas_page) {
+        return texture_atlas_get_bytes(tex);
+    }
+
+    // width and height are in source pixels, the texture holds them scaled down
+    int width = tex->width >> TEXTURE_SCALE_SHIFT(tex->scale);
+    int height = tex->height >> TEXTURE_SCALE_SHIFT(tex->scale);
+    if (tex->proxy_shift) {
+        width = (width + (1 << tex->proxy_shift) - 1) >> tex->proxy_shift;
+        height = (height + (1 << tex->proxy_shift) - 1) >> tex->proxy_shift;
+    }
+    return texture_2d_gpu_bytes(width, height, texture_format_bytes_per_texel(tex->num_channels, tex->pixel_type),
+                                tex->compression_type, tex->num_levels);
+}
+
+/**
+ * @name	texture_2d_clamp_scale
+ * @brief	limits the scale an image is loaded at so it keeps more than 32
+ *			texels along each side, small images are not worth reducing
+ * @param	scale - (int) wanted scale, 1, 2 or 4
+ * @param	width - (int) width of the image
+ * @param	height - (int) height of the image
+ * @retval	int - scale the image will be loaded at
+ */
+int texture_2d_clamp_scale(int scale, int width, int height) {
+    if (scale > TEXTURE_MAX_SCALE) {
+        scale = TEXTURE_MAX_SCALE;
+    }
+    while (scale > 1 && (width <= 32 * scale || height <= 32 * scale)) {
+        scale >>= 1;
+    }
+    return scale < 1 ? 1 : scale;
+}
+
+// Texel size and scale texture_2d_load_texture_raw gives an uncompressed image
+// loaded at the halfsize setting, without a level of detail of its own
+static void get_texel_size(int width, int height, int *out_width, int *out_height, int *out_scale) {
+    int w = width, h = height;
+    int scale = texture_2d_clamp_scale(use_halfsized_textures ? 2 : 1, w, h);
+    int s;
+
+    for (s = scale; s > 1; s >>= 1) {
+        w = (w + 1) >> 1;
+        h = (h + 1) >> 1;
+    }
+
+    if (!(texture_2d_gl_caps & TEXTURE_CAP_NPOT)) {
+        int po2_w = 1, po2_h = 1;
+        while (po2_w < w) {
+            po2_w <<= 1;
+        }
+        while (po2_h < h) {
+            po2_h <<= 1;
+        }
+        w = po2_w;
+        h = po2_h;
+    }
+
+    *out_width = w;
+    *out_height = h;
+    *out_scale = scale;
+}
+
+// Levels texture_2d_load_texture_raw generates for an uncompressed texture.
+// Only ES 3 takes mipmaps of non-power-of-2 textures
+static int get_generated_levels(int width, int height) {
+    if (!generate_mipmaps || width < MIPMAP_MIN_SIZE || height < MIPMAP_MIN_SIZE) {
+        return 1;
+    }
+    if (((width & (width - 1)) || (height & (height - 1))) && !(texture_2d_gl_caps & TEXTURE_CAP_ETC2)) {
+        return 1;
+    }
+    return mipmap_get_level_count(width, height);
+}
+
+/**
+ * @name	texture_2d_estimate_gpu_bytes
+ * @brief	predicts the bytes an image will occupy once loaded, following the
+ *			same half-sizing and padding rules as texture_2d_load_texture_raw
+ * @param	width - (int) width of the image
+ * @param	height - (int) height of the image
+ * @param	num_channels - (int) expected number of channels
+ * @retval	long - expected bytes used
+ */
+long texture_2d_estimate_gpu_bytes(int width, int height, int num_channels) {
+    int w, h, scale;
+    get_texel_size(width, height, &w, &h, &scale);
+    return texture_2d_gpu_bytes(w, h, num_channels, 0, get_generated_levels(w, h));
+}
+
 /**
  * @name	texture_2d_save
- * @brief	saves a texture's byte data from gl to a buffer held by the texture
+ * @brief	saves a texture's byte data from gl to a spill held by the texture,
+ *			which compresses it off the GL thread
  * @param	tex - (texture_2d *) texture to save data from
- * @retval	NONE
+ * @retval	bool - false if out of memory, the texture then has no saved data
  */
-void texture_2d_save(texture_2d *tex) {
-    free(tex->saved_data);
-    tex->saved_data = (char *)malloc(sizeof(char) * tex->width * tex->height * 4);
+bool texture_2d_save(texture_2d *tex) {
+    if (!tex->name) {
+        // spilled already, see texture_2d_spill()
+        return true;
+    }
+
+    canvas_spill_free(tex->spill);
+    tex->spill = NULL;
+    size_t size = (size_t)tex->width * tex->height * 4;
+    unsigned char *pixels = (unsigned char *)buffer_pool_alloc(size);
+    if (!pixels) {
+        return false;
+    }
+
+    // rebind whatever was being drawn to, the read may come mid-frame
+    context_2d *active_ctx = tealeaf_canvas_get()->active_ctx;
     tealeaf_canvas_context_2d_bind(tex->ctx);
-    GLTRACE(glReadPixels(0, 0, tex->width, tex->height, GL_RGBA, GL_UNSIGNED_BYTE, tex->saved_data));
-    context_2d *ctx = context_2d_get_onscreen();
-    tealeaf_canvas_bind_render_buffer(ctx);
+    GLTRACE(glReadPixels(0, 0, tex->width, tex->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+    if (active_ctx && active_ctx != tex->ctx) {
+        tealeaf_canvas_context_2d_bind(active_ctx);
+    } else if (!active_ctx) {
+        context_2d *ctx = context_2d_get_onscreen();
+        tealeaf_canvas_bind_render_buffer(ctx);
+    }
+
+    tex->spill = canvas_spill_queue(pixels, size);
+    if (!tex->spill) {
+        buffer_pool_release(pixels);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @name	texture_2d_spill
+ * @brief	saves a canvas texture's byte data and deletes its GL texture,
+ *			texture_2d_reload() brings it back
+ * @param	tex - (texture_2d *) canvas texture to spill, not the one being drawn to
+ * @retval	bool - false if its data could not be saved, it then stays in GL
+ */
+bool texture_2d_spill(texture_2d *tex) {
+    if (!texture_2d_save(tex)) {
+        return false;
+    }
+    GLTRACE(glDeleteTextures(1, (const GLuint *)&tex->name));
+    tex->name = 0;
+    return true;
 }
 
 /**
@@ -242,9 +552,10 @@ void texture_2d_save(texture_2d *tex) {
  * @retval	NONE
  */
 void texture_2d_reload(texture_2d *tex) {
-    tex->name = get_tex_from_data(tex->width, tex->height, tex->saved_data);
-    free(tex->saved_data);
-    tex->saved_data = NULL;
+    unsigned char *pixels = canvas_spill_restore(tex->spill);
+    tex->spill = NULL;
+    tex->name = get_tex_from_data(tex->width, tex->height, pixels);
+    buffer_pool_release(pixels);
 }
 
 /**
@@ -254,30 +565,68 @@ void texture_2d_reload(texture_2d *tex) {
  * @retval	NONE
  */
 void texture_2d_destroy(texture_2d *tex) {
-    GLTRACE(glDeleteTextures(1, (const GLuint *)&tex->name));
+    if (tex->atlas_page) {
+        texture_atlas_remove(tex);
+    } else {
+        GLTRACE(glDeleteTextures(1, (const GLuint *)&tex->name));
+    }
     free(tex->url);
-    free(tex->pixel_data);
-    free(tex->saved_data);
+    buffer_pool_release(tex->pixel_data);
+    canvas_spill_free(tex->spill);
+    texture_format_free_opacity(&tex->opacity);
+    texture_format_free_opacity(&tex->pending_opacity);
     free(tex);
 }
 
+/**
+ * @name	texture_2d_is_opaque_rect
+ * @brief	checks if a draw from a source rect of the texture covers everything
+ *			under it, using the opaque regions found when it was decoded
+ * @param	tex - (texture_2d *) texture to draw from
+ * @param	src - (const rect_2d *) source rect in the units of tex->width
+ * @retval	bool - true if every pixel drawn has full alpha
+ */
+bool texture_2d_is_opaque_rect(texture_2d *tex, const rect_2d *src) {
+    const float scale = (float)tex->scale;
+    float x = src->x, y = src->y, width = src->width, height = src->height;
+
+    // Mip levels average in texels from around the rect, only an image that
+    // is opaque up to its clamped edges stays opaque in all of them
+    if (tex->mipmapped && (!tex->opacity.opaque || tex->opacity.padded || tex->atlas_page)) {
+        return false;
+    }
+
+    if (width < 0) {
+        x += width;
+        width = -width;
+    }
+    if (height < 0) {
+        y += height;
+        height = -height;
+    }
+    return texture_format_is_opaque_rect(&tex->opacity, x / scale, y / scale, width / scale, height / scale, !tex->atlas_page);
+}
+
 
 
 /*
  * Image post-processor: texture_2d_load_texture_raw()
  *
  * The raw image data needs to be rasterized out to a power-of-two size so that
- * it can be used as a texture in the game.  Furthermore, if half-sizing has
- * been requested then the resulting texture will be half of the original size.
- *
- * IF use_halfsized_textures flagged AND
- *    original width AND height > 64 pixels
- *    THEN perform half-sizing.
+ * it can be used as a texture in the game.  Furthermore, images drawn small
+ * load at a lower level of detail, half or a quarter of the original size.
+ * texture_manager_get_lod_scale() gives the scale for the url, at least 2 if
+ * use_halfsized_textures is flagged, and texture_2d_clamp_scale() keeps more
+ * than 32 texels along each side.
  *
- * The URL is only provided for use in debug output prints.
+ * The URL selects the storage format (see texture_format.h) and is used in
+ * debug output prints.
  * The input image data and size is raw compressed PNG/JPEG file data.
  *
- * out: channels, width, height, originalWidth, originalHeight, scale(1/2)
+ * out: channels, width, height, originalWidth, originalHeight, scale(1/2/4),
+ *      pixel type (zero for 8 bits per channel, else a packed 16-bit GL type),
+ *      levels (mip levels laid out one after another, from the file for
+ *      compressed images or generated when generate_mipmaps is set)
  *
  * Returns rasterized pixel data ready to be used as a texture, or NULL on error.
  */
@@ -286,17 +635,405 @@ void texture_2d_destroy(texture_2d *tex) {
 // Average two color values
 #define COLOR_AVG2(x, y) (((unsigned short)( x ) + (unsigned short)( y ) + 1) >> 1)
 
-// Average four color values
-#define COLOR_AVG4(x, y, z, w) (((unsigned short)( x ) + (unsigned short)( y ) + (unsigned short)( z ) + (unsigned short)( w ) + 2) >> 2)
-
 // Premultiply alpha value
 #define MULT_ALPHA(c, a) (unsigned char)(((unsigned short)( c ) * (unsigned short)( a ) + 128) >> 8)
 
+// Opaque images encoded to ETC1 are kept in the image cache with this header,
+// all little-endian uint32: magic, width, height, originalWidth, originalHeight, scale
+#define ETC1_CACHE_MAGIC "GCE1"
+#define ETC1_CACHE_HEADER_SIZE 24
+#define ETC1_CACHE_VERSION 2
+
+static unsigned int read_u32_le(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void write_u32_le(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+// The texture layout depends on these settings, so their encodings are kept apart
+static unsigned int get_etc1_cache_variant(int lod_scale) {
+    return (ETC1_CACHE_VERSION << 8) | TEXTURE_SCALE_SHIFT(lod_scale) | ((texture_2d_gl_caps & TEXTURE_CAP_NPOT) ? 4 : 0);
+}
+
+static unsigned char *load_cached_etc1(const void *data, unsigned long sz, int lod_scale, texture_2d_load_result *out) {
+    size_t size = 0;
+    unsigned char *cached = (unsigned char *)image_cache_load_encoded(data, sz, get_etc1_cache_variant(lod_scale), &size);
+    if (!cached) {
+        return NULL;
+    }
+
+    if (size >= ETC1_CACHE_HEADER_SIZE && !memcmp(cached, ETC1_CACHE_MAGIC, 4)) {
+        int width = (int)read_u32_le(cached + 4);
+        int height = (int)read_u32_le(cached + 8);
+        int scale = (int)read_u32_le(cached + 20);
+        size_t payload = size - ETC1_CACHE_HEADER_SIZE;
+
+        if ((scale == 1 || scale == 2 || scale == 4) && width > 0 && height > 0 &&
+            payload == etc1_get_encoded_size(width >> TEXTURE_SCALE_SHIFT(scale), height >> TEXTURE_SCALE_SHIFT(scale))) {
+            out->width = width;
+            out->height = height;
+            out->originalWidth = (int)read_u32_le(cached + 12);
+            out->originalHeight = (int)read_u32_le(cached + 16);
+            out->scale = scale;
+            out->size = (long)payload;
+            memmove(cached, cached + ETC1_CACHE_HEADER_SIZE, payload);
+            return cached;
+        }
+    }
+
+    free(cached);
+    return NULL;
+}
+
+// Encodes texel data to ETC1 and caches it, returning NULL if it cannot allocate
+static unsigned char *encode_etc1(const void *data, unsigned long sz, int lod_scale, const unsigned char *pixels, int w, int h, int ch,
+                                  int width, int height, int originalWidth, int originalHeight, int scale, long *out_size) {
+    unsigned long payload = etc1_get_encoded_size(w, h);
+    unsigned char *encoded = (unsigned char *)malloc(ETC1_CACHE_HEADER_SIZE + payload);
+    if (!encoded) {
+        return NULL;
+    }
+
+    memcpy(encoded, ETC1_CACHE_MAGIC, 4);
+    write_u32_le(encoded + 4, (unsigned int)width);
+    write_u32_le(encoded + 8, (unsigned int)height);
+    write_u32_le(encoded + 12, (unsigned int)originalWidth);
+    write_u32_le(encoded + 16, (unsigned int)originalHeight);
+    write_u32_le(encoded + 20, (unsigned int)scale);
+    etc1_encode_image(pixels, w, h, ch, encoded + ETC1_CACHE_HEADER_SIZE);
+
+    image_cache_save_encoded(data, sz, get_etc1_cache_variant(lod_scale), encoded, ETC1_CACHE_HEADER_SIZE + payload);
+
+    memmove(encoded, encoded + ETC1_CACHE_HEADER_SIZE, payload);
+    *out_size = (long)payload;
+    return encoded;
+}
+
+// Averages each 2x2 block of two unpremultiplied rows the way the half-sizing
+// below does, clear texels do not darken the rest.  row1 may be row0 for a
+// final odd row, and an odd last column is averaged with itself
+static void halve_image_row(const unsigned char *row0, const unsigned char *row1, unsigned char *out, int w_old, int ch) {
+    const int w = (w_old + 1) >> 1;
+    int x, c, k;
+
+    for (x = 0; x < w; ++x, out += ch) {
+        const int x0 = 2 * x * ch;
+        const int x1 = 2 * x + 1 < w_old ? x0 + ch : x0;
+        const unsigned char *p[4] = { row0 + x0, row0 + x1, row1 + x0, row1 + x1 };
+        unsigned int sum[4] = { 0, 0, 0, 0 };
+        unsigned int count = 0;
+
+        for (k = 0; k < 4; ++k) {
+            if (ch == 4 && !p[k][3]) {
+                continue;
+            }
+            ++count;
+            for (c = 0; c < ch; ++c) {
+                sum[c] += p[k][c];
+            }
+        }
+        for (c = 0; c < ch; ++c) {
+            out[c] = count ? (unsigned char)((sum[c] + count / 2) / count) : 0;
+        }
+    }
+}
+
+// Averages the final odd column of a row pair into one texel, premultiplied
+// for RGBA.  p1 may be p0 on a final odd row, which copies the texel
+static void halve_last_texel(const unsigned char *p0, const unsigned char *p1, unsigned char *out, int ch) {
+    if (ch == 4) {
+        // Accumulate pixels with color data, ignore the clear ones
+        unsigned short a0 = p0[3], a2 = p1[3];
+        unsigned short a = 0, r = 0, g = 0, b = 0, acnt = 0;
+        if (a0) {
+            a += a0;
+            ++acnt;
+            r += p0[0];
+            g += p0[1];
+            b += p0[2];
+        }
+        if (a2) {
+            a += a2;
+            ++acnt;
+            r += p1[0];
+            g += p1[1];
+            b += p1[2];
+        }
+
+        // Average the resulting colors
+        if (acnt == 2) {
+            a = (a + 1) >> 1;
+            r = (r + 1) >> 1;
+            g = (g + 1) >> 1;
+            b = (b + 1) >> 1;
+        }
+
+        // Premultiply alpha
+        out[0] = MULT_ALPHA(r, a);
+        out[1] = MULT_ALPHA(g, a);
+        out[2] = MULT_ALPHA(b, a);
+        out[3] = (unsigned char)a;
+    } else {
+        int c;
+        for (c = 0; c < ch; ++c) {
+            out[c] = COLOR_AVG2(p0[c], p1[c]);
+        }
+    }
+}
+
+// Bumps up to the next power of 2, stays the same if already po2
+// NOTE: Result of w == 0 is 0
+static int next_po2(int w) {
+    --w;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    return w + 1;
+}
+
+/*
+ * Decoded rows go straight into the final texture: premultiplied, halved once
+ * or twice for the level of detail and padded, so the decoder never holds a
+ * full-size copy of the image.  Halving keeps one even row until its odd
+ * partner arrives, a quarter size also halves each image row pair to a tight
+ * half row first.  JPEGs are instead reduced by the decoder, see
+ * texture_sink_reduce().
+ */
+typedef struct texture_sink_t {
+	image_row_sink sink;
+	int lod_scale;
+	int scale;
+	int reduced; // scale the decoder already applied, zero until it asks
+	int halving; // scale left for the sink, 1, 2 or 4
+	int image_w, image_h, channels;
+	int row_w, row_h; // decoded size
+	int src_w, src_h; // rows the final halving reads, half the decoded rows for a quarter size
+	int width, height; // padded texel size
+	unsigned char *pixels;
+	unsigned char *held; // even source row waiting for the odd one
+	unsigned char *quarter_held; // even image row waiting for the odd one
+	unsigned char *half_row;
+} texture_sink;
+
+// A JPEG decodes straight to the level of detail by scaling its DCT, which
+// costs a fraction of a full size decode and needs no halving afterwards
+static int texture_sink_reduce(image_row_sink *base, int width, int height) {
+    texture_sink *s = (texture_sink *)base;
+
+    s->image_w = width;
+    s->image_h = height;
+    s->reduced = texture_2d_clamp_scale(s->lod_scale, width, height);
+    return s->reduced;
+}
+
+static bool texture_sink_begin(image_row_sink *base, int width, int height, int channels) {
+    texture_sink *s = (texture_sink *)base;
+
+    if ((channels != 1 && channels != 3 && channels != 4) || width <= 0 || height <= 0) {
+        // The full decode logs these
+        return false;
+    }
+
+    if (s->reduced) {
+        s->scale = s->reduced;
+    } else {
+        s->image_w = width;
+        s->image_h = height;
+        s->scale = texture_2d_clamp_scale(s->lod_scale, width, height);
+        s->reduced = 1;
+    }
+    s->halving = s->scale / s->reduced;
+    s->row_w = width;
+    s->row_h = height;
+    s->channels = channels;
+    s->src_w = s->halving == 4 ? (width + 1) >> 1 : width;
+    s->src_h = s->halving == 4 ? (height + 1) >> 1 : height;
+
+    int w = s->halving > 1 ? (s->src_w + 1) >> 1 : width;
+    int h = s->halving > 1 ? (s->src_h + 1) >> 1 : height;
+    const int content_h = h;
+    if (!(texture_2d_gl_caps & TEXTURE_CAP_NPOT)) {
+        w = next_po2(w);
+        h = next_po2(h);
+    }
+    s->width = w;
+    s->height = h;
+
+#ifdef VERBOSE_LOAD_TEX
+    LOG("{resources} Streaming texture originalSize=%dx%d, channelCount=%d, newSize=%dx%d, scale=%d, reduced=%d", s->image_w, s->image_h, channels, w, h, s->scale, s->reduced);
+#endif
+
+    // Pooled, the texels go back to the pool once uploaded, see release_texels()
+    s->pixels = (unsigned char *)buffer_pool_alloc(w * h * channels);
+    if (s->halving > 1) {
+        s->held = (unsigned char *)buffer_pool_alloc(s->src_w * channels);
+    }
+    if (s->halving == 4) {
+        s->quarter_held = (unsigned char *)buffer_pool_alloc(width * channels);
+        s->half_row = (unsigned char *)buffer_pool_alloc(s->src_w * channels);
+    }
+    if (!s->pixels || (s->halving > 1 && !s->held) || (s->halving == 4 && (!s->quarter_held || !s->half_row))) {
+        LOG("{resources} WARNING: Unable to allocate reformatted image w=%d, h=%d", w, h);
+        return false;
+    }
+
+    // Zero out the bottom gap
+    memset(s->pixels + content_h * w * channels, 0, (h - content_h) * w * channels);
+    return true;
+}
+
+// Writes output row y from a pair of source rows
+static void texture_sink_halve(texture_sink *s, const unsigned char *row0, const unsigned char *row1, int y) {
+    const int ch = s->channels;
+    const int half_w = s->src_w >> 1;
+    unsigned char *rowo = s->pixels + y * s->width * ch;
+
+    // Average 2x2 blocks, ignoring the clear pixels of RGBA, and premultiply alpha
+    if (ch == 4) {
+        premultiply_halve_row(row0, row1, rowo, half_w);
+    } else {
+        mipmap_box_filter_row(row0, row1, rowo, half_w, ch);
+    }
+    rowo += half_w * ch;
+
+    // Average final odd column with row below it
+    if (s->src_w & 1) {
+        halve_last_texel(row0 + 2 * half_w * ch, row1 + 2 * half_w * ch, rowo, ch);
+        rowo += ch;
+    }
+
+    // Zero out the right gap
+    memset(rowo, 0, (s->width - ((s->src_w + 1) >> 1)) * ch);
+}
+
+// Takes the source rows of the final halving, averaging a final odd row with itself
+static void texture_sink_half_row(texture_sink *s, const unsigned char *row, int y) {
+    if (y & 1) {
+        texture_sink_halve(s, s->held, row, y >> 1);
+    } else if (y == s->src_h - 1) {
+        texture_sink_halve(s, row, row, y >> 1);
+    } else {
+        memcpy(s->held, row, s->src_w * s->channels);
+    }
+}
+
+static void texture_sink_row(image_row_sink *base, const unsigned char *row, int y) {
+    texture_sink *s = (texture_sink *)base;
+    const int ch = s->channels;
+
+    if (s->halving == 1) {
+        unsigned char *rowo = s->pixels + y * s->width * ch;
+
+        // Copy and pre-multiply alpha
+        if (ch == 4) {
+            premultiply_row(row, rowo, s->row_w);
+        } else {
+            memcpy(rowo, row, s->row_w * ch);
+        }
+
+        // Zero out the right gap
+        memset(rowo + s->row_w * ch, 0, (s->width - s->row_w) * ch);
+    } else if (s->halving == 2) {
+        texture_sink_half_row(s, row, y);
+    } else {
+        // A quarter size is the half size of a tight half size row
+        if (y & 1) {
+            halve_image_row(s->quarter_held, row, s->half_row, s->row_w, ch);
+            texture_sink_half_row(s, s->half_row, y >> 1);
+        } else if (y == s->row_h - 1) {
+            halve_image_row(row, row, s->half_row, s->row_w, ch);
+            texture_sink_half_row(s, s->half_row, y >> 1);
+        } else {
+            memcpy(s->quarter_held, row, s->row_w * ch);
+        }
+    }
+}
+
+static void texture_sink_init(texture_sink *s, int lod_scale) {
+    memset(s, 0, sizeof(*s));
+    s->sink.reduce = texture_sink_reduce;
+    s->sink.begin = texture_sink_begin;
+    s->sink.row = texture_sink_row;
+    s->lod_scale = lod_scale;
+}
+
+// Frees the row buffers, the pixels are the caller's
+static void texture_sink_free_rows(texture_sink *s) {
+    buffer_pool_release(s->held);
+    buffer_pool_release(s->quarter_held);
+    buffer_pool_release(s->half_row);
+}
+
+// Finds the opaque regions, stores opaque images as ETC1 when the format
+// allows, generates the mip chain and converts to the stored format,
+// returning the final pixel data
+static unsigned char *finish_texture(const void *data, unsigned long sz, int lod_scale, texture_format_policy policy, bool try_etc1,
+                                     unsigned char *pixel_data, int w, int h, int ch, int image_w, int image_h, int scale,
+                                     texture_2d_load_result *out) {
+    const int content_w = (image_w + scale - 1) / scale;
+    const int content_h = (image_h + scale - 1) / scale;
+
+    // Alpha is final here, premultiplying and the formats below keep full alpha full
+    texture_format_find_opacity(pixel_data, w, h, content_w, content_h, ch, &out->opacity);
+
+    if (try_etc1 && (ch == 3 || ch == 4) && (policy == TEXTURE_FORMAT_ETC1 || w * h >= TEXTURE_FORMAT_ETC1_MIN_TEXELS) &&
+        out->opacity.opaque) {
+        unsigned char *encoded = encode_etc1(data, sz, lod_scale, pixel_data, w, h, ch, out->width, out->height, image_w, image_h, scale, &out->size);
+        if (encoded) {
+            buffer_pool_release(pixel_data);
+            out->channels = 3;
+            out->compression_type = GL_ETC1_RGB8_OES;
+            return encoded;
+        }
+    }
+
+    // Minified draws sample generated mip levels, see texture_manager_tick()
+    int num_levels = 1;
+    if (get_generated_levels(w, h) > 1) {
+        unsigned char *chain = mipmap_generate_chain(pixel_data, w, h, ch, &num_levels);
+        if (chain) {
+            pixel_data = chain;
+            out->levels = num_levels;
+        }
+    }
+
+    // Store in 16 bits per texel if the image asks for it
+    if (policy != TEXTURE_FORMAT_DEFAULT) {
+        out->pixel_type = texture_format_convert(policy, pixel_data, w, h, content_w, content_h, out->levels, &out->channels);
+    }
+
+    return pixel_data;
+}
+
+// Finishes a texture filled by a texture_sink, taking its pixels
+static unsigned char *finish_sink_texture(texture_sink *sink, const void *data, unsigned long sz, texture_format_policy policy, bool try_etc1,
+                                          texture_2d_load_result *out) {
+    out->channels = sink->channels;
+    out->pixel_type = 0;
+    out->originalWidth = sink->image_w;
+    out->originalHeight = sink->image_h;
+    out->size = (long)sink->image_w * sink->image_h * sink->channels;
+    out->compression_type = 0;
+    out->levels = 1;
+    out->scale = sink->scale;
+    out->width = sink->width << TEXTURE_SCALE_SHIFT(sink->scale);
+    out->height = sink->height << TEXTURE_SCALE_SHIFT(sink->scale);
+    return finish_texture(data, sz, sink->lod_scale, policy, try_etc1, sink->pixels, sink->width, sink->height, sink->channels, sink->image_w, sink->image_h, sink->scale, out);
+}
+
 // Load texture from raw image data, returning null on failure to load
-unsigned char *texture_2d_load_texture_raw(const char *url, const void *data, unsigned long sz, int *out_channels, int *out_width, int *out_height, int *out_originalWidth, int *out_originalHeight, int *out_scale, long *out_size, int *out_compression_type) {
+unsigned char *texture_2d_load_texture_raw(const char *url, const void *data, unsigned long sz, texture_2d_load_result *out) {
 
     // Initially null pixel data
     unsigned char *pixel_data = NULL;
+    memset(out, 0, sizeof(texture_2d_load_result));
 
     //if we don't get data back from this, we need to load from java
     if (!data) {
@@ -304,20 +1041,77 @@ unsigned char *texture_2d_load_texture_raw(const char *url, const void *data, un
         return NULL;
     }
 
-    // Process file data (PNG/JPEG) into rasterized image data in file format
+    // The texture manager budgets for the image from its header while it decodes
+    texture_manager_probe_image(url, data, sz);
+
+    // Images drawn small load at a lower level of detail, see texture_manager.c
+    const int lod_scale = texture_manager_get_lod_scale(url);
+
+    // Opaque images may be stored as ETC1, which is cached so later loads
+    // skip both the decode and the encode
+    texture_format_policy policy = texture_format_get_policy(url);
+    const bool try_etc1 = (policy == TEXTURE_FORMAT_ETC1 || policy == TEXTURE_FORMAT_AUTO) &&
+                          (texture_2d_gl_caps & TEXTURE_CAP_ETC1);
+    if (try_etc1) {
+        pixel_data = load_cached_etc1(data, sz, lod_scale, out);
+        if (pixel_data) {
+            const int shift = TEXTURE_SCALE_SHIFT(out->scale);
+            out->channels = 3;
+            out->compression_type = GL_ETC1_RGB8_OES;
+            out->pixel_type = 0;
+            out->levels = 1;
+            texture_format_set_opacity(&out->opacity, true, out->width >> shift, out->height >> shift,
+                                       (out->originalWidth + out->scale - 1) / out->scale, (out->originalHeight + out->scale - 1) / out->scale);
+            return pixel_data;
+        }
+    }
+
+    // PNG and JPEG rows are processed as they are decoded, straight into the
+    // texture, so there is no full-size copy of the image
+    texture_sink sink;
+    texture_sink_init(&sink, lod_scale);
+    image_rows_result streamed = load_image_rows_from_memory((unsigned char*)data, (long)sz, &sink.sink);
+    texture_sink_free_rows(&sink);
+    if (streamed == IMAGE_ROWS_DONE) {
+        return finish_sink_texture(&sink, data, sz, policy, try_etc1, out);
+    }
+    buffer_pool_release(sink.pixels);
+    if (streamed == IMAGE_ROWS_FAILED) {
+        return NULL;
+    }
+
+    // Otherwise process file data (interlaced PNG, KTX, PKM) into rasterized
+    // image data in file format
     int w_old = 0, h_old = 0, ch = 0;
-    unsigned char *bits = load_image_from_memory((unsigned char*)data, (long)sz, &w_old, &h_old, &ch, out_size, out_compression_type);
+    unsigned char *bits = load_image_from_memory((unsigned char*)data, (long)sz, &w_old, &h_old, &ch, &out->size, &out->compression_type, &out->levels);
     if (bits == NULL) {
         return NULL;
     }
-    *out_channels = ch;
-    *out_originalWidth = w_old;
-    *out_originalHeight = h_old;
-
-    if (*out_compression_type) {
-        *out_width = w_old;
-        *out_height = h_old;
-        *out_scale = 1;
+    out->channels = ch;
+    out->pixel_type = 0;
+    out->originalWidth = w_old;
+    out->originalHeight = h_old;
+
+    if (out->compression_type) {
+        out->width = w_old;
+        out->height = h_old;
+        out->scale = 1;
+
+        // Scale down by skipping base levels when the file has mipmaps
+        const int scale = texture_2d_clamp_scale(lod_scale, w_old, h_old);
+        int level_w = w_old, level_h = h_old;
+        while (out->scale < scale && out->levels > 1) {
+            unsigned long base_size = compressed_texture_get_size(out->compression_type, level_w, level_h);
+            memmove(bits, bits + base_size, out->size - base_size);
+            out->size -= base_size;
+            out->levels -= 1;
+            level_w = level_w > 1 ? level_w >> 1 : 1;
+            level_h = level_h > 1 ? level_h >> 1 : 1;
+            out->scale <<= 1;
+        }
+        out->width = level_w << TEXTURE_SCALE_SHIFT(out->scale);
+        out->height = level_h << TEXTURE_SCALE_SHIFT(out->scale);
+        texture_format_set_opacity(&out->opacity, compressed_texture_is_opaque(out->compression_type), level_w, level_h, level_w, level_h);
         return bits;
     } else {
         switch (ch) {
@@ -342,502 +1136,119 @@ unsigned char *texture_2d_load_texture_raw(const char *url, const void *data, un
         return NULL;
     }
 
-    // Now we post-process the image data into our internal memory format:
-
-    int w = w_old, h = h_old;
-    bool reformatted = false;
+    // Re-use image data already at the right size and scale
+    const bool npot = (texture_2d_gl_caps & TEXTURE_CAP_NPOT) != 0;
+    if (texture_2d_clamp_scale(lod_scale, w_old, h_old) == 1 && (npot || (!(w_old & (w_old-1)) && !(h_old & (h_old-1))))) {
+        if (ch == 4) {
 #ifdef VERBOSE_LOAD_TEX
-    bool debug_is_half = false, debug_is_po2_w = false, debug_is_po2_h = false;
+            LOG("{resources} Processing: Unformatted RGBA");
 #endif
+            // Premultiply alpha
+            premultiply_row(bits, bits, w_old * h_old);
+        }
+        // 1 and 3 -channel images do not need any modification here
 
-    // If texture should be half-sized,
-    int scale = 1;
-    if (use_halfsized_textures && (h > 64 && w > 64)) {
-        reformatted = true;
-        scale = 2;
-
-        // Scale width and height if needed, rounding up (must happen)
-        w = (w + 1) >> 1;
-        h = (h + 1) >> 1;
-
-#ifdef VERBOSE_LOAD_TEX
-        debug_is_half = true;
-#endif
+        out->scale = 1;
+        out->width = w_old;
+        out->height = h_old;
+        return finish_texture(data, sz, lod_scale, policy, try_etc1, bits, w_old, h_old, ch, w_old, h_old, 1, out);
     }
-    *out_scale = scale;
-
-    // Width: If at least 2 bits are set (is not power-of-2),
-    // NOTE: This is unlikely so the if-statement is worthwhile
-    if ((w & (w-1))) {
-        // Bump it up to the next power of 2 (stays the same if already po2)
-        // NOTE: Result of w == 0 is 0
-        --w;
-        w |= w >> 1;
-        w |= w >> 2;
-        w |= w >> 4;
-        w |= w >> 8;
-        w |= w >> 16;
-        ++w;
-        reformatted = true;
 
-#ifdef VERBOSE_LOAD_TEX
-        debug_is_po2_w = true;
-#endif
+    // Otherwise feed the rows through the same stages as a streamed decode
+    texture_sink_init(&sink, lod_scale);
+    bool reformatted = sink.sink.begin(&sink.sink, w_old, h_old, ch);
+    if (reformatted) {
+        int y;
+        for (y = 0; y < h_old; ++y) {
+            sink.sink.row(&sink.sink, bits + y * w_old * ch, y);
+        }
     }
+    texture_sink_free_rows(&sink);
+    free(bits);
 
-    // Height: If at least 2 bits are set (is not power-of-2),
-    if ((h & (h-1))) {
-        // Bump it up to the next power of 2 (stays the same if already po2)
-        --h;
-        h |= h >> 1;
-        h |= h >> 2;
-        h |= h >> 4;
-        h |= h >> 8;
-        h |= h >> 16;
-        ++h;
-        reformatted = true;
-
-#ifdef VERBOSE_LOAD_TEX
-        debug_is_po2_h = true;
-#endif
+    if (!reformatted) {
+        buffer_pool_release(sink.pixels);
+        return NULL;
     }
 
-#ifdef VERBOSE_LOAD_TEX
-    LOG("{resources} Loading texture url=%s, originalSize=%dx%d, channelCount=%d, newSize=%dx%d, half=%d,po2w=%d,po2h=%d", url, w_old, h_old, ch, w, h, (int)debug_is_half, (int)debug_is_po2_w, (int)debug_is_po2_h);
-#endif
-
-    // Store resulting new width and height and scale
-    *out_width = w << (scale - 1);
-    *out_height = h << (scale - 1);
-
-    // If the image was reformatted,
-    if (reformatted) {
-#ifdef __ANDROID__
-        unsigned char *output = memalign(8, w * h * ch);
-        if (!output) {
-#else
-        unsigned char *output;
-        if (0 != posix_memalign((void**)&output, 8, w * h * ch)) {
-#endif
-            LOG("{resources} WARNING: Unable to allocate reformatted image w=%d, h=%d", w, h);
-            free(bits);
-            return NULL;
-        }
-        const unsigned char *rowi = bits;
-        unsigned char *rowo = output;
-        int x, y;
-
-        // If scaling,
-        if (scale == 2) {
-            // If RGBA,
-            if (ch == 4) {
-                const int OLD_STRIDE = w_old << 2;
-                const int RIGHT_GAP = (w - ((w_old+1)>>1)) << 2;
-                const int ROUND_W_OLD = w_old & ~1;
-                const int ROUND_H_OLD = h_old & ~1;
-#ifdef VERBOSE_LOAD_TEX
-                LOG("{resources} Processing: Scaling RGBA oddWidth=%d, oddHeight=%d, oldStride=%d, rightGap=%d, roundWOld=%d, roundHOld=%d", (int)(w_old&1), (int)(h_old&1), OLD_STRIDE, RIGHT_GAP, ROUND_W_OLD, ROUND_H_OLD);
-#endif
+    return finish_sink_texture(&sink, data, sz, policy, try_etc1, out);
+}
 
-                for (y = 0; y < ROUND_H_OLD; y += 2, rowi += OLD_STRIDE) {
-                    // Average 2x2 blocks
-                    for (x = 0; x < ROUND_W_OLD; x += 2) {
-                        // Accumulate pixels with color data, ignore the clear ones
-                        unsigned short a0 = rowi[3], a1 = rowi[7], a2 = rowi[OLD_STRIDE+3], a3 = rowi[OLD_STRIDE+7];
-                        unsigned short a = 0, r = 0, g = 0, b = 0, acnt = 0;
-                        if (a0) {
-                            a += a0;
-                            ++acnt;
-                            r += rowi[0];
-                            g += rowi[1];
-                            b += rowi[2];
-                        }
-                        if (a1) {
-                            a += a1;
-                            ++acnt;
-                            r += rowi[4];
-                            g += rowi[5];
-                            b += rowi[6];
-                        }
-                        if (a2) {
-                            a += a2;
-                            ++acnt;
-                            r += rowi[OLD_STRIDE];
-                            g += rowi[OLD_STRIDE+1];
-                            b += rowi[OLD_STRIDE+2];
-                        }
-                        if (a3) {
-                            a += a3;
-                            ++acnt;
-                            r += rowi[OLD_STRIDE+4];
-                            g += rowi[OLD_STRIDE+5];
-                            b += rowi[OLD_STRIDE+6];
-                        }
-
-                        // Average the resulting colors
-                        switch (acnt) {
-                        case 2:
-                            a = (a + 1) >> 1;
-                            r = (r + 1) >> 1;
-                            g = (g + 1) >> 1;
-                            b = (b + 1) >> 1;
-                            break;
-                        case 3:
-                            a = (a + 1) / 3;
-                            r = (r + 1) / 3;
-                            g = (g + 1) / 3;
-                            b = (b + 1) / 3;
-                            break;
-                        case 4:
-                            a = (a + 2) >> 2;
-                            r = (r + 2) >> 2;
-                            g = (g + 2) >> 2;
-                            b = (b + 2) >> 2;
-                            break;
-                        default:
-                        case 0:
-                        case 1:
-                            break;
-                        }
-
-                        // Premultiply alpha
-                        rowo[0] = MULT_ALPHA(r, a);
-                        rowo[1] = MULT_ALPHA(g, a);
-                        rowo[2] = MULT_ALPHA(b, a);
-                        rowo[3] = (unsigned char)a;
-
-                        rowi += 8;
-                        rowo += 4;
-                    }
-
-                    // Average final odd column with row below it
-                    if (w_old & 1) {
-                        // Accumulate pixels with color data, ignore the clear ones
-                        unsigned short a0 = rowi[3], a2 = rowi[OLD_STRIDE+3];
-                        unsigned short a = 0, r = 0, g = 0, b = 0, acnt = 0;
-                        if (a0) {
-                            a += a0;
-                            ++acnt;
-                            r += rowi[0];
-                            g += rowi[1];
-                            b += rowi[2];
-                        }
-                        if (a2) {
-                            a += a2;
-                            ++acnt;
-                            r += rowi[OLD_STRIDE];
-                            g += rowi[OLD_STRIDE+1];
-                            b += rowi[OLD_STRIDE+2];
-                        }
-
-                        // Average the resulting colors
-                        if (acnt == 2) {
-                            a = (a + 1) >> 1;
-                            r = (r + 1) >> 1;
-                            g = (g + 1) >> 1;
-                            b = (b + 1) >> 1;
-                        }
-
-                        // Premultiply alpha
-                        rowo[0] = MULT_ALPHA(r, a);
-                        rowo[1] = MULT_ALPHA(g, a);
-                        rowo[2] = MULT_ALPHA(b, a);
-                        rowo[3] = (unsigned char)a;
-
-                        rowi += 4;
-                        rowo += 4;
-                    }
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Average final odd row with itself
-                if (h_old & 1) {
-                    // Average 1x2 blocks
-                    for (x = 0; x < ROUND_W_OLD; x += 2) {
-                        // Accumulate pixels with color data, ignore the clear ones
-                        unsigned short a0 = rowi[3], a1 = rowi[7];
-                        unsigned short a = 0, r = 0, g = 0, b = 0, acnt = 0;
-                        if (a0) {
-                            a += a0;
-                            ++acnt;
-                            r += rowi[0];
-                            g += rowi[1];
-                            b += rowi[2];
-                        }
-                        if (a1) {
-                            a += a1;
-                            ++acnt;
-                            r += rowi[4];
-                            g += rowi[5];
-                            b += rowi[6];
-                        }
-
-                        // Average the resulting colors
-                        if (acnt == 2) {
-                            a = (a + 1) >> 1;
-                            r = (r + 1) >> 1;
-                            g = (g + 1) >> 1;
-                            b = (b + 1) >> 1;
-                        }
-
-                        // Premultiply alpha
-                        rowo[0] = MULT_ALPHA(r, a);
-                        rowo[1] = MULT_ALPHA(g, a);
-                        rowo[2] = MULT_ALPHA(b, a);
-                        rowo[3] = (unsigned char)a;
-
-                        rowi += 8;
-                        rowo += 4;
-                    }
-
-                    // Direct copy final pixel
-                    if (w_old & 1) {
-                        // Premultiply alpha
-                        unsigned short a = rowi[3];
-                        rowo[0] = MULT_ALPHA(rowi[0], a);
-                        rowo[1] = MULT_ALPHA(rowi[1], a);
-                        rowo[2] = MULT_ALPHA(rowi[2], a);
-                        rowo[3] = (unsigned char)a;
-
-                        //rowi += 4;
-                        rowo += 4;
-                    }
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Zero out the bottom gap
-                const int BOTTOM_GAP = (h - ((h_old+1)>>1)) * (w << 2);
-                memset(rowo, 0, BOTTOM_GAP);
-            } else if (ch == 3) { // RGB
-                const int OLD_STRIDE = w_old * 3;
-                const int RIGHT_GAP = (w - ((w_old+1)>>1)) * 3;
-                const int ROUND_W_OLD = w_old & ~1;
-                const int ROUND_H_OLD = h_old & ~1;
-#ifdef VERBOSE_LOAD_TEX
-                LOG("{resources} Processing: Scaling RGB oddWidth=%d, oddHeight=%d, oldStride=%d, rightGap=%d, roundWOld=%d, roundHOld=%d", (int)(w_old&1), (int)(h_old&1), OLD_STRIDE, RIGHT_GAP, ROUND_W_OLD, ROUND_H_OLD);
-#endif
 
-                for (y = 0; y < ROUND_H_OLD; y += 2, rowi += OLD_STRIDE) {
-                    // Average 2x2 blocks
-                    for (x = 0; x < ROUND_W_OLD; x += 2) {
-                        rowo[0] = COLOR_AVG4(rowi[0], rowi[3], rowi[OLD_STRIDE], rowi[OLD_STRIDE+3]);
-                        rowo[1] = COLOR_AVG4(rowi[1], rowi[4], rowi[OLD_STRIDE+1], rowi[OLD_STRIDE+4]);
-                        rowo[2] = COLOR_AVG4(rowi[2], rowi[5], rowi[OLD_STRIDE+2], rowi[OLD_STRIDE+5]);
-
-                        rowi += 6;
-                        rowo += 3;
-                    }
-
-                    // Average final odd column with row below it
-                    if (w_old & 1) {
-                        rowo[0] = COLOR_AVG2(rowi[0], rowi[OLD_STRIDE]);
-                        rowo[1] = COLOR_AVG2(rowi[1], rowi[OLD_STRIDE+1]);
-                        rowo[2] = COLOR_AVG2(rowi[2], rowi[OLD_STRIDE+2]);
-
-                        rowi += 3;
-                        rowo += 3;
-                    }
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Average final odd row with itself
-                if (h_old & 1) {
-                    // Average 1x2 blocks
-                    for (x = 0; x < ROUND_W_OLD; x += 2) {
-                        rowo[0] = COLOR_AVG2(rowi[0], rowi[3]);
-                        rowo[1] = COLOR_AVG2(rowi[1], rowi[4]);
-                        rowo[2] = COLOR_AVG2(rowi[2], rowi[5]);
-
-                        rowi += 6;
-                        rowo += 3;
-                    }
-
-                    // Direct copy final pixel
-                    if (w_old & 1) {
-                        rowo[0] = rowi[0];
-                        rowo[1] = rowi[1];
-                        rowo[2] = rowi[2];
-
-                        //rowi += 3;
-                        rowo += 3;
-                    }
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Zero out the bottom gap
-                const int BOTTOM_GAP = (h - ((h_old+1)>>1)) * w * 3;
-                memset(rowo, 0, BOTTOM_GAP);
-            } else { // ch == 1
-                // Monochrome: 1 byte/pixel color
-                // Natively compatible with GL_LUMINANCE
-                const int OLD_STRIDE = w_old;
-                const int RIGHT_GAP = (w - ((w_old+1)>>1));
-                const int ROUND_W_OLD = w_old & ~1;
-                const int ROUND_H_OLD = h_old & ~1;
-#ifdef VERBOSE_LOAD_TEX
-                LOG("{resources} Processing: Scaling Monochrome oddWidth=%d, oddHeight=%d, oldStride=%d, rightGap=%d, roundWOld=%d, roundHOld=%d", (int)(w_old&1), (int)(h_old&1), OLD_STRIDE, RIGHT_GAP, ROUND_W_OLD, ROUND_H_OLD);
-#endif
+// Images of at least this many texels get a proxy, smaller ones load fast enough
+#define PROXY_MIN_TEXELS (512 * 512)
 
-                for (y = 0; y < ROUND_H_OLD; y += 2, rowi += OLD_STRIDE) {
-                    // Average 2x2 blocks
-                    for (x = 0; x < ROUND_W_OLD; x += 2) {
-                        rowo[0] = COLOR_AVG4(rowi[0], rowi[1], rowi[OLD_STRIDE], rowi[OLD_STRIDE+1]);
-
-                        rowi += 2;
-                        rowo += 1;
-                    }
-
-                    // Average final odd column with row below it
-                    if (w_old & 1) {
-                        rowo[0] = COLOR_AVG2(rowi[0], rowi[OLD_STRIDE]);
-
-                        rowi += 1;
-                        rowo += 1;
-                    }
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Average final odd row with itself
-                if (h_old & 1) {
-                    // Average 1x2 blocks
-                    for (x = 0; x < ROUND_W_OLD; x += 2) {
-                        rowo[0] = COLOR_AVG2(rowi[0], rowi[1]);
-
-                        rowi += 2;
-                        rowo += 1;
-                    }
-
-                    // Direct copy final pixel
-                    if (w_old & 1) {
-                        rowo[0] = rowi[0];
-
-                        //rowi += 1;
-                        rowo += 1;
-                    }
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Zero out the bottom gap
-                const int BOTTOM_GAP = (h - ((h_old+1)>>1)) * w;
-                memset(rowo, 0, BOTTOM_GAP);
-            }
-        } else { // Unscaled: Made a power of 2
-            // If RGBA,
-            if (ch == 4) {
-#ifdef VERBOSE_LOAD_TEX
-                LOG("{resources} Processing: Unscaled RGBA");
-#endif
-                const int RIGHT_GAP = (w - w_old) << 2;
-
-                for (y = 0; y < h_old; ++y) {
-                    for (x = 0; x < w_old; ++x) {
-                        // Copy and pre-multiply alpha
-                        unsigned short a = rowi[3];
-                        rowo[0] = MULT_ALPHA(rowi[0], a);
-                        rowo[1] = MULT_ALPHA(rowi[1], a);
-                        rowo[2] = MULT_ALPHA(rowi[2], a);
-                        rowo[3] = a;
-
-                        rowi += 4;
-                        rowo += 4;
-                    }
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Zero out the bottom gap
-                memset(rowo, 0, (h - h_old) * (w << 2));
-            } else if (ch == 3) { // RGB
-#ifdef VERBOSE_LOAD_TEX
-                LOG("{resources} Processing: Unscaled RGB");
-#endif
-                const int W_OLD_BYTES = w_old * 3;
-                const int W_BYTES = w * 3;
-                const int RIGHT_GAP = W_BYTES - W_OLD_BYTES;
-
-                for (y = 0; y < h_old; ++y, rowi += W_OLD_BYTES) {
-                    // Copy full row without changes
-                    memcpy(rowo, rowi, W_OLD_BYTES);
-                    rowo += W_OLD_BYTES;
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Zero out the bottom gap
-                memset(rowo, 0, (h - h_old) * W_BYTES);
-            } else { // ch == 1
-#ifdef VERBOSE_LOAD_TEX
-                LOG("{resources} Processing: Unscaled Monochrome");
-#endif
-                const int W_OLD_BYTES = w_old;
-                const int W_BYTES = w;
-                const int RIGHT_GAP = W_BYTES - W_OLD_BYTES;
-
-                for (y = 0; y < h_old; ++y, rowi += W_OLD_BYTES) {
-                    // Copy full row without changes
-                    memcpy(rowo, rowi, W_OLD_BYTES);
-                    rowo += W_OLD_BYTES;
-
-                    // Zero out the right gap
-                    memset(rowo, 0, RIGHT_GAP);
-                    rowo += RIGHT_GAP;
-                }
-
-                // Zero out the bottom gap
-                memset(rowo, 0, (h - h_old) * W_BYTES);
-            }
-        }
+/**
+ * @name	texture_2d_load_texture_proxy
+ * @brief	decodes a reduced copy of a large JPEG or interlaced PNG, laid out to
+ *			draw in place of the texture texture_2d_load_texture_raw will produce
+ *			from the same data
+ * @param	data - (const void *) raw PNG/JPEG file data
+ * @param	sz - (unsigned long) size of the file data
+ * @param	out_channels - (int *) channels of the proxy
+ * @param	out_width - (int *) width of the full texture, in source pixels
+ * @param	out_height - (int *) height of the full texture, in source pixels
+ * @param	out_originalWidth - (int *) width of the image
+ * @param	out_originalHeight - (int *) height of the image
+ * @param	out_scale - (int *) scale of the full texture
+ * @param	out_proxy_shift - (int *) the proxy has the full texture's texels divided by 1 << shift, rounding up
+ * @retval	unsigned char* - premultiplied proxy texels, or NULL if the image gets no proxy
+ */
+unsigned char *texture_2d_load_texture_proxy(const void *data, unsigned long sz, int *out_channels, int *out_width, int *out_height, int *out_originalWidth, int *out_originalHeight, int *out_scale, int *out_proxy_shift) {
+    if (!data) {
+        return NULL;
+    }
 
+    int w_old, h_old, ch, factor;
+    unsigned char *bits = load_image_proxy_from_memory((unsigned char *)data, (long)sz, PROXY_MIN_TEXELS, &w_old, &h_old, &ch, &factor);
+    if (!bits) {
+        return NULL;
+    }
+    if (ch != 1 && ch != 3 && ch != 4) {
         free(bits);
+        return NULL;
+    }
 
-        pixel_data = output;
-    } else {
-        // Re-use image data already at the right size and scale:
+    int w, h, scale;
+    get_texel_size(w_old, h_old, &w, &h, &scale);
 
-        if (ch == 4) {
-#ifdef VERBOSE_LOAD_TEX
-            LOG("{resources} Processing: Unformatted RGBA");
-#endif
-            unsigned char *row = bits;
-            unsigned int bytes = w * h;
+    // The proxy keeps every factor-th image pixel and the texture every scale-th
+    int shift = 1;
+    while ((scale << shift) < factor) {
+        ++shift;
+    }
 
-            while (bytes--) {
-                // Premultiply alpha
-                unsigned short a = row[3];
-                row[0] = MULT_ALPHA(row[0], a);
-                row[1] = MULT_ALPHA(row[1], a);
-                row[2] = MULT_ALPHA(row[2], a);
+    const int proxy_w = (w + (1 << shift) - 1) >> shift;
+    const int proxy_h = (h + (1 << shift) - 1) >> shift;
+    const int bits_w = (w_old + factor - 1) / factor;
+    const int bits_h = (h_old + factor - 1) / factor;
+    const int copy_w = bits_w < proxy_w ? bits_w : proxy_w;
+    const int copy_h = bits_h < proxy_h ? bits_h : proxy_h;
 
-                row += 4;
-            }
-        }
-        // 1 and 3 -channel images do not need any modification here
+    // Padding is clear like the padding of the full texture
+    unsigned char *pixel_data = (unsigned char *)calloc(proxy_w * proxy_h, ch);
+    if (!pixel_data) {
+        free(bits);
+        return NULL;
+    }
 
-        pixel_data = bits;
+    int y;
+    for (y = 0; y < copy_h; ++y) {
+        memcpy(pixel_data + y * proxy_w * ch, bits + y * bits_w * ch, copy_w * ch);
     }
+    free(bits);
 
+    if (ch == 4) {
+        // Premultiply alpha
+        premultiply_row(pixel_data, pixel_data, proxy_w * proxy_h);
+    }
+
+    *out_channels = ch;
+    *out_width = w << TEXTURE_SCALE_SHIFT(scale);
+    *out_height = h << TEXTURE_SCALE_SHIFT(scale);
+    *out_originalWidth = w_old;
+    *out_originalHeight = h_old;
+    *out_scale = scale;
+    *out_proxy_shift = shift;
     return pixel_data;
 }
-
@@ -18,10 +18,15 @@
 
 #include "core/types.h"
 #include "core/deps/uthash/uthash.h"
+#include "core/texture_format.h"
+#include "core/geometry.h"
 
 #include <time.h> // for last_accessed
 
 struct context_2d_t;
+struct texture_atlas_page_t;
+struct shared_texture_t;
+struct canvas_spill_t;
 
 typedef struct texture_2d_t {
 	int name;
@@ -38,7 +43,7 @@ typedef struct texture_2d_t {
 	bool is_canvas;
 	struct context_2d_t *ctx;
 	time_t last_accessed;
-	char *saved_data;
+	struct canvas_spill_t *spill; // Canvas pixels kept while it has no GL texture, see canvas_spill.h
 	bool loaded;
 	unsigned char *pixel_data;
 	int num_channels;
@@ -47,16 +52,74 @@ typedef struct texture_2d_t {
 	long used_texture_bytes; // Bytes actually used, zero until loaded
 	int frame_epoch; // Frame ID to avoid double-counting usage
 	int compression_type;
+	int pixel_type; // Packed GL type of pixel_data, zero for 8 bits per channel
+	int num_levels; // Mip levels in pixel_data and on the GPU, including the base level
+	int proxy_shift; // Nonzero while a reduced proxy stands in, its texels are the texture's divided by 1 << proxy_shift
+	int uploaded_levels; // Levels of pixel_data on the GPU, generated levels follow one per tick
+	int minified_epoch; // Frame it was last drawn below half scale
+	bool mipmapped; // Minified through its mip levels, see texture_manager_tick()
+	float draw_scale2; // Largest squared screen pixels per image pixel drawn lately, see texture_manager_mark_drawn()
+	int lod_low_windows; // Level of detail windows in a row it could have been drawn from fewer texels
+	texture_opacity opacity; // Opaque regions found at decode, classifies nothing while a proxy stands in
+	texture_opacity pending_opacity; // Opacity of pixel_data, replaces opacity when it is uploaded
+
+	// Location in a shared atlas page, see texture_atlas.c
+	struct texture_atlas_page_t *atlas_page; // NULL when the texture owns its GL name
+	int atlas_x; // Texel offset in the page
+	int atlas_y;
+	int atlas_index; // Slot in the page item list
+
+	int handle; // Interned url handle, zero if the url was never interned
+
+	// Textures loaded from identical file data draw from one GL texture, see texture_manager.c
+	unsigned int content_hash[4]; // Murmur3 of the file data, valid if content_hashed
+	bool content_hashed;
+	struct shared_texture_t *shared; // NULL unless registered for sharing
+
+	// Residency statistics, see texture_manager_dump_residency()
+	double load_requested_at; // Milliseconds, zero if not loaded by the texture manager
+	int load_latency_ms;
+	unsigned int hits;   // Draw lookups that found the texture ready
+	unsigned int misses; // Draw lookups that found the texture still loading
 
 	struct texture_2d_t *next;
 	struct texture_2d_t *prev;
 } texture_2d;
 
+// What texture_2d_load_texture_raw() decoded, named as in texture_2d
+typedef struct texture_2d_load_result_t {
+	int channels;
+	int width; // Image pixels the texture covers, padding included
+	int height;
+	int originalWidth;
+	int originalHeight;
+	int scale;
+	long size; // Bytes of texture memory to budget for
+	int compression_type;
+	int pixel_type; // Packed GL type of the texels, zero for 8 bits per channel
+	int levels; // Mip levels in the texels, including the base level
+	texture_opacity opacity; // Its cells are the caller's to free
+} texture_2d_load_result;
+
+
+// Texels hold scale x scale image pixels, scale is 1, 2 or 4
+#define TEXTURE_SCALE_SHIFT(scale) ((scale) >> 1)
+#define TEXTURE_MAX_SCALE 4
+
+// Texture features of the GL context
+#define TEXTURE_CAP_NPOT 0x1 /* non-power-of-2 sizes with clamp-to-edge and no mipmaps */
+#define TEXTURE_CAP_ETC1 0x2 /* GL_OES_compressed_ETC1_RGB8_texture */
+#define TEXTURE_CAP_ETC2 0x4 /* ETC2 and EAC, core in ES 3.0 */
+#define TEXTURE_CAP_S3TC 0x8 /* GL_EXT_texture_compression_s3tc */
+#define TEXTURE_CAP_ASTC 0x10 /* GL_KHR_texture_compression_astc_ldr */
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+extern int texture_2d_gl_caps;
+void texture_2d_detect_gl_caps();
+
 texture_2d *texture_2d_new_from_url(char *url);
 texture_2d *texture_2d_new_from_dimensions(int width, int height);
 texture_2d *texture_2d_new_from_data(int width, int height, const void *data);
@@ -65,11 +128,23 @@ void texture_2d_destroy(texture_2d *tex);
 bool texture_2d_can_resize(texture_2d *tex, int width, int height);
 void texture_2d_resize_unsafe(texture_2d *tex, int width, int height);
 
-void texture_2d_save(texture_2d *tex);
+long texture_2d_gpu_bytes(int width, int height, int num_channels, int compression_type, int num_levels);
+long texture_2d_get_gpu_bytes(texture_2d *tex);
+long texture_2d_estimate_gpu_bytes(int width, int height, int num_channels);
+int texture_2d_clamp_scale(int scale, int width, int height);
+
+bool texture_2d_save(texture_2d *tex);
+bool texture_2d_spill(texture_2d *tex);
 void texture_2d_reload(texture_2d *tex);
 
-// Load texture from raw image data, returning null on failure to load
-unsigned char *texture_2d_load_texture_raw(const char *url, const void *data, unsigned long sz, int *out_channels, int *out_width, int *out_height, int *out_originalWidth, int *out_originalHeight, int *out_scale, long *out_size, int *out_compression_type);
+// Load texture from raw image data, returning null on failure to load.  The texels
+// come from the buffer pool and go back with buffer_pool_release(), not free()
+unsigned char *texture_2d_load_texture_raw(const char *url, const void *data, unsigned long sz, texture_2d_load_result *out);
+bool texture_2d_is_opaque_rect(texture_2d *tex, const rect_2d *src);
+
+// Load a reduced copy of a large image to draw until the full image is loaded, returning null if it gets none
+// The copy is released with buffer_pool_release() like the full texels
+unsigned char *texture_2d_load_texture_proxy(const void *data, unsigned long sz, int *out_channels, int *out_width, int *out_height, int *out_originalWidth, int *out_originalHeight, int *out_scale, int *out_proxy_shift);
 
 #ifdef __cplusplus
 }
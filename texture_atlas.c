@@ -0,0 +1,636 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 texture_atlas.c
+ * @brief	packs small images into shared texture pages
+ *
+ * Small standalone images each cost a GL texture, power-of-two padding and a
+ * batch break in draw_textures.  Instead, their pixels are copied into shared
+ * pages using a skyline packer and the texture_2d records where it lives.
+ *
+ * Pages are never repacked in place.  Evicted textures leave holes behind, so
+ * once a page is mostly holes it is marked as draining and its survivors are
+ * moved a few at a time into other pages on the GPU.  A page is deleted as
+ * soon as its last item leaves.
+ *
+ * All functions must be called from the GL thread.
+ */
+#include "core/texture_atlas.h"
+#include "core/draw_textures.h"
+#include "core/core.h"
+#include "core/log.h"
+#include "platform/gl.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Transparent gutter (in texels) kept right and below each item to avoid bleeding
+#define ATLAS_PADDING 1
+
+// Number of items moved out of draining pages each tick
+#define ATLAS_DEFRAG_MOVES_PER_TICK 4
+
+// Page is drained when less than this fraction of its allocated area is live
+#define ATLAS_DEFRAG_LIVE_RATIO 0.5
+
+#define ATLAS_PAGE_AREA ((long)ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE)
+
+#if defined(TEXMAN_VERBOSE)
+#define ATLASLOG(fmt, ...) LOG("{atlas} " fmt, ##__VA_ARGS__)
+#else
+#define ATLASLOG(fmt, ...)
+#endif
+
+typedef struct skyline_node_t {
+    short x;
+    short y;
+    short width;
+} skyline_node;
+
+typedef struct texture_atlas_page_t {
+    GLuint name;
+
+    // Skyline packer state, each node is at least one texel wide
+    int node_count;
+    skyline_node nodes[ATLAS_PAGE_SIZE];
+
+    long allocated_area; // Area handed out by the packer, never decreases
+    long live_area;      // Area of items still resident in the page
+
+    texture_2d **items;
+    int item_count;
+    int item_max;
+
+    bool draining; // Being emptied by defragmentation, no new allocations
+
+    struct texture_atlas_page_t *next;
+} texture_atlas_page;
+
+static texture_atlas_page *m_pages = NULL;
+static GLuint m_copy_framebuffer = 0;
+
+/**
+ * @name	get_item_size
+ * @brief	gets the packed size of a texture in texels, without padding
+ * @param	tex - (texture_2d *) texture to measure
+ * @param	width - (int *) out: width in texels
+ * @param	height - (int *) out: height in texels
+ * @retval	NONE
+ */
+static void get_item_size(texture_2d *tex, int *width, int *height) {
+    int scale = tex->scale > 0 ? tex->scale : 1;
+    *width = (tex->originalWidth + scale - 1) / scale;
+    *height = (tex->originalHeight + scale - 1) / scale;
+}
+
+/**
+ * @name	can_hold
+ * @brief	checks if a texture is a candidate for packing into a page
+ * @param	tex - (texture_2d *) texture about to be uploaded
+ * @retval	bool - true if the texture may be packed
+ */
+static bool can_hold(texture_2d *tex) {
+    if (tex->is_text || tex->is_canvas || tex->compression_type || tex->pixel_type || tex->num_levels > 1 || tex->num_channels != 4 || !tex->pixel_data) {
+        return false;
+    }
+
+    int width, height;
+    get_item_size(tex, &width, &height);
+
+    return width > 0 && height > 0 && width <= ATLAS_MAX_ITEM_SIZE && height <= ATLAS_MAX_ITEM_SIZE;
+}
+
+/**
+ * @name	skyline_fit
+ * @brief	finds the lowest y at which a rect fits starting at the given node
+ * @param	page - (texture_atlas_page *) page to search
+ * @param	index - (int) skyline node the rect would start on
+ * @param	width - (int) padded width of the rect
+ * @param	height - (int) padded height of the rect
+ * @retval	int - y coordinate, or -1 if the rect does not fit
+ */
+static int skyline_fit(texture_atlas_page *page, int index, int width, int height) {
+    int x = page->nodes[index].x;
+    int y = page->nodes[index].y;
+    int width_left = width;
+
+    if (x + width > ATLAS_PAGE_SIZE) {
+        return -1;
+    }
+
+    while (width_left > 0) {
+        if (index >= page->node_count) {
+            return -1;
+        }
+        if (page->nodes[index].y > y) {
+            y = page->nodes[index].y;
+        }
+        if (y + height > ATLAS_PAGE_SIZE) {
+            return -1;
+        }
+        width_left -= page->nodes[index].width;
+        ++index;
+    }
+
+    return y;
+}
+
+/**
+ * @name	skyline_alloc
+ * @brief	allocates a rect in a page using the bottom-left skyline heuristic
+ * @param	page - (texture_atlas_page *) page to allocate from
+ * @param	width - (int) padded width of the rect
+ * @param	height - (int) padded height of the rect
+ * @param	out_x - (int *) out: x coordinate of the rect
+ * @param	out_y - (int *) out: y coordinate of the rect
+ * @retval	bool - true if the rect was allocated
+ */
+static bool skyline_alloc(texture_atlas_page *page, int width, int height, int *out_x, int *out_y) {
+    int best_index = -1, best_y = ATLAS_PAGE_SIZE, best_width = ATLAS_PAGE_SIZE + 1;
+    int i;
+
+    for (i = 0; i < page->node_count; ++i) {
+        int y = skyline_fit(page, i, width, height);
+        if (y >= 0 && (y < best_y || (y == best_y && page->nodes[i].width < best_width))) {
+            best_index = i;
+            best_y = y;
+            best_width = page->nodes[i].width;
+        }
+    }
+
+    // The insertion below may need a spare node
+    if (best_index < 0 || page->node_count >= ATLAS_PAGE_SIZE) {
+        return false;
+    }
+
+    *out_x = page->nodes[best_index].x;
+    *out_y = best_y;
+
+    // Insert the new top edge
+    memmove(&page->nodes[best_index + 1], &page->nodes[best_index], (page->node_count - best_index) * sizeof(skyline_node));
+    page->nodes[best_index].x = *out_x;
+    page->nodes[best_index].y = best_y + height;
+    page->nodes[best_index].width = width;
+    page->node_count++;
+
+    // Shrink or remove the nodes now covered by it
+    for (i = best_index + 1; i < page->node_count; ++i) {
+        skyline_node *prev = &page->nodes[i - 1];
+        skyline_node *node = &page->nodes[i];
+        int shrink = prev->x + prev->width - node->x;
+
+        if (shrink <= 0) {
+            break;
+        }
+
+        node->x += shrink;
+        node->width -= shrink;
+        if (node->width > 0) {
+            break;
+        }
+
+        memmove(node, node + 1, (page->node_count - i - 1) * sizeof(skyline_node));
+        page->node_count--;
+        --i;
+    }
+
+    // Merge neighbours at the same level
+    for (i = 0; i < page->node_count - 1; ++i) {
+        if (page->nodes[i].y == page->nodes[i + 1].y) {
+            page->nodes[i].width += page->nodes[i + 1].width;
+            memmove(&page->nodes[i + 1], &page->nodes[i + 2], (page->node_count - i - 2) * sizeof(skyline_node));
+            page->node_count--;
+            --i;
+        }
+    }
+
+    page->allocated_area += (long)width * height;
+    return true;
+}
+
+/**
+ * @name	page_new
+ * @brief	creates an empty page backed by a cleared GL texture
+ * @retval	texture_atlas_page* - the new page, or NULL on failure
+ */
+static texture_atlas_page *page_new() {
+    // Cleared so that padding gutters are transparent
+    void *clear = calloc(ATLAS_PAGE_AREA, 4);
+    if (!clear) {
+        return NULL;
+    }
+
+    texture_atlas_page *page = (texture_atlas_page *)malloc(sizeof(texture_atlas_page));
+    if (!page) {
+        free(clear);
+        return NULL;
+    }
+
+    GLTRACE(glGenTextures(1, &page->name));
+    GLTRACE(glBindTexture(GL_TEXTURE_2D, page->name));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GLTRACE(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, clear));
+    free(clear);
+
+    if (core_check_gl_error()) {
+        GLTRACE(glDeleteTextures(1, &page->name));
+        free(page);
+        return NULL;
+    }
+
+    page->node_count = 1;
+    page->nodes[0].x = 0;
+    page->nodes[0].y = 0;
+    page->nodes[0].width = ATLAS_PAGE_SIZE;
+    page->allocated_area = 0;
+    page->live_area = 0;
+    page->items = NULL;
+    page->item_count = 0;
+    page->item_max = 0;
+    page->draining = false;
+    page->next = m_pages;
+    m_pages = page;
+
+    ATLASLOG("Created page %d", (int)page->name);
+    return page;
+}
+
+/**
+ * @name	page_destroy
+ * @brief	unlinks a page and frees it
+ * @param	page - (texture_atlas_page *) page to destroy
+ * @param	delete_texture - (bool) whether the GL texture is still valid and should be deleted
+ * @retval	NONE
+ */
+static void page_destroy(texture_atlas_page *page, bool delete_texture) {
+    texture_atlas_page **link = &m_pages;
+    while (*link && *link != page) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = page->next;
+    }
+
+    ATLASLOG("Destroyed page %d", (int)page->name);
+
+    if (delete_texture) {
+        GLTRACE(glDeleteTextures(1, &page->name));
+    }
+    free(page->items);
+    free(page);
+}
+
+/**
+ * @name	page_reserve_item
+ * @brief	makes room in a page's item list for one more texture
+ * @param	page - (texture_atlas_page *) page to grow
+ * @retval	bool - false if the list could not grow, the page is unchanged
+ */
+static bool page_reserve_item(texture_atlas_page *page) {
+    if (page->item_count < page->item_max) {
+        return true;
+    }
+
+    int item_max = page->item_max ? page->item_max * 2 : 16;
+    texture_2d **items = (texture_2d **)realloc(page->items, item_max * sizeof(texture_2d *));
+    if (!items) {
+        return false;
+    }
+    page->items = items;
+    page->item_max = item_max;
+    return true;
+}
+
+/**
+ * @name	page_alloc
+ * @brief	reserves space for a texture in the first page with room, creating one if needed
+ * @param	width - (int) width of the item in texels
+ * @param	height - (int) height of the item in texels
+ * @param	out_x - (int *) out: x coordinate of the item
+ * @param	out_y - (int *) out: y coordinate of the item
+ * @retval	texture_atlas_page* - page holding the space, or NULL on failure
+ */
+static texture_atlas_page *page_alloc(int width, int height, int *out_x, int *out_y) {
+    texture_atlas_page *page;
+    int padded_width = width + ATLAS_PADDING;
+    int padded_height = height + ATLAS_PADDING;
+
+    for (page = m_pages; page; page = page->next) {
+        if (!page->draining && page_reserve_item(page) && skyline_alloc(page, padded_width, padded_height, out_x, out_y)) {
+            break;
+        }
+    }
+
+    if (!page) {
+        page = page_new();
+        if (!page) {
+            return NULL;
+        }
+        if (!page_reserve_item(page) || !skyline_alloc(page, padded_width, padded_height, out_x, out_y)) {
+            page_destroy(page, true);
+            return NULL;
+        }
+    }
+
+    page->live_area += (long)padded_width * padded_height;
+    return page;
+}
+
+/**
+ * @name	page_attach
+ * @brief	records a texture as living at the given position in a page
+ * @retval	NONE
+ */
+static void page_attach(texture_atlas_page *page, texture_2d *tex, int x, int y) {
+    tex->atlas_page = page;
+    tex->atlas_x = x;
+    tex->atlas_y = y;
+    tex->atlas_index = page->item_count;
+    tex->name = page->name;
+    tex->original_name = page->name;
+    page->items[page->item_count++] = tex;
+}
+
+/**
+ * @name	page_detach
+ * @brief	forgets a texture's space in its page, destroying the page when it becomes empty
+ * @retval	NONE
+ */
+static void page_detach(texture_2d *tex) {
+    texture_atlas_page *page = tex->atlas_page;
+    int width, height;
+    get_item_size(tex, &width, &height);
+
+    page->live_area -= (long)(width + ATLAS_PADDING) * (height + ATLAS_PADDING);
+
+    // Swap the last item into the hole
+    texture_2d *last = page->items[--page->item_count];
+    page->items[tex->atlas_index] = last;
+    last->atlas_index = tex->atlas_index;
+
+    tex->atlas_page = NULL;
+    tex->atlas_index = -1;
+
+    if (page->item_count == 0) {
+        page_destroy(page, true);
+    }
+}
+
+/**
+ * @name	copy_region
+ * @brief	copies a rect of one texture into another on the GPU
+ * @retval	bool - true if the copy was issued
+ */
+static bool copy_region(GLuint src_name, int src_x, int src_y, GLuint dest_name, int dest_x, int dest_y, int width, int height) {
+    GLint old_framebuffer = 0;
+    bool complete;
+
+    // Queued draws may still reference the source texture
+    draw_textures_flush();
+
+    GLTRACE(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &old_framebuffer));
+
+    if (!m_copy_framebuffer) {
+        GLTRACE(glGenFramebuffers(1, &m_copy_framebuffer));
+    }
+
+    GLTRACE(glBindFramebuffer(GL_FRAMEBUFFER, m_copy_framebuffer));
+    GLTRACE(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, src_name, 0));
+
+    complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete) {
+        GLTRACE(glBindTexture(GL_TEXTURE_2D, dest_name));
+        GLTRACE(glCopyTexSubImage2D(GL_TEXTURE_2D, 0, dest_x, dest_y, src_x, src_y, width, height));
+    } else {
+        LOG("{atlas} WARNING: Unable to read from texture %d for copy", (int)src_name);
+    }
+
+    GLTRACE(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0));
+    GLTRACE(glBindFramebuffer(GL_FRAMEBUFFER, old_framebuffer));
+
+    return complete;
+}
+
+/**
+ * @name	texture_atlas_add
+ * @brief	packs a texture's pending pixel data into an atlas page if it is small enough
+ * @param	tex - (texture_2d *) texture with loaded, premultiplied RGBA pixel_data
+ * @retval	bool - true if the texture now lives in a page and needs no texture of its own
+ */
+bool texture_atlas_add(texture_2d *tex) {
+    int width, height, x, y;
+
+    if (!can_hold(tex)) {
+        return false;
+    }
+
+    get_item_size(tex, &width, &height);
+
+    texture_atlas_page *page = page_alloc(width, height, &x, &y);
+    if (!page) {
+        return false;
+    }
+
+    // Compact the power-of-two padded rows in place, since ES2 has no UNPACK_ROW_LENGTH
+    const int stride = (tex->width >> TEXTURE_SCALE_SHIFT(tex->scale)) * 4;
+    const int row_bytes = width * 4;
+    if (stride != row_bytes) {
+        int row;
+        for (row = 1; row < height; ++row) {
+            memmove(tex->pixel_data + row * row_bytes, tex->pixel_data + row * stride, row_bytes);
+        }
+    }
+
+    GLTRACE(glBindTexture(GL_TEXTURE_2D, page->name));
+    GLTRACE(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, tex->pixel_data));
+
+    page_attach(page, tex, x, y);
+
+    ATLASLOG("Packed %s (%dx%d) into page %d at %d,%d", tex->url, width, height, (int)page->name, x, y);
+    return true;
+}
+
+/**
+ * @name	texture_atlas_remove
+ * @brief	releases a texture's space in its atlas page
+ * @param	tex - (texture_2d *) texture being destroyed
+ * @retval	NONE
+ */
+void texture_atlas_remove(texture_2d *tex) {
+    if (tex->atlas_page) {
+        page_detach(tex);
+        tex->name = 0;
+        tex->original_name = 0;
+    }
+}
+
+/**
+ * @name	texture_atlas_get_bytes
+ * @brief	gets the bytes of page memory a packed texture occupies, including its gutter
+ * @param	tex - (texture_2d *) packed texture
+ * @retval	long - bytes used
+ */
+long texture_atlas_get_bytes(texture_2d *tex) {
+    int width, height;
+    get_item_size(tex, &width, &height);
+    return (long)(width + ATLAS_PADDING) * (height + ATLAS_PADDING) * 4;
+}
+
+/**
+ * @name	texture_atlas_get_unused_bytes
+ * @brief	gets the bytes of page memory no packed texture accounts for, the
+ *			texture manager charges them to its budget alongside the textures
+ * @retval	long - bytes of all pages less the bytes of their items
+ */
+long texture_atlas_get_unused_bytes() {
+    texture_atlas_page *page;
+    long bytes = 0;
+
+    for (page = m_pages; page; page = page->next) {
+        bytes += (ATLAS_PAGE_AREA - page->live_area) * 4;
+    }
+    return bytes;
+}
+
+/**
+ * @name	texture_atlas_detach
+ * @brief	moves a texture out of its atlas page into a texture of its own.
+ *			used by callers that need texture coordinates spanning the whole texture
+ * @param	tex - (texture_2d *) texture to move
+ * @retval	bool - true if the texture owns its GL texture afterwards
+ */
+bool texture_atlas_detach(texture_2d *tex) {
+    int width, height;
+    GLuint name;
+
+    if (!tex->atlas_page) {
+        return true;
+    }
+
+    get_item_size(tex, &width, &height);
+
+    GLTRACE(glGenTextures(1, &name));
+    GLTRACE(glBindTexture(GL_TEXTURE_2D, name));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GLTRACE(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex->width >> TEXTURE_SCALE_SHIFT(tex->scale), tex->height >> TEXTURE_SCALE_SHIFT(tex->scale), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL));
+
+    if (!copy_region(tex->atlas_page->name, tex->atlas_x, tex->atlas_y, name, 0, 0, width, height)) {
+        GLTRACE(glDeleteTextures(1, &name));
+        return false;
+    }
+
+    page_detach(tex);
+    tex->name = name;
+    tex->original_name = name;
+    return true;
+}
+
+/**
+ * @name	move_item
+ * @brief	moves a texture from a draining page into another page
+ * @retval	bool - true if the texture was moved
+ */
+static bool move_item(texture_2d *tex) {
+    texture_atlas_page *old_page = tex->atlas_page;
+    int width, height, x, y;
+
+    get_item_size(tex, &width, &height);
+
+    texture_atlas_page *page = page_alloc(width, height, &x, &y);
+    if (!page) {
+        return false;
+    }
+
+    if (!copy_region(old_page->name, tex->atlas_x, tex->atlas_y, page->name, x, y, width, height)) {
+        // Keep the space reserved, it is reclaimed when the destination
+        // drains, unless the page was made for this item alone
+        page->live_area -= (long)(width + ATLAS_PADDING) * (height + ATLAS_PADDING);
+        if (page->item_count == 0) {
+            page_destroy(page, true);
+        }
+        return false;
+    }
+
+    page_detach(tex);
+    page_attach(page, tex, x, y);
+    return true;
+}
+
+/**
+ * @name	texture_atlas_tick
+ * @brief	incrementally defragments pages that have mostly been evicted
+ * @retval	NONE
+ */
+void texture_atlas_tick() {
+    texture_atlas_page *page;
+    int moves = ATLAS_DEFRAG_MOVES_PER_TICK;
+
+    for (page = m_pages; page; page = page->next) {
+        // Only bother once a page has filled up enough to block new allocations
+        if (!page->draining && page->allocated_area > ATLAS_PAGE_AREA / 2 &&
+            page->live_area < page->allocated_area * ATLAS_DEFRAG_LIVE_RATIO) {
+            ATLASLOG("Draining page %d, live=%ld allocated=%ld", (int)page->name, page->live_area, page->allocated_area);
+            page->draining = true;
+        }
+    }
+
+    page = m_pages;
+    while (page && moves > 0) {
+        texture_atlas_page *next = page->next;
+
+        while (page->draining && moves > 0) {
+            --moves;
+
+            // The page is destroyed when its last item leaves
+            bool last = page->item_count == 1;
+            if (!move_item(page->items[page->item_count - 1]) || last) {
+                break;
+            }
+        }
+
+        page = next;
+    }
+}
+
+/**
+ * @name	texture_atlas_context_lost
+ * @brief	forgets all pages after the GL context was lost, without touching GL.
+ *			textures in the pages must be reloaded by the caller
+ * @retval	NONE
+ */
+void texture_atlas_context_lost() {
+    while (m_pages) {
+        texture_atlas_page *page = m_pages;
+        int i;
+
+        for (i = 0; i < page->item_count; ++i) {
+            texture_2d *tex = page->items[i];
+            tex->atlas_page = NULL;
+            tex->atlas_index = -1;
+            tex->name = 0;
+            tex->original_name = 0;
+        }
+
+        page_destroy(page, false);
+    }
+
+    m_copy_framebuffer = 0;
+}
@@ -0,0 +1,44 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "core/types.h"
+#include "core/texture_2d.h"
+
+// Dimensions of each shared atlas page in texels
+#define ATLAS_PAGE_SIZE 512
+
+// Largest image (in texels, after half-sizing) that is packed into a page
+#define ATLAS_MAX_ITEM_SIZE 128
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool texture_atlas_add(texture_2d *tex);
+void texture_atlas_remove(texture_2d *tex);
+long texture_atlas_get_bytes(texture_2d *tex);
+long texture_atlas_get_unused_bytes();
+bool texture_atlas_detach(texture_2d *tex);
+void texture_atlas_tick();
+void texture_atlas_context_lost();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
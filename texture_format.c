@@ -0,0 +1,673 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/**
+ * @file	 texture_format.c
+ * @brief	16-bit texture storage: per-url format policy and dithered conversion
+ */
+#include "core/texture_format.h"
+#include "core/util/detect.h"
+#include "core/deps/uthash/uthash.h"
+#include "core/deps/jansson/jansson.h"
+#include "core/log.h"
+#include "platform/resource_loader.h"
+#include "platform/gl.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(GC_NEON)
+#include <arm_neon.h>
+#elif defined(GC_SSE2)
+#include <emmintrin.h>
+#endif
+
+#ifndef GL_UNSIGNED_SHORT_4_4_4_4
+#define GL_UNSIGNED_SHORT_4_4_4_4 0x8033
+#define GL_UNSIGNED_SHORT_5_5_5_1 0x8034
+#endif
+#ifndef GL_UNSIGNED_SHORT_5_6_5
+#define GL_UNSIGNED_SHORT_5_6_5 0x8363
+#endif
+
+typedef struct texture_format_entry_t {
+	char *url;
+	texture_format_policy policy;
+	UT_hash_handle hh;
+} texture_format_entry;
+
+static texture_format_entry *m_manifest = NULL;
+static texture_format_policy m_default_policy = TEXTURE_FORMAT_DEFAULT;
+static bool m_manifest_loaded = false;
+
+// 4x4 ordered dither thresholds, 0-15
+static const unsigned char m_bayer[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5}
+};
+
+static bool parse_policy(const char *name, size_t len, texture_format_policy *policy) {
+    static const struct {
+        const char *name;
+        texture_format_policy policy;
+    } names[] = {
+        {"8888", TEXTURE_FORMAT_DEFAULT},
+        {"4444", TEXTURE_FORMAT_RGBA4444},
+        {"565", TEXTURE_FORMAT_RGB565},
+        {"5551", TEXTURE_FORMAT_RGBA5551},
+        {"etc1", TEXTURE_FORMAT_ETC1},
+        {"auto", TEXTURE_FORMAT_AUTO}
+    };
+    unsigned int i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (strlen(names[i].name) == len && !strncmp(names[i].name, name, len)) {
+            *policy = names[i].policy;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @name	texture_format_load_manifest
+ * @brief	reads the per-url format manifest, if the game has one.  must run
+ *			before images are decoded since lookups are not locked
+ * @retval	NONE
+ */
+void texture_format_load_manifest() {
+    LOGFN("texture_format_load_manifest");
+
+    if (m_manifest_loaded) {
+        return;
+    }
+    m_manifest_loaded = true;
+
+    char *manifest_str = resource_loader_string_from_url(TEXTURE_FORMAT_MANIFEST_URL);
+    if (!manifest_str) {
+        return;
+    }
+
+    json_error_t error;
+    json_t *root = json_loads(manifest_str, 0, &error);
+    free(manifest_str);
+
+    if (!json_is_object(root)) {
+        LOG("{tex} WARNING: Ignoring invalid texture format manifest %s", TEXTURE_FORMAT_MANIFEST_URL);
+        json_decref(root);
+        return;
+    }
+
+    const char *key;
+    json_t *value;
+    json_object_foreach(root, key, value) {
+        const char *name = json_string_value(value);
+        texture_format_policy policy;
+
+        if (!name || !parse_policy(name, strlen(name), &policy)) {
+            LOG("{tex} WARNING: Unknown texture format for %s", key);
+        } else if (!strcmp(key, "*")) {
+            m_default_policy = policy;
+        } else {
+            texture_format_entry *entry = NULL;
+            HASH_FIND_STR(m_manifest, key, entry);
+            if (!entry) {
+                entry = (texture_format_entry *)malloc(sizeof(texture_format_entry));
+                if (entry) {
+                    entry->url = strdup(key);
+                }
+                if (!entry || !entry->url) {
+                    // the image keeps the default format
+                    LOG("{tex} WARNING: Out of memory for the texture format of %s", key);
+                    free(entry);
+                    continue;
+                }
+                HASH_ADD_KEYPTR(hh, m_manifest, entry->url, strlen(entry->url), entry);
+            }
+            entry->policy = policy;
+        }
+    }
+
+    json_decref(root);
+}
+
+/**
+ * @name	texture_format_get_policy
+ * @brief	picks the storage format for an image.  a suffix in the file name
+ *			wins over the manifest, which wins over the manifest default
+ * @param	url - (const char *) url of the image, may be NULL
+ * @retval	texture_format_policy - format to store the image in
+ */
+texture_format_policy texture_format_get_policy(const char *url) {
+    texture_format_policy policy = m_default_policy;
+
+    if (!url) {
+        return policy;
+    }
+
+    // "name.4444.png": the second to last dot-separated part of the file name
+    const char *file = strrchr(url, '/');
+    file = file ? file + 1 : url;
+    const char *ext = strrchr(file, '.');
+    if (ext && ext != file) {
+        const char *suffix = ext - 1;
+        while (suffix > file && *suffix != '.') {
+            --suffix;
+        }
+        if (*suffix == '.' && parse_policy(suffix + 1, ext - suffix - 1, &policy)) {
+            return policy;
+        }
+    }
+
+    texture_format_entry *entry = NULL;
+    HASH_FIND_STR(m_manifest, url, entry);
+    return entry ? entry->policy : m_default_policy;
+}
+
+/**
+ * @name	texture_format_bytes_per_texel
+ * @brief	size of one texel of uncompressed pixel data
+ * @param	num_channels - (int) number of channels
+ * @param	pixel_type - (int) packed GL pixel type, or zero for 8 bits per channel
+ * @retval	int - bytes per texel
+ */
+int texture_format_bytes_per_texel(int num_channels, int pixel_type) {
+    return pixel_type ? 2 : num_channels;
+}
+
+/*
+ * Row converters.  Every output texel is written at or before the input texel
+ * it came from, so they work in place.  The SIMD paths handle whole groups of
+ * 4 texels starting on a multiple of 4, where the dither pattern lines up, and
+ * give the same results as the scalar loops that finish each row.
+ */
+
+#define DITHER(c, d) ((c) + (d) > 255 ? 255 : (c) + (d))
+
+static void convert_row_4444(const unsigned char *in, unsigned short *out, int width, int y) {
+    const unsigned char *bayer = m_bayer[y & 3];
+    int x = 0;
+
+#if defined(GC_NEON)
+    const uint8x8_t d8 = vld1_u8((const unsigned char[8]) {
+        bayer[0], bayer[1], bayer[2], bayer[3], bayer[0], bayer[1], bayer[2], bayer[3]
+    });
+    const uint8x16_t d = vcombine_u8(d8, d8);
+    for (; x + 16 <= width; x += 16, in += 64) {
+        uint8x16x4_t p = vld4q_u8(in);
+        uint8x16_t r = vqaddq_u8(p.val[0], d), g = vqaddq_u8(p.val[1], d);
+        uint8x16_t b = vqaddq_u8(p.val[2], d), a = vqaddq_u8(p.val[3], d);
+
+        uint16x8_t lo = vshll_n_u8(vget_low_u8(r), 8);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(g), 8), 4);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(b), 8), 8);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(a), 8), 12);
+        uint16x8_t hi = vshll_n_u8(vget_high_u8(r), 8);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(g), 8), 4);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(b), 8), 8);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(a), 8), 12);
+
+        vst1q_u16(out + x, lo);
+        vst1q_u16(out + x + 8, hi);
+    }
+#elif defined(GC_SSE2)
+    const __m128i d = _mm_setr_epi8(bayer[0], bayer[0], bayer[0], bayer[0], bayer[1], bayer[1], bayer[1], bayer[1],
+                                    bayer[2], bayer[2], bayer[2], bayer[2], bayer[3], bayer[3], bayer[3], bayer[3]);
+    const __m128i r_mask = _mm_set1_epi32(0xF0), g_mask = _mm_set1_epi32(0xF000), b_mask = _mm_set1_epi32(0xF00000);
+    for (; x + 8 <= width; x += 8, in += 32) {
+        __m128i v[2];
+        int i;
+        for (i = 0; i < 2; ++i) {
+            __m128i p = _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(in + i * 16)), d);
+            __m128i t = _mm_slli_epi32(_mm_and_si128(p, r_mask), 8);
+            t = _mm_or_si128(t, _mm_srli_epi32(_mm_and_si128(p, g_mask), 4));
+            t = _mm_or_si128(t, _mm_srli_epi32(_mm_and_si128(p, b_mask), 16));
+            t = _mm_or_si128(t, _mm_srli_epi32(p, 28));
+            // sign extend so the saturating pack keeps all 16 bits
+            v[i] = _mm_srai_epi32(_mm_slli_epi32(t, 16), 16);
+        }
+        _mm_storeu_si128((__m128i *)(out + x), _mm_packs_epi32(v[0], v[1]));
+    }
+#endif
+
+    for (; x < width; ++x, in += 4) {
+        int d = bayer[x & 3];
+        out[x] = (unsigned short)(((DITHER(in[0], d) >> 4) << 12) | ((DITHER(in[1], d) >> 4) << 8) |
+                                  ((DITHER(in[2], d) >> 4) << 4) | (DITHER(in[3], d) >> 4));
+    }
+}
+
+static void convert_row_5551(const unsigned char *in, unsigned short *out, int width, int y) {
+    const unsigned char *bayer = m_bayer[y & 3];
+    int x = 0;
+
+#if defined(GC_NEON)
+    const uint8x8_t d8 = vld1_u8((const unsigned char[8]) {
+        bayer[0] >> 1, bayer[1] >> 1, bayer[2] >> 1, bayer[3] >> 1, bayer[0] >> 1, bayer[1] >> 1, bayer[2] >> 1, bayer[3] >> 1
+    });
+    const uint8x16_t d = vcombine_u8(d8, d8);
+    for (; x + 16 <= width; x += 16, in += 64) {
+        uint8x16x4_t p = vld4q_u8(in);
+        uint8x16_t a = vcgeq_u8(p.val[3], vdupq_n_u8(128));
+        uint8x16_t r = vandq_u8(vqaddq_u8(p.val[0], d), a);
+        uint8x16_t g = vandq_u8(vqaddq_u8(p.val[1], d), a);
+        uint8x16_t b = vandq_u8(vqaddq_u8(p.val[2], d), a);
+
+        uint16x8_t lo = vshll_n_u8(vget_low_u8(r), 8);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(g), 8), 5);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(b), 8), 10);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(a), 8), 15);
+        uint16x8_t hi = vshll_n_u8(vget_high_u8(r), 8);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(g), 8), 5);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(b), 8), 10);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(a), 8), 15);
+
+        vst1q_u16(out + x, lo);
+        vst1q_u16(out + x + 8, hi);
+    }
+#elif defined(GC_SSE2)
+    const int d0 = bayer[0] >> 1, d1 = bayer[1] >> 1, d2 = bayer[2] >> 1, d3 = bayer[3] >> 1;
+    const __m128i d = _mm_setr_epi8(d0, d0, d0, 0, d1, d1, d1, 0, d2, d2, d2, 0, d3, d3, d3, 0);
+    const __m128i r_mask = _mm_set1_epi32(0xF8), g_mask = _mm_set1_epi32(0xF800), b_mask = _mm_set1_epi32(0xF80000);
+    for (; x + 8 <= width; x += 8, in += 32) {
+        __m128i v[2];
+        int i;
+        for (i = 0; i < 2; ++i) {
+            __m128i p = _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(in + i * 16)), d);
+            __m128i t = _mm_slli_epi32(_mm_and_si128(p, r_mask), 8);
+            t = _mm_or_si128(t, _mm_srli_epi32(_mm_and_si128(p, g_mask), 5));
+            t = _mm_or_si128(t, _mm_srli_epi32(_mm_and_si128(p, b_mask), 18));
+            t = _mm_or_si128(t, _mm_srli_epi32(p, 31));
+            // texels below half coverage are dropped entirely
+            t = _mm_and_si128(t, _mm_srai_epi32(p, 31));
+            v[i] = _mm_srai_epi32(_mm_slli_epi32(t, 16), 16);
+        }
+        _mm_storeu_si128((__m128i *)(out + x), _mm_packs_epi32(v[0], v[1]));
+    }
+#endif
+
+    for (; x < width; ++x, in += 4) {
+        int d = bayer[x & 3] >> 1;
+        if (in[3] < 128) {
+            // premultiplied color without alpha would draw additively
+            out[x] = 0;
+        } else {
+            out[x] = (unsigned short)(((DITHER(in[0], d) >> 3) << 11) | ((DITHER(in[1], d) >> 3) << 6) |
+                                      ((DITHER(in[2], d) >> 3) << 1) | 1);
+        }
+    }
+}
+
+static void convert_row_565(const unsigned char *in, unsigned short *out, int width, int y, int channels) {
+    const unsigned char *bayer = m_bayer[y & 3];
+    int x = 0;
+
+#if defined(GC_NEON)
+    const uint8x8_t rb8 = vld1_u8((const unsigned char[8]) {
+        bayer[0] >> 1, bayer[1] >> 1, bayer[2] >> 1, bayer[3] >> 1, bayer[0] >> 1, bayer[1] >> 1, bayer[2] >> 1, bayer[3] >> 1
+    });
+    const uint8x16_t d_rb = vcombine_u8(rb8, rb8);
+    const uint8x16_t d_g = vshrq_n_u8(d_rb, 1);
+    for (; x + 16 <= width; x += 16, in += channels * 16) {
+        uint8x16_t r, g, b;
+        if (channels == 4) {
+            uint8x16x4_t p = vld4q_u8(in);
+            r = p.val[0], g = p.val[1], b = p.val[2];
+        } else {
+            uint8x16x3_t p = vld3q_u8(in);
+            r = p.val[0], g = p.val[1], b = p.val[2];
+        }
+        r = vqaddq_u8(r, d_rb);
+        g = vqaddq_u8(g, d_g);
+        b = vqaddq_u8(b, d_rb);
+
+        uint16x8_t lo = vshll_n_u8(vget_low_u8(r), 8);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(g), 8), 5);
+        lo = vsriq_n_u16(lo, vshll_n_u8(vget_low_u8(b), 8), 11);
+        uint16x8_t hi = vshll_n_u8(vget_high_u8(r), 8);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(g), 8), 5);
+        hi = vsriq_n_u16(hi, vshll_n_u8(vget_high_u8(b), 8), 11);
+
+        vst1q_u16(out + x, lo);
+        vst1q_u16(out + x + 8, hi);
+    }
+#elif defined(GC_SSE2)
+    // SSE2 has no byte shuffle to unpack 3-byte texels, those stay scalar
+    if (channels == 4) {
+        const int d0 = bayer[0] >> 1, d1 = bayer[1] >> 1, d2 = bayer[2] >> 1, d3 = bayer[3] >> 1;
+        const __m128i d = _mm_setr_epi8(d0, d0 >> 1, d0, 0, d1, d1 >> 1, d1, 0, d2, d2 >> 1, d2, 0, d3, d3 >> 1, d3, 0);
+        const __m128i r_mask = _mm_set1_epi32(0xF8), g_mask = _mm_set1_epi32(0xFC00), b_mask = _mm_set1_epi32(0xF80000);
+        for (; x + 8 <= width; x += 8, in += 32) {
+            __m128i v[2];
+            int i;
+            for (i = 0; i < 2; ++i) {
+                __m128i p = _mm_adds_epu8(_mm_loadu_si128((const __m128i *)(in + i * 16)), d);
+                __m128i t = _mm_slli_epi32(_mm_and_si128(p, r_mask), 8);
+                t = _mm_or_si128(t, _mm_srli_epi32(_mm_and_si128(p, g_mask), 5));
+                t = _mm_or_si128(t, _mm_srli_epi32(_mm_and_si128(p, b_mask), 19));
+                v[i] = _mm_srai_epi32(_mm_slli_epi32(t, 16), 16);
+            }
+            _mm_storeu_si128((__m128i *)(out + x), _mm_packs_epi32(v[0], v[1]));
+        }
+    }
+#endif
+
+    for (; x < width; ++x, in += channels) {
+        int d = bayer[x & 3] >> 1;
+        out[x] = (unsigned short)(((DITHER(in[0], d) >> 3) << 11) | ((DITHER(in[1], d >> 1) >> 2) << 5) |
+                                  (DITHER(in[2], d) >> 3));
+    }
+}
+
+/**
+ * @name	texture_format_is_opaque
+ * @brief	checks that every texel inside any padding has full alpha
+ * @param	pixels - (const unsigned char *) 8-bit pixel data with rows of width texels
+ * @param	width - (int) width of the pixel data in texels
+ * @param	content_width - (int) width of the image inside any padding
+ * @param	content_height - (int) height of the image inside any padding
+ * @param	channels - (int) channels of the pixel data
+ * @retval	bool - true if the image has no transparency
+ */
+bool texture_format_is_opaque(const unsigned char *pixels, int width, int content_width, int content_height, int channels) {
+    int x, y;
+
+    if (channels != 4) {
+        return true;
+    }
+
+    for (y = 0; y < content_height; ++y) {
+        const unsigned char *alpha = pixels + (long)y * width * 4 + 3;
+        unsigned char all = 255;
+        for (x = 0; x < content_width; ++x, alpha += 4) {
+            all &= *alpha;
+        }
+        if (all != 255) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @name	texture_format_find_opacity
+ * @brief	finds the opaque cells of 8-bit pixel data, rows of cells are
+ *			scanned together so each row of texels is read once
+ * @param	pixels - (const unsigned char *) 8-bit pixel data with rows of width texels
+ * @param	width - (int) width of the pixel data in texels
+ * @param	height - (int) height of the pixel data in texels
+ * @param	content_width - (int) width of the image inside any padding
+ * @param	content_height - (int) height of the image inside any padding
+ * @param	channels - (int) channels of the pixel data
+ * @param	out - (texture_opacity *) filled in, free with texture_format_free_opacity()
+ * @retval	NONE
+ */
+void texture_format_find_opacity(const unsigned char *pixels, int width, int height, int content_width, int content_height,
+                                 int channels, texture_opacity *out) {
+    int x, y, cx, cy;
+
+    texture_format_set_opacity(out, channels != 4, width, height, content_width, content_height);
+    if (out->opaque) {
+        return;
+    }
+
+    const int stride = (out->cells_wide + 7) >> 3;
+    unsigned char *cells = (unsigned char *)calloc(stride * out->cells_high, 1);
+    unsigned char *all = (unsigned char *)malloc(out->cells_wide);
+    bool opaque = true, any = false;
+
+    // without cells nothing is classified opaque, which only costs blending
+    if (!cells || !all) {
+        free(cells);
+        free(all);
+        return;
+    }
+
+    for (cy = 0; cy < out->cells_high; ++cy) {
+        int y_end = (cy + 1) << TEXTURE_OPACITY_CELL_SHIFT;
+        if (y_end > content_height) {
+            y_end = content_height;
+        }
+
+        memset(all, 255, out->cells_wide);
+        for (y = cy << TEXTURE_OPACITY_CELL_SHIFT; y < y_end; ++y) {
+            const unsigned char *alpha = pixels + (long)y * width * 4 + 3;
+            for (cx = 0, x = 0; cx < out->cells_wide; ++cx) {
+                int x_end = (cx + 1) << TEXTURE_OPACITY_CELL_SHIFT;
+                unsigned char a = all[cx];
+                if (x_end > content_width) {
+                    x_end = content_width;
+                }
+                for (; x < x_end; ++x) {
+                    a &= alpha[x * 4];
+                }
+                all[cx] = a;
+            }
+        }
+
+        for (cx = 0; cx < out->cells_wide; ++cx) {
+            if (all[cx] == 255) {
+                cells[cy * stride + (cx >> 3)] |= 1 << (cx & 7);
+                any = true;
+            } else {
+                opaque = false;
+            }
+        }
+    }
+
+    free(all);
+    out->opaque = opaque;
+    if (opaque || !any) {
+        free(cells);
+    } else {
+        out->cells = cells;
+    }
+}
+
+/**
+ * @name	texture_format_set_opacity
+ * @brief	classifies a whole image at once, for formats whose alpha is not
+ *			read texel by texel
+ * @param	out - (texture_opacity *) filled in
+ * @param	opaque - (bool) true if the image has no transparency
+ * @param	width - (int) width of the texture in texels
+ * @param	height - (int) height of the texture in texels
+ * @param	content_width - (int) width of the image inside any padding
+ * @param	content_height - (int) height of the image inside any padding
+ * @retval	NONE
+ */
+void texture_format_set_opacity(texture_opacity *out, bool opaque, int width, int height, int content_width, int content_height) {
+    out->opaque = opaque;
+    out->padded = content_width < width || content_height < height;
+    out->width = content_width;
+    out->height = content_height;
+    out->cells_wide = (content_width + TEXTURE_OPACITY_CELL - 1) >> TEXTURE_OPACITY_CELL_SHIFT;
+    out->cells_high = (content_height + TEXTURE_OPACITY_CELL - 1) >> TEXTURE_OPACITY_CELL_SHIFT;
+    out->cells = NULL;
+}
+
+/**
+ * @name	texture_format_is_opaque_rect
+ * @brief	checks that every texel a linearly filtered draw of a rectangle
+ *			reads has full alpha, which takes in a texel around the rectangle
+ * @param	opacity - (const texture_opacity *) opacity of the texture
+ * @param	x - (float) left of the rectangle in texels
+ * @param	y - (float) top of the rectangle in texels
+ * @param	width - (float) width of the rectangle in texels
+ * @param	height - (float) height of the rectangle in texels
+ * @param	clamped - (bool) true if reads past the edges of the image are
+ *			clamped to it, false if they land on other images of an atlas
+ * @retval	bool - true if the rectangle draws opaque
+ */
+bool texture_format_is_opaque_rect(const texture_opacity *opacity, float x, float y, float width, float height, bool clamped) {
+    int x0 = (int)floorf(x) - 1;
+    int y0 = (int)floorf(y) - 1;
+    int x1 = (int)ceilf(x + width) + 1;
+    int y1 = (int)ceilf(y + height) + 1;
+    int cx, cy;
+
+    if (!opacity->opaque && !opacity->cells) {
+        return false;
+    }
+
+    // Clamping repeats the edge texels, except where padding follows
+    if (x0 < 0 || y0 < 0) {
+        if (!clamped) {
+            return false;
+        }
+        x0 = x0 < 0 ? 0 : x0;
+        y0 = y0 < 0 ? 0 : y0;
+    }
+    if (x1 > opacity->width || y1 > opacity->height) {
+        if (!clamped || opacity->padded) {
+            return false;
+        }
+        x1 = x1 > opacity->width ? opacity->width : x1;
+        y1 = y1 > opacity->height ? opacity->height : y1;
+    }
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+
+    if (opacity->opaque) {
+        return true;
+    }
+
+    const int stride = (opacity->cells_wide + 7) >> 3;
+    for (cy = y0 >> TEXTURE_OPACITY_CELL_SHIFT; cy <= (y1 - 1) >> TEXTURE_OPACITY_CELL_SHIFT; ++cy) {
+        const unsigned char *row = opacity->cells + cy * stride;
+        for (cx = x0 >> TEXTURE_OPACITY_CELL_SHIFT; cx <= (x1 - 1) >> TEXTURE_OPACITY_CELL_SHIFT; ++cx) {
+            if (!(row[cx >> 3] & (1 << (cx & 7)))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @name	texture_format_copy_opacity
+ * @brief	copies the opacity of one texture to another
+ * @param	dest - (texture_opacity *) opacity to fill in, not freed first
+ * @param	src - (const texture_opacity *) opacity to copy
+ * @retval	NONE
+ */
+void texture_format_copy_opacity(texture_opacity *dest, const texture_opacity *src) {
+    *dest = *src;
+    if (src->cells) {
+        size_t size = ((src->cells_wide + 7) >> 3) * src->cells_high;
+        dest->cells = (unsigned char *)malloc(size);
+        if (dest->cells) {
+            memcpy(dest->cells, src->cells, size);
+        }
+    }
+}
+
+/**
+ * @name	texture_format_free_opacity
+ * @brief	frees the cells of an opacity and leaves it classifying nothing as opaque
+ * @param	opacity - (texture_opacity *) opacity to free
+ * @retval	NONE
+ */
+void texture_format_free_opacity(texture_opacity *opacity) {
+    free(opacity->cells);
+    memset(opacity, 0, sizeof(texture_opacity));
+}
+
+/**
+ * @name	texture_format_convert
+ * @brief	converts premultiplied 8-bit pixel data in place to the 16-bit
+ *			format asked for by a policy, with ordered dithering.  single
+ *			channel images are left alone and RGB images have no alpha to
+ *			keep so they always become RGB565.  mip levels following the base
+ *			level get the format picked for the base level and are packed
+ *			one after another again
+ * @param	policy - (texture_format_policy) format to convert to
+ * @param	pixels - (unsigned char *) pixel data with rows of width texels
+ * @param	width - (int) width of the pixel data in texels
+ * @param	height - (int) height of the pixel data in texels
+ * @param	content_width - (int) width of the image inside any padding
+ * @param	content_height - (int) height of the image inside any padding
+ * @param	num_levels - (int) levels in the pixel data, see mipmap.h
+ * @param	channels - (int *) in: channels of the pixel data, out: channels of the GL format
+ * @retval	int - packed GL pixel type of the converted data, or zero if unchanged
+ */
+int texture_format_convert(texture_format_policy policy, unsigned char *pixels, int width, int height,
+                           int content_width, int content_height, int num_levels, int *channels) {
+    const int ch = *channels;
+    const unsigned char *src = pixels;
+    unsigned char *dst = pixels;
+    int pixel_type;
+    int level, y;
+
+    if (policy == TEXTURE_FORMAT_DEFAULT || ch == 1 || !pixels) {
+        return 0;
+    }
+
+    // ETC1 is encoded by the caller, anything left over is handled as auto
+    if (policy == TEXTURE_FORMAT_AUTO || policy == TEXTURE_FORMAT_ETC1) {
+        if (!texture_format_is_opaque(pixels, width, content_width, content_height, ch)) {
+            return 0;
+        }
+        policy = TEXTURE_FORMAT_RGB565;
+    } else if (ch == 3) {
+        policy = TEXTURE_FORMAT_RGB565;
+    }
+
+    // Output never overtakes input, so every level converts in place
+    for (level = 0; level < num_levels; ++level) {
+        for (y = 0; y < height; ++y) {
+            const unsigned char *in = src + (long)y * width * ch;
+            unsigned short *out = (unsigned short *)(dst + (long)y * width * 2);
+
+            switch (policy) {
+            case TEXTURE_FORMAT_RGBA4444:
+                convert_row_4444(in, out, width, y);
+                break;
+            case TEXTURE_FORMAT_RGBA5551:
+                convert_row_5551(in, out, width, y);
+                break;
+            default:
+                convert_row_565(in, out, width, y, ch);
+                break;
+            }
+        }
+
+        src += (long)width * height * ch;
+        dst += (long)width * height * 2;
+        width = width > 1 ? width >> 1 : 1;
+        height = height > 1 ? height >> 1 : 1;
+    }
+
+    switch (policy) {
+    case TEXTURE_FORMAT_RGBA4444:
+        pixel_type = GL_UNSIGNED_SHORT_4_4_4_4;
+        break;
+    case TEXTURE_FORMAT_RGBA5551:
+        pixel_type = GL_UNSIGNED_SHORT_5_5_5_1;
+        break;
+    default:
+        pixel_type = GL_UNSIGNED_SHORT_5_6_5;
+        *channels = 3;
+        break;
+    }
+
+    return pixel_type;
+}
@@ -0,0 +1,87 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+#ifndef TEXTURE_FORMAT_H
+#define TEXTURE_FORMAT_H
+
+#include "core/types.h"
+
+/*
+ * Storage format for decoded images.  An image picks its format with a
+ * suffix before the extension ("hud.4444.png") or an entry in
+ * spritesheets/textureFormats.json, which maps urls to format names and
+ * may give a default for every other image under the key "*":
+ *
+ *   { "*": "auto", "resources/images/sky.png": "565" }
+ *
+ * Format names are "8888", "4444", "565", "5551", "etc1" and "auto".  ETC1
+ * needs an opaque image and a GPU that takes it, otherwise "etc1" acts as
+ * "auto".  "auto" also picks ETC1 for opaque images of at least
+ * TEXTURE_FORMAT_ETC1_MIN_TEXELS.
+ */
+#define TEXTURE_FORMAT_MANIFEST_URL "spritesheets/textureFormats.json"
+
+typedef enum texture_format_policy_t {
+	TEXTURE_FORMAT_DEFAULT = 0, // 8 bits per channel
+	TEXTURE_FORMAT_RGBA4444,
+	TEXTURE_FORMAT_RGB565,
+	TEXTURE_FORMAT_RGBA5551,
+	TEXTURE_FORMAT_ETC1,
+	TEXTURE_FORMAT_AUTO // ETC1 or RGB565 for opaque images, otherwise 8 bits per channel
+} texture_format_policy;
+
+#define TEXTURE_FORMAT_ETC1_MIN_TEXELS (256 * 256)
+
+/*
+ * Opaque regions of a decoded image, found in squares of TEXTURE_OPACITY_CELL
+ * texels so sprite frames packed into a sheet with transparent frames still
+ * classify on their own.  Quads drawn from opaque regions can skip blending,
+ * see draw_textures_set_opaque_pass().
+ */
+#define TEXTURE_OPACITY_CELL_SHIFT 5
+#define TEXTURE_OPACITY_CELL (1 << TEXTURE_OPACITY_CELL_SHIFT)
+
+typedef struct texture_opacity_t {
+	bool opaque; // Every texel of the image has full alpha
+	bool padded; // Transparent padding follows the image on the right or below
+	int width; // Image inside any padding, in texels
+	int height;
+	int cells_wide;
+	int cells_high;
+	unsigned char *cells; // Bit per cell in rows of (cells_wide + 7) / 8 bytes, set when every texel has full alpha. NULL if opaque or no cell is
+} texture_opacity;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void texture_format_load_manifest();
+texture_format_policy texture_format_get_policy(const char *url);
+int texture_format_convert(texture_format_policy policy, unsigned char *pixels, int width, int height,
+                           int content_width, int content_height, int num_levels, int *channels);
+int texture_format_bytes_per_texel(int num_channels, int pixel_type);
+bool texture_format_is_opaque(const unsigned char *pixels, int width, int content_width, int content_height, int channels);
+void texture_format_find_opacity(const unsigned char *pixels, int width, int height, int content_width, int content_height,
+                                 int channels, texture_opacity *out);
+void texture_format_set_opacity(texture_opacity *out, bool opaque, int width, int height, int content_width, int content_height);
+bool texture_format_is_opaque_rect(const texture_opacity *opacity, float x, float y, float width, float height, bool clamped);
+void texture_format_copy_opacity(texture_opacity *dest, const texture_opacity *src);
+void texture_format_free_opacity(texture_opacity *opacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
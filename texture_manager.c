@@ -15,13 +15,25 @@
 
 #include "core/texture_manager.h"
 #include "core/texture_2d.h"
+#include "core/texture_atlas.h"
+#include "core/sheet_index.h"
+#include "core/texture_format.h"
+#include "core/compressed_texture.h"
+#include "core/image_loader.h"
+#include "core/canvas_spill.h"
+#include "core/pixel_cache.h"
+#include "core/buffer_pool.h"
+#include "core/tealeaf_canvas.h"
 #include "core/deps/uthash/uthash.h"
 #include "core/core.h"
 #include "core/log.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <math.h>
+#include <sys/time.h>
 #include "core/image-cache/include/image_cache.h"
+#include "core/image-cache/include/murmur.h"
 #include "core/config.h"
 #include "platform/resource_loader.h"
 #include "core/list.h"
@@ -32,6 +44,8 @@
 #include "core/platform/threads.h"
 
 #define DEFAULT_SHEET_DIMENSION 64
+#define SHEET_INDEX_URL "spritesheets/spritesheetSizeMap.bin"
+#define SHEET_MAP_URL "spritesheets/spritesheetSizeMap.json"
 
 // Large number to start texture memory limit
 #define MAX_BYTES_FOR_TEXTURES 500000000    /* 500 MB */
@@ -46,29 +60,123 @@
 #define DEFAULT_CONTACTPHOTO_SIZE 64
 #define DEFAULT_REMOTE_RESOURCE_SIZE 64
 
+// Canvas texels read back per tick when spilling canvases over the memory limit
+#define CANVAS_SPILL_BYTES_PER_TICK (8 * 1024 * 1024)
+
+// Texture bytes uploaded per tick, at least one texture or mip level goes up each tick
+#define TEXTURE_UPLOAD_BYTES_PER_TICK (8 * 1024 * 1024)
+
+// Levels of detail, see update_texture_lods()
+#define LOD_WINDOW_FRAMES 30 /* frames of draws looked at for each decision */
+#define LOD_DROP_WINDOWS 2 /* windows in a row drawn small before dropping texels */
+#define LOD_DROP_LIMIT2 0.81f /* squared screen pixels per texel to drop to, a margin below 1 */
+#define LOD_RELOADS_PER_TICK 4
+
+// Textures drawn within this many frames of a context loss are loaded again
+// right away, most recent first, the rest wait until they are drawn
+#define RELOAD_RECENT_FRAMES 120
+
 // Global halfsized textures flags
 int use_halfsized_textures = false;
 bool should_use_halfsized = false;
 
+// Global flag for generating mip levels of decoded images
+int generate_mipmaps = false;
+
 static bool m_running = false; // Flag indicating that the background texture loader thread should continue
 static texture_manager *m_instance = NULL;
 static bool m_instance_ready = false; // Flag indicating that the instance is ready
 static bool m_memory_warning = false; // Flag indicating that a memory warning occurred
 static bool m_memory_critical = false; // We should not increase max memory after this flag is set
+static bool m_lod_dirty = false; // The halfsize floor changed, see update_texture_lods()
 
 static ThreadsThread m_load_thread = THREADS_INVALID_THREAD;
 static pthread_mutex_t mutex     = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t cond_var   = PTHREAD_COND_INITIALIZER;
 
 static texture_2d *tex_load_list = NULL;
-static json_t *spritesheet_map_root = NULL;
+static sheet_index *m_sheet_index = NULL;
+static bool m_sheet_index_loaded = false;
 static int m_frame_epoch = 1;
 static long m_frame_used_bytes = 0;
+static long m_atlas_unused_bytes = 0; // Page bytes charged for atlas space no item holds
 
 #define EPOCH_USED_BINS 64 /* must be power of two */
 #define EPOCH_USED_MASK (EPOCH_USED_BINS - 1)
 static long m_epoch_used[EPOCH_USED_BINS] = {0};
 
+// Draw lookups through texture_manager_load_texture()
+static unsigned long m_lookup_hits = 0;
+static unsigned long m_lookup_misses = 0;
+
+// Interned urls, see texture_manager_get_handle()
+typedef struct texture_handle_entry_t {
+    char *url;
+    int handle;
+    UT_hash_handle hh;
+} texture_handle_entry;
+
+static texture_handle_entry *m_handle_by_url = NULL;
+static texture_handle_entry **m_handle_entries = NULL; // indexed by handle, 0 is never used
+static texture_2d **m_handle_textures = NULL; // current texture for each handle, or NULL
+static int m_handle_count = 1;
+static int m_handle_max = 0;
+
+// GL textures shared by textures loaded from identical file data, keyed by
+// the content hash.  The texture bytes are charged here rather than to each
+// of the textures, whose used_texture_bytes stay zero
+typedef struct shared_texture_t {
+    unsigned int hash[4];
+    int name;
+    int refcount;
+    long bytes;
+
+    // Layout of the GL texture, copied to textures that join
+    int width;
+    int height;
+    int original_width;
+    int original_height;
+    int scale;
+    int num_channels;
+    int compression_type;
+    int pixel_type;
+    int num_levels;
+    texture_opacity opacity;
+
+    // The min filter belongs to the GL texture, so it follows all the sharers
+    int minified_epoch;
+    bool mipmapped;
+
+    UT_hash_handle hh;
+} shared_texture;
+
+static shared_texture *m_shared_textures = NULL;
+
+// Scale each url loads at when it is not the default, kept across evictions.
+// Decode threads read it, so it has its own lock
+typedef struct lod_entry_t {
+    char *url;
+    int scale;
+    UT_hash_handle hh;
+} lod_entry;
+
+static lod_entry *m_lod_scales = NULL;
+static pthread_mutex_t m_lod_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Image sizes read from file headers ahead of their decode, see
+// texture_manager_probe_image().  Decode threads may hold the texture
+// mutex, so these have their own lock until the next tick takes them
+typedef struct probed_size_t {
+    char *url;
+    int width;
+    int height;
+    int num_channels;
+    UT_hash_handle hh;
+} probed_size;
+
+static probed_size *m_probed_sizes = NULL;
+static pthread_mutex_t m_probe_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 // TODO: Optimize the mutex lock holding times
 
 #if defined(TEXMAN_VERBOSE)
@@ -77,6 +185,14 @@ static long m_epoch_used[EPOCH_USED_BINS] = {0};
 #define TEXLOG(fmt, ...)
 #endif
 
+static long get_epoch_used_max();
+
+static double now_ms() {
+    struct timeval n;
+    gettimeofday(&n, NULL);
+    return (n.tv_sec * 1000.0) + (n.tv_usec / 1000.0);
+}
+
 bool is_remote_resource(const char *url) {
     //TODO: until ios implements simulate and stores images from http
     //on disk, need this temporary ifdef
@@ -96,6 +212,29 @@ bool is_remote_resource(const char *url) {
     return is_remote;
 }
 
+// What besides the url changes the texels an image decodes to
+static unsigned int get_texel_variant(const char *url) {
+    return (unsigned int)texture_format_get_policy(url) | (texture_manager_get_lod_scale(url) << 8);
+}
+
+// Keeps the texels of a decoded image once uploaded, so loading it again
+// after eviction is a decompress.  Textures drawn last frame or this one are
+// in use and unlikely to be evicted soon, so they are not compressed while
+// uploads peak nor fill the cache.  Proxies, atlas items (their rows were
+// packed tight for the page upload), files that were already compressed and
+// images that are not files are freed as before
+static void release_texels(texture_2d *tex) {
+    const char *url = tex->url;
+    const bool drawn = tex->frame_epoch && m_frame_epoch - tex->frame_epoch <= 1;
+    if (!drawn && !tex->failed && !tex->proxy_shift && !tex->atlas_page && !tex->compression_type && !tex->is_canvas && !tex->is_text &&
+        (!is_remote_resource(url) || !strncmp("http", url, 4) || !strncmp("//", url, 2))) {
+        pixel_cache_put(tex, get_texel_variant(url));
+    } else {
+        buffer_pool_release(tex->pixel_data);
+        tex->pixel_data = NULL;
+    }
+}
+
 texture_2d *texture_manager_new_texture_from_data(texture_manager *manager, int width, int height, const void *data) {
     texture_2d *tex = texture_2d_new_from_data(width, height, data);
     texture_manager_add_texture(manager, tex, false);
@@ -134,6 +273,70 @@ static void notify_canvas_death(const char *url) {
     }
 }
 
+static void notify_image_size(const char *url, int width, int height) {
+    // generate event string
+    char *event_str;
+    int event_len;
+    char *dynamic_str = 0;
+    char stack_str[512];
+    int url_len = (int)strlen(url);
+    if (url_len > 300) {
+        event_len = url_len + 212;
+        dynamic_str = (char*)malloc(event_len);
+        event_str = dynamic_str;
+    } else {
+        event_len = 512;
+        event_str = stack_str;
+    }
+
+    event_len = snprintf(event_str, event_len, "{\"url\":\"%s\",\"originalWidth\":%d,\"originalHeight\":%d,\"name\":\"imageSize\",\"priority\":0}", url, width, height);
+    event_str[event_len] = '\0';
+    core_dispatch_event(event_str);
+
+    if (dynamic_str) {
+        free(dynamic_str);
+    }
+}
+
+static void bind_texture_handle(texture_2d *tex) {
+    texture_handle_entry *entry = NULL;
+    HASH_FIND(hh, m_handle_by_url, tex->url, strlen(tex->url), entry);
+
+    if (entry) {
+        tex->handle = entry->handle;
+        m_handle_textures[entry->handle] = tex;
+    }
+}
+
+static void unbind_texture_handle(texture_2d *tex) {
+    if (tex->handle && m_handle_textures[tex->handle] == tex) {
+        m_handle_textures[tex->handle] = NULL;
+    }
+    tex->handle = 0;
+}
+
+static void mark_texture_used(texture_2d *tex) {
+    if (!tex->failed) {
+        time(&tex->last_accessed);
+    }
+
+    // If we haven't accumulated this texture yet,
+    if (tex->frame_epoch != m_frame_epoch) {
+        tex->frame_epoch = m_frame_epoch;
+        m_frame_used_bytes += tex->used_texture_bytes;
+    }
+}
+
+static void count_texture_lookup(texture_2d *tex) {
+    if (tex->loaded) {
+        tex->hits++;
+        m_lookup_hits++;
+    } else {
+        tex->misses++;
+        m_lookup_misses++;
+    }
+}
+
 texture_2d *texture_manager_get_texture(texture_manager *manager, const char *url) {
     LOGFN("texture_manager_get_texture");
     size_t len = strlen(url);
@@ -141,15 +344,7 @@ texture_2d *texture_manager_get_texture(texture_manager *manager, const char *ur
     HASH_FIND(url_hash, manager->url_to_tex, url, len, tex);
 
     if (tex) {
-        if (!tex->failed) {
-            time(&tex->last_accessed);
-        }
-
-        // If we haven't accumulated this texture yet,
-        if (tex->frame_epoch != m_frame_epoch) {
-            tex->frame_epoch = m_frame_epoch;
-            m_frame_used_bytes += tex->used_texture_bytes;
-        }
+        mark_texture_used(tex);
     } else {
         // if it was a canvas
         if (url[0] == '_' && url[1] == '_'
@@ -165,47 +360,97 @@ texture_2d *texture_manager_get_texture(texture_manager *manager, const char *ur
     return tex;
 }
 
-void texture_manager_get_sheet_size(char *url, int *width, int *height) {
-    LOGFN("texture_manager_get_sheet_size");
+/**
+ * @name	texture_manager_load_sheet_index
+ * @brief	loads the spritesheet size map up front so lookups during play are cheap.
+ *			prefers the binary index, converting the JSON map to it in memory if
+ *			the game was built without one
+ * @retval	NONE
+ */
+void texture_manager_load_sheet_index() {
+    LOGFN("texture_manager_load_sheet_index");
+
+    if (m_sheet_index_loaded) {
+        return;
+    }
+    m_sheet_index_loaded = true;
 
-    if (!spritesheet_map_root) {
-        // load map.json
-        char * map_str = resource_loader_string_from_url("spritesheets/spritesheetSizeMap.json");
-        json_error_t error;
-        spritesheet_map_root = json_loads(map_str, 0, &error);
-        free(map_str);
-    }
-
-    if (spritesheet_map_root) {
-        json_t *sheet_obj = json_object_get(spritesheet_map_root, url);
-        if (json_is_object(sheet_obj)) {
-            json_t *width_obj = json_object_get(sheet_obj, "w");
-            json_t *height_obj = json_object_get(sheet_obj, "h");
-            if (json_is_integer(width_obj) && json_is_integer(height_obj)) {
-                *width = (int)json_integer_value(width_obj);
-                *height = (int)json_integer_value(height_obj);
-                return;
+    unsigned long size = 0;
+    unsigned char *data = resource_loader_read_file(SHEET_INDEX_URL, &size);
+    m_sheet_index = sheet_index_load(data, size);
+
+    if (!m_sheet_index) {
+        if (data) {
+            LOG("{tex} WARNING: Ignoring invalid spritesheet index %s", SHEET_INDEX_URL);
+        }
+        free(data);
+
+        char *map_str = resource_loader_string_from_url(SHEET_MAP_URL);
+        if (map_str) {
+            json_error_t error;
+            json_t *root = json_loads(map_str, 0, &error);
+            free(map_str);
+
+            if (root) {
+                data = sheet_index_build_from_json(root, &size);
+                json_decref(root);
+                m_sheet_index = sheet_index_load(data, size);
+                if (!m_sheet_index) {
+                    free(data);
+                }
             }
         }
     }
 
+    TEXLOG("Loaded %d spritesheet sizes", m_sheet_index ? (int)m_sheet_index->count : 0);
+}
+
+void texture_manager_get_sheet_size(char *url, int *width, int *height) {
+    LOGFN("texture_manager_get_sheet_size");
+
+    // Normally loaded at startup
+    if (!m_sheet_index_loaded) {
+        texture_manager_load_sheet_index();
+    }
+
+    if (m_sheet_index && sheet_index_lookup(m_sheet_index, url, width, height)) {
+        return;
+    }
+
     *width = DEFAULT_SHEET_DIMENSION;
     *height = DEFAULT_SHEET_DIMENSION;
 }
 
+static texture_2d *request_texture(texture_manager *manager, const char *url);
+
 texture_2d *texture_manager_load_texture(texture_manager *manager, const char *url) {
     LOGFN("texture_manager_load_texture");
     texture_2d *tex = texture_manager_get_texture(manager, url);
 
     if (tex) {
+        texture_manager_restore_canvas(manager, tex);
+        count_texture_lookup(tex);
         return tex;
     }
 
+    tex = request_texture(manager, url);
+    tex->misses = 1;
+    m_lookup_misses++;
+    return tex;
+}
+
+// Adds a texture for the url and starts loading it
+static texture_2d *request_texture(texture_manager *manager, const char *url) {
     char *permanent_url = strdup(url);
-    tex = texture_2d_new_from_url(permanent_url);
+    texture_2d *tex = texture_2d_new_from_url(permanent_url);
+    tex->load_requested_at = now_ms();
 
     bool remote_resource = is_remote_resource(permanent_url);
     bool is_contact_photo = (strncmp(url, CONTACTPHOTO_URL_PREFIX, CONTACTPHOTO_URL_PREFIX_LEN) == 0);
+    bool is_http = !strncmp("http", url, 4) || !strncmp("//", url, 2);
+
+    // texels kept from an earlier load only need decompressing on the loader thread
+    bool cached = (!remote_resource || is_http) && pixel_cache_contains(permanent_url, get_texel_variant(permanent_url));
 
     if (remote_resource) {
         tex->originalWidth = tex->width = DEFAULT_REMOTE_RESOURCE_SIZE;
@@ -225,8 +470,8 @@ texture_2d *texture_manager_load_texture(texture_manager *manager, const char *u
     // Initialize pixel data to NULL to indicate it is not loaded
 
     // If URL represents a remote resource, or is a special resource
-    if (remote_resource) {
-        if (!strncmp("http", url, 4) || !strncmp("//", url, 2)) {
+    if (remote_resource && !cached) {
+        if (is_http) {
             image_cache_load(url);
         } else {
             launch_remote_texture_load(permanent_url);
@@ -242,40 +487,88 @@ texture_2d *texture_manager_load_texture(texture_manager *manager, const char *u
     return tex;
 }
 
-bool texture_manager_on_texture_loaded(texture_manager *manager,
-                                       const char *url,
-                                       int name,
-                                       int width,
-                                       int height,
-                                       int original_width,
-                                       int original_height,
-                                       int num_channels,
-                                       int scale,
-                                       bool is_text,
-                                       long size,
-                                       int compression_type) {
-    //add the amount of bytes being used by this texture to the amount of texture bytes being used
-    //scale = 1, texture stays at its regular size
-    //scale = 2, texture is being halfsized as is needed for lower memory footprint
-    //scale > 2, not currently used
-    long used = size;
-    // If no texture size was given then compute the number of bytes using the number of channels
-    // and the dimensions of the image
-    if (!used) {
-        used = width * height * num_channels;
+/**
+ * @name	texture_manager_get_handle
+ * @brief	interns a url so it can be drawn without hashing the string every frame.
+ *			the handle stays valid for the lifetime of the manager, across evictions
+ * @param	manager - (texture_manager *) manager that owns the textures
+ * @param	url - (const char *) url of the image
+ * @retval	int - handle for texture_manager_load_texture_by_handle(), never zero
+ */
+int texture_manager_get_handle(texture_manager *manager, const char *url) {
+    LOGFN("texture_manager_get_handle");
+    size_t len = strlen(url);
+    texture_handle_entry *entry = NULL;
+    HASH_FIND(hh, m_handle_by_url, url, len, entry);
+
+    if (entry) {
+        return entry->handle;
     }
-    if (scale > 1) {
-        used /= 4;
+
+    if (m_handle_count == m_handle_max) {
+        m_handle_max = m_handle_max ? m_handle_max * 2 : 256;
+        m_handle_entries = (texture_handle_entry **)realloc(m_handle_entries, m_handle_max * sizeof(texture_handle_entry *));
+        m_handle_textures = (texture_2d **)realloc(m_handle_textures, m_handle_max * sizeof(texture_2d *));
     }
 
-    manager->texture_bytes_used += used;
-    const int epoch = (unsigned)m_frame_epoch & EPOCH_USED_MASK;
-    if (m_epoch_used[epoch] < manager->texture_bytes_used) {
-        m_epoch_used[epoch] = manager->texture_bytes_used;
+    entry = (texture_handle_entry *)malloc(sizeof(texture_handle_entry));
+    entry->url = strdup(url);
+    entry->handle = m_handle_count++;
+    HASH_ADD_KEYPTR(hh, m_handle_by_url, entry->url, len, entry);
+    m_handle_entries[entry->handle] = entry;
+    m_handle_textures[entry->handle] = NULL;
+
+    // Pick up a texture that was loaded by url before being interned
+    texture_2d *tex = NULL;
+    HASH_FIND(url_hash, manager->url_to_tex, url, len, tex);
+    if (tex) {
+        bind_texture_handle(tex);
     }
 
-    TEXLOG("Texture loaded: %s!  TOLOAD=%d USED=%d", url, (int)manager->textures_to_load, (int)manager->texture_bytes_used);
+    return entry->handle;
+}
+
+/**
+ * @name	texture_manager_load_texture_by_handle
+ * @brief	same as texture_manager_load_texture(), but looks the texture up by array index
+ * @param	manager - (texture_manager *) manager that owns the textures
+ * @param	handle - (int) handle from texture_manager_get_handle()
+ * @retval	texture_2d* - the texture, which may still be loading, or NULL for an invalid handle
+ */
+texture_2d *texture_manager_load_texture_by_handle(texture_manager *manager, int handle) {
+    if (handle <= 0 || handle >= m_handle_count) {
+        return NULL;
+    }
 
+    texture_2d *tex = m_handle_textures[handle];
+    if (!tex) {
+        // Not loaded yet or evicted since, this binds the handle again
+        return texture_manager_load_texture(manager, m_handle_entries[handle]->url);
+    }
+
+    mark_texture_used(tex);
+    texture_manager_restore_canvas(manager, tex);
+    count_texture_lookup(tex);
+    return tex;
+}
+
+// Names made outside the manager sample like the textures it makes itself,
+// draws leave the filters and wrapping to whoever made the texture
+static void set_default_sampling(int name) {
+    if (!name) {
+        return;
+    }
+    GLTRACE(glBindTexture(GL_TEXTURE_2D, name));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+}
+
+// Records an upload by texture_manager_tick, which set the sampling itself
+static bool on_texture_uploaded(texture_manager *manager, const char *url, int name, int width, int height,
+                                int original_width, int original_height, int num_channels, int scale, bool is_text,
+                                long size, int compression_type) {
     texture_2d *tex = texture_manager_get_texture(manager, (char *)url);
 
     bool add_texture = false;
@@ -283,34 +576,83 @@ bool texture_manager_on_texture_loaded(texture_manager *manager,
         char *permanent_url = strdup(url);
         tex = texture_2d_new_from_url(permanent_url);
         add_texture = true;
+    } else if (tex->loaded) {
+        // replacing an earlier upload
+        manager->texture_bytes_used -= tex->used_texture_bytes;
+    } else {
+        manager->approx_bytes_to_load -= tex->assumed_texture_bytes;
     }
 
-    tex->used_texture_bytes = used;
-    manager->approx_bytes_to_load -= tex->assumed_texture_bytes;
     tex->name = name;
     tex->original_name = name;
     tex->is_text = is_text;
-    tex->loaded = true;
-    tex->failed = core_check_gl_error();
     tex->width = width;
     tex->height = height;
     tex->scale = scale;
     tex->originalWidth = original_width;
     tex->originalHeight = original_height;
+    tex->num_channels = num_channels;
+    tex->compression_type = compression_type;
 
     if (add_texture) {
         texture_manager_add_texture(manager, tex, false);
+        manager->approx_bytes_to_load -= tex->assumed_texture_bytes;
+    }
+
+    // Count the allocated texture size, falling back on the reported data size
+    // for compressed formats whose block layout is unknown.  A shared GL
+    // texture is charged once, to its shared record
+    long used = 0;
+    if (!tex->shared) {
+        used = texture_2d_get_gpu_bytes(tex);
+        if (!used) {
+            used = size;
+        }
+    }
+
+    tex->used_texture_bytes = used;
+    manager->texture_bytes_used += used;
+    const int epoch = (unsigned)m_frame_epoch & EPOCH_USED_MASK;
+    if (m_epoch_used[epoch] < manager->texture_bytes_used) {
+        m_epoch_used[epoch] = manager->texture_bytes_used;
+    }
+
+    if (tex->load_requested_at > 0) {
+        tex->load_latency_ms = (int)(now_ms() - tex->load_requested_at);
     }
 
+    tex->loaded = true;
+    tex->failed = core_check_gl_error();
+
+    TEXLOG("Texture loaded: %s!  TOLOAD=%d USED=%d", url, (int)manager->textures_to_load, (int)manager->texture_bytes_used);
+
     return tex->failed;
 }
 
+bool texture_manager_on_texture_loaded(texture_manager *manager,
+                                       const char *url,
+                                       int name,
+                                       int width,
+                                       int height,
+                                       int original_width,
+                                       int original_height,
+                                       int num_channels,
+                                       int scale,
+                                       bool is_text,
+                                       long size,
+                                       int compression_type) {
+    set_default_sampling(name);
+    return on_texture_uploaded(manager, url, name, width, height, original_width, original_height, num_channels, scale,
+                               is_text, size, compression_type);
+}
+
 void texture_manager_on_texture_failed_to_load(texture_manager *manager, const char *url) {
     pthread_mutex_lock(&mutex);
     texture_2d *tex = texture_manager_get_texture(manager, url);
-    if (tex) {
+    if (tex && !tex->loaded) {
         tex->loaded = true;
         tex->failed = true;
+        tex->used_texture_bytes = 0;
         manager->approx_bytes_to_load -= tex->assumed_texture_bytes;
     }
     pthread_mutex_unlock(&mutex);
@@ -323,18 +665,18 @@ texture_2d *texture_manager_add_texture(texture_manager *manager, texture_2d *te
 
     if (tex->url) {
         HASH_ADD_KEYPTR(url_hash, manager->url_to_tex, tex->url, strlen(tex->url), tex);
+        bind_texture_handle(tex);
     }
 
     manager->tex_count++;
 
-    // Approximate because it doesn't round up to the next power-of-two, etc
-    long assumed_texture_bytes = tex->width * tex->height * tex->num_channels;
+    long assumed_texture_bytes;
     if (!is_canvas) {
-        if (use_halfsized_textures) {
-            assumed_texture_bytes /= 4;
-        }
+        // Approximate because the channel count is not known until the image is decoded
+        assumed_texture_bytes = texture_2d_estimate_gpu_bytes(tex->width, tex->height, tex->num_channels);
         manager->approx_bytes_to_load += assumed_texture_bytes;
     } else {
+        assumed_texture_bytes = texture_2d_get_gpu_bytes(tex);
         manager->texture_bytes_used += assumed_texture_bytes;
         const int epoch = (unsigned)m_frame_epoch & EPOCH_USED_MASK;
         if (m_epoch_used[epoch] < manager->texture_bytes_used) {
@@ -353,15 +695,21 @@ texture_2d *texture_manager_add_texture_from_image(texture_manager *manager, con
     LOGFN("texture_manager_add_texture_from_image");
     char *permanent_url = strdup(url);
     texture_2d *tex = texture_2d_new_from_image(permanent_url, name, width, height, original_width, original_height);
+    set_default_sampling(name);
     texture_manager_add_texture(manager, tex, false);
     return tex;
 }
 
 texture_2d *texture_manager_add_texture_loaded(texture_manager *manager, texture_2d *tex) {
+    set_default_sampling(tex->name);
     tex->loaded = true;
     HASH_ADD_KEYPTR(url_hash, manager->url_to_tex, tex->url, strlen(tex->url), tex);
+    bind_texture_handle(tex);
     manager->tex_count++;
-    //TODO handle the accounting stuff
+
+    tex->used_texture_bytes = texture_2d_get_gpu_bytes(tex);
+    tex->assumed_texture_bytes = tex->used_texture_bytes;
+    manager->texture_bytes_used += tex->used_texture_bytes;
     return tex;
 }
 
@@ -369,6 +717,50 @@ static time_t last_accessed_compare(texture_2d *a, texture_2d *b) {
     return a->last_accessed - b->last_accessed;
 }
 
+/**
+ * @name	spill_canvas
+ * @brief	moves a canvas out of GL into a compressed spill in memory, so it
+ *			comes back on its next use instead of JS having to redraw it
+ * @param	manager - (texture_manager *) manager that owns the canvas
+ * @param	tex - (texture_2d *) canvas texture
+ * @param	readback_budget - (long *) bytes that may still be read back this tick
+ * @retval	bool - true if the canvas was spilled
+ */
+static bool spill_canvas(texture_manager *manager, texture_2d *tex, long *readback_budget) {
+    // the canvas being drawn to keeps its framebuffer texture
+    if (!tex->name || !tex->ctx || tex->ctx == tealeaf_canvas_get()->active_ctx || *readback_budget <= 0) {
+        return false;
+    }
+
+    *readback_budget -= tex->used_texture_bytes;
+    if (!texture_2d_spill(tex)) {
+        // out of memory for the spill, the canvas stays resident
+        return false;
+    }
+    manager->texture_bytes_used -= tex->used_texture_bytes;
+    tex->used_texture_bytes = 0;
+    TEXLOG("Canvas spilled: %s!  USED=%d", tex->url, (int)manager->texture_bytes_used);
+    return true;
+}
+
+/**
+ * @name	texture_manager_restore_canvas
+ * @brief	brings a spilled canvas back into GL, call before drawing from or to it
+ * @param	manager - (texture_manager *) manager that owns the canvas
+ * @param	tex - (texture_2d *) texture, ignored unless it is a spilled canvas
+ * @retval	NONE
+ */
+void texture_manager_restore_canvas(texture_manager *manager, texture_2d *tex) {
+    if (!tex->is_canvas || tex->name || !tex->spill) {
+        return;
+    }
+
+    texture_2d_reload(tex);
+    tex->used_texture_bytes = texture_2d_get_gpu_bytes(tex);
+    manager->texture_bytes_used += tex->used_texture_bytes;
+    TEXLOG("Canvas restored: %s!  USED=%d", tex->url, (int)manager->texture_bytes_used);
+}
+
 void texture_manager_clear_textures(texture_manager *manager, bool clear_all) {
 
 #if defined(TEXMAN_EXTRA_VERBOSE)
@@ -390,7 +782,9 @@ void texture_manager_clear_textures(texture_manager *manager, bool clear_all) {
      * 2. throw out all textures if clear_all is true, but respect rule 1
      * 3. throw out failed textures, forcing them to reload if needed
      * 4. throw out least-recently-used textures if we exceed our estimated memory limit
+     * 5. canvases over the limit are spilled rather than thrown out, a few per tick
      */
+    long readback_budget = CANVAS_SPILL_BYTES_PER_TICK;
     long adjusted_max_texture_bytes = manager->max_texture_bytes - manager->approx_bytes_to_load;
     HASH_SRT(url_hash, manager->url_to_tex, last_accessed_compare);
     texture_2d *tex = NULL;
@@ -403,7 +797,11 @@ void texture_manager_clear_textures(texture_manager *manager, bool clear_all) {
             should_use_halfsized = true;
         }
 
-        if (tex->loaded && (clear_all || tex->failed || overLimit)) {
+        if (tex->is_canvas && !clear_all && !tex->failed) {
+            if (overLimit) {
+                spill_canvas(manager, tex, &readback_budget);
+            }
+        } else if (tex->loaded && (clear_all || tex->failed || overLimit)) {
             texture_2d *to_be_destroyed = tex;
             texture_manager_free_texture(manager, to_be_destroyed);
         }
@@ -427,35 +825,75 @@ void texture_manager_reload_canvases(texture_manager *manager) {
     texture_2d *tex = NULL;
     texture_2d *tmp = NULL;
     HASH_ITER(url_hash, manager->url_to_tex, tex, tmp) {
-        if (tex->is_canvas) {
+        // spilled canvases come back on their next use
+        if (tex->is_canvas && tex->name) {
             texture_2d_reload(tex);
         }
     }
 };
 
+typedef struct reload_entry_t {
+    char *url;
+    int frame_epoch;
+    time_t last_accessed;
+} reload_entry;
+
+static int reload_entry_compare(const void *a, const void *b) {
+    const reload_entry *x = (const reload_entry *)a;
+    const reload_entry *y = (const reload_entry *)b;
+    if (x->frame_epoch != y->frame_epoch) {
+        return x->frame_epoch > y->frame_epoch ? -1 : 1;
+    }
+    if (x->last_accessed != y->last_accessed) {
+        return x->last_accessed > y->last_accessed ? -1 : 1;
+    }
+    return 0;
+}
+
 void texture_manager_reload(texture_manager *manager) {
-    //TODO automatically reload the textures we clear instead
-    //of just clearing them
     LOG("{tex} Reloading %i textures", manager->tex_count);
 
+    // atlas pages died with the context, their textures are freed below
+    texture_atlas_context_lost();
+
     pthread_mutex_lock(&mutex);
     texture_2d *cur_tex = tex_load_list;
 
-    //remove anything waiting to be loaded from the hash
+    //remove anything waiting to be loaded from the hash, textures already up
+    //or drawing from a shared texture are freed with the rest below
     while (cur_tex) {
-        HASH_DELETE(url_hash, manager->url_to_tex, cur_tex);
+        texture_2d *old_cur = cur_tex;
         LIST_ITERATE(&tex_load_list, cur_tex);
+        if (old_cur->loaded || old_cur->shared) {
+            buffer_pool_release(old_cur->pixel_data);
+            old_cur->pixel_data = NULL;
+            LIST_REMOVE(&tex_load_list, old_cur);
+        } else {
+            HASH_DELETE(url_hash, manager->url_to_tex, old_cur);
+        }
     }
 
     //add offscreen canvases to a canvas list to be reloaded
     //after all the normal textures have been freed
+    //remember what was drawn lately to load it again, the rest loads when drawn
     texture_2d *tex = NULL;
     texture_2d *tmp = NULL;
     texture_2d *canvas_list = NULL;
+    reload_entry *recent = (reload_entry *)malloc(HASH_CNT(url_hash, manager->url_to_tex) * sizeof(reload_entry) + 1);
+    int recent_count = 0;
     HASH_ITER(url_hash, manager->url_to_tex, tex, tmp) {
         if (tex->is_canvas) {
-            LIST_ADD(&canvas_list, tex);
+            if (tex->name) {
+                LIST_ADD(&canvas_list, tex);
+            }
         } else {
+            if (recent && tex->loaded && !tex->failed && m_frame_epoch - tex->frame_epoch <= RELOAD_RECENT_FRAMES &&
+                strncmp(tex->url, "__canvas__", 10)) {
+                recent[recent_count].url = strdup(tex->url);
+                recent[recent_count].frame_epoch = tex->frame_epoch;
+                recent[recent_count].last_accessed = tex->last_accessed;
+                recent_count++;
+            }
             texture_2d *to_be_destroyed = tex;
             texture_manager_free_texture(manager, to_be_destroyed);
         }
@@ -479,6 +917,20 @@ void texture_manager_reload(texture_manager *manager) {
     }
 
     pthread_mutex_unlock(&mutex);
+
+    //queue the recent textures behind them, last drawn first
+    if (recent) {
+        qsort(recent, recent_count, sizeof(reload_entry), reload_entry_compare);
+        int i;
+        for (i = 0; i < recent_count; ++i) {
+            if (!texture_manager_get_texture(manager, recent[i].url)) {
+                request_texture(manager, recent[i].url);
+            }
+            free(recent[i].url);
+        }
+        LOG("{tex} Reloading %i recently drawn textures", recent_count);
+        free(recent);
+    }
 }
 
 /**
@@ -508,17 +960,107 @@ void texture_manager_save(texture_manager *manager) {
     }
 }
 
+/**
+ * @name	share_texture
+ * @brief	offers a freshly uploaded texture to later loads of the same file data
+ * @param	manager - (texture_manager *) manager that owns the texture
+ * @param	tex - (texture_2d *) texture with all its levels uploaded
+ * @retval	NONE
+ */
+static void share_texture(texture_manager *manager, texture_2d *tex) {
+    // atlas slots move around, proxies are replaced soon
+    if (!tex->content_hashed || tex->shared || tex->failed || tex->atlas_page || tex->proxy_shift) {
+        return;
+    }
+
+    shared_texture *shared = NULL;
+    HASH_FIND(hh, m_shared_textures, tex->content_hash, sizeof(tex->content_hash), shared);
+    if (shared) {
+        // loaded alongside another copy before either was up, keep its own
+        return;
+    }
+
+    shared = (shared_texture *)malloc(sizeof(shared_texture));
+    if (!shared) {
+        // the texture just keeps its GL texture to itself
+        return;
+    }
+    memcpy(shared->hash, tex->content_hash, sizeof(shared->hash));
+    shared->name = tex->name;
+    shared->refcount = 1;
+    shared->bytes = tex->used_texture_bytes;
+    shared->width = tex->width;
+    shared->height = tex->height;
+    shared->original_width = tex->originalWidth;
+    shared->original_height = tex->originalHeight;
+    shared->scale = tex->scale;
+    shared->num_channels = tex->num_channels;
+    shared->compression_type = tex->compression_type;
+    shared->pixel_type = tex->pixel_type;
+    shared->num_levels = tex->num_levels;
+    texture_format_copy_opacity(&shared->opacity, &tex->opacity);
+    shared->minified_epoch = tex->minified_epoch;
+    shared->mipmapped = tex->mipmapped;
+    HASH_ADD(hh, m_shared_textures, hash, sizeof(shared->hash), shared);
+
+    tex->shared = shared;
+    tex->used_texture_bytes = 0;
+}
+
+/**
+ * @name	release_shared_texture
+ * @brief	drops a texture's reference to its shared GL texture, uncharging the
+ *			bytes with the last reference
+ * @param	manager - (texture_manager *) manager that owns the texture
+ * @param	tex - (texture_2d *) texture letting go
+ * @retval	bool - true if the caller should delete the GL texture
+ */
+static bool release_shared_texture(texture_manager *manager, texture_2d *tex) {
+    shared_texture *shared = tex->shared;
+    if (!shared) {
+        return true;
+    }
+
+    tex->shared = NULL;
+    if (--shared->refcount > 0) {
+        return false;
+    }
+
+    manager->texture_bytes_used -= shared->bytes;
+    HASH_DEL(m_shared_textures, shared);
+    texture_format_free_opacity(&shared->opacity);
+    free(shared);
+    return true;
+}
+
 void texture_manager_free_texture(texture_manager *manager, texture_2d *tex) {
     LOGFN("texture_manager_free_texture");
 
     if (tex) {
-        //need to subtract off the texture bytes being used as the texture is freed
-        manager->texture_bytes_used -= tex->used_texture_bytes;
+        //need to subtract off the texture bytes being used as the texture is freed,
+        //or the bytes it was expected to use if it never finished loading
+        if (tex->loaded) {
+            manager->texture_bytes_used -= tex->used_texture_bytes;
+        } else {
+            manager->approx_bytes_to_load -= tex->assumed_texture_bytes;
+        }
         HASH_DELETE(url_hash, manager->url_to_tex, tex);
+        unbind_texture_handle(tex);
+
+        // a proxy may still be waiting for its full texels
+        if (LIST_IN_LIST(&tex_load_list, tex)) {
+            LIST_REMOVE(&tex_load_list, tex);
+        }
         manager->tex_count--;
 
-        if (!tex->loaded) {
-            manager->approx_bytes_to_load -= tex->assumed_texture_bytes;
+        // other urls may still draw from the same GL texture
+        if (!release_shared_texture(manager, tex)) {
+            tex->name = 0;
+        }
+
+        // evicted texels are the ones most likely to be loaded again
+        if (tex->loaded && tex->url) {
+            pixel_cache_touch(tex->url);
         }
 
         TEXLOG("Texture freed: %s!  COUNT=%d, USED=%d", tex->url, (int)manager->tex_count, (int)manager->texture_bytes_used);
@@ -548,10 +1090,21 @@ void texture_manager_background_texture_loader(void *dummy) {
                     notify_canvas_death(url);
                     pthread_mutex_lock(&mutex);
                     old_cur = cur_tex;
-                } else if (cur_tex->pixel_data == NULL && !cur_tex->failed) {
-                    LOG("Passing to load_image_with_c: %s", url);
-                    if (!resource_loader_load_image_with_c(cur_tex)) {
+                } else if (cur_tex->pixel_data == NULL && !cur_tex->failed && !cur_tex->shared) {
+                    if (pixel_cache_take(cur_tex, get_texel_variant(url))) {
+                        TEXLOG("Loaded from the pixel cache: %s", url);
+                        if (!cur_tex->loaded) {
+                            cur_tex->used_texture_bytes = texture_2d_get_gpu_bytes(cur_tex);
+                        }
+                    } else if (is_remote_resource(url)) {
+                        // dropped from the pixel cache since it was requested
+                        image_cache_load(url);
                         old_cur = cur_tex;
+                    } else {
+                        LOG("Passing to load_image_with_c: %s", url);
+                        if (!resource_loader_load_image_with_c(cur_tex)) {
+                            old_cur = cur_tex;
+                        }
                     }
                 }
             }
@@ -572,40 +1125,508 @@ void texture_manager_background_texture_loader(void *dummy) {
 }
 
 CEXPORT void image_cache_load_callback(struct image_data *data) {
-    int num_channels, width, height, originalWidth, originalHeight, scale, compression_type;
-    long size;
-    unsigned char *bytes  = texture_2d_load_texture_raw(data->url, data->bytes, data->size, &num_channels, &width, &height, &originalWidth, &originalHeight, &scale, &size, &compression_type);
+    int num_channels, width, height, originalWidth, originalHeight, scale, proxy_shift;
+    texture_2d_load_result decoded;
+    texture_manager *manager = texture_manager_get();
+
+    // The same file under another url, copied or with another query string,
+    // draws from the GL texture already made from it.  The format policy and
+    // level of detail are part of the key since they change the texture made
+    // from the same data
+    unsigned int content_hash[4];
+    MurmurHash3_x86_128(data->bytes, (int)data->size, get_texel_variant(data->url), content_hash);
+
+    pthread_mutex_lock(&mutex);
+    texture_2d *tex = texture_manager_get_texture(manager, data->url);
+    shared_texture *shared = NULL;
+    if (tex != NULL && !tex->loaded && !LIST_IN_LIST(&tex_load_list, tex)) {
+        HASH_FIND(hh, m_shared_textures, content_hash, sizeof(content_hash), shared);
+    }
+    if (shared) {
+        TEXLOG("image_cache_background_loader sharing %s", data->url);
+        tex->num_channels = shared->num_channels;
+        tex->width = shared->width;
+        tex->height = shared->height;
+        tex->originalWidth = shared->original_width;
+        tex->originalHeight = shared->original_height;
+        tex->scale = shared->scale;
+        tex->failed = false;
+        tex->compression_type = shared->compression_type;
+        tex->pixel_type = shared->pixel_type;
+        tex->num_levels = shared->num_levels;
+        texture_format_free_opacity(&tex->pending_opacity);
+        texture_format_copy_opacity(&tex->pending_opacity, &shared->opacity);
+        memcpy(tex->content_hash, content_hash, sizeof(content_hash));
+        tex->content_hashed = true;
+        tex->shared = shared;
+        shared->refcount++;
+        LIST_ADD(&tex_load_list, tex);
+        pthread_mutex_unlock(&mutex);
+        return;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    // Budget for the image from its header while it decodes
+    texture_manager_probe_image(data->url, data->bytes, data->size);
+
+    // Large images draw a reduced proxy until the full decode below is done
+    unsigned char *proxy = texture_2d_load_texture_proxy(data->bytes, data->size, &num_channels, &width, &height, &originalWidth, &originalHeight, &scale, &proxy_shift);
+    if (proxy) {
+        pthread_mutex_lock(&mutex);
+        tex = texture_manager_get_texture(manager, data->url);
+        if (tex != NULL && !tex->loaded && !LIST_IN_LIST(&tex_load_list, tex)) {
+            tex->num_channels = num_channels;
+            tex->width = width;
+            tex->height = height;
+            tex->originalWidth = originalWidth;
+            tex->originalHeight = originalHeight;
+            tex->scale = scale;
+            tex->failed = false;
+            tex->pixel_data = proxy;
+            tex->compression_type = 0;
+            tex->pixel_type = 0;
+            tex->num_levels = 1;
+            tex->proxy_shift = proxy_shift;
+            tex->uploaded_levels = 0;
+            texture_format_free_opacity(&tex->pending_opacity);
+            tex->used_texture_bytes = texture_2d_get_gpu_bytes(tex);
+            LIST_ADD(&tex_load_list, tex);
+        } else {
+            free(proxy);
+        }
+        pthread_mutex_unlock(&mutex);
+    }
+
+    unsigned char *bytes  = texture_2d_load_texture_raw(data->url, data->bytes, data->size, &decoded);
     bool failed = (bytes == NULL);
 
     TEXLOG("image_cache_background_loader loaded %s, status: %i", data->url, failed);
 
-    texture_manager *manager = texture_manager_get();
-
     pthread_mutex_lock(&mutex);
-    texture_2d *tex = texture_manager_get_texture(manager, data->url);
-    if (tex != NULL) {
-        tex->num_channels = num_channels;
-        tex->width = width;
-        tex->height = height;
-        tex->originalWidth = originalWidth;
-        tex->originalHeight = originalHeight;
-        tex->scale = scale;
+    tex = texture_manager_get_texture(manager, data->url);
+    if (tex != NULL && failed && tex->proxy_shift) {
+        // the proxy is all there is, keep it
+        LOG("{tex} WARNING: Keeping the proxy of %s, the full image failed to load", data->url);
+    } else if (tex != NULL) {
+        // a proxy that has not been uploaded yet is simply replaced
+        bool queued = LIST_IN_LIST(&tex_load_list, tex);
+        buffer_pool_release(tex->pixel_data);
+
+        tex->num_channels = decoded.channels;
+        tex->width = decoded.width;
+        tex->height = decoded.height;
+        tex->originalWidth = decoded.originalWidth;
+        tex->originalHeight = decoded.originalHeight;
+        tex->scale = decoded.scale;
         tex->failed = failed;
         tex->pixel_data = bytes;
-        tex->compression_type = compression_type;
-        tex->used_texture_bytes = size;
-        LIST_ADD(&tex_load_list, tex);
+        tex->compression_type = decoded.compression_type;
+        tex->pixel_type = decoded.pixel_type;
+        tex->num_levels = decoded.levels;
+        tex->proxy_shift = 0;
+        tex->uploaded_levels = 0;
+        texture_format_free_opacity(&tex->pending_opacity);
+        tex->pending_opacity = decoded.opacity;
+        decoded.opacity.cells = NULL;
+        memcpy(tex->content_hash, content_hash, sizeof(content_hash));
+        tex->content_hashed = !failed;
+        if (!tex->loaded) {
+            // loaded textures keep counting their current upload until texture_manager_tick replaces it
+            tex->used_texture_bytes = decoded.size;
+        }
+        if (!queued) {
+            LIST_ADD(&tex_load_list, tex);
+        }
     }
+    texture_format_free_opacity(&decoded.opacity);
 
     pthread_mutex_unlock(&mutex);
 }
 
+/**
+ * @name	texture_manager_set_generate_mipmaps
+ * @brief	turns generated mip levels for decoded images on or off; off by default as
+ *			the levels take a third more texture memory. The platform layer calls this
+ *			at startup, like texture_manager_set_use_halfsized_textures
+ * @param	generate - (bool) whether images loaded from now on get mip levels
+ * @retval	NONE
+ */
+void texture_manager_set_generate_mipmaps(bool generate) {
+    if (generate_mipmaps != generate) {
+        LOG("{tex} generate_mipmaps=%d", generate);
+        generate_mipmaps = generate;
+    }
+}
+
+/**
+ * @name	texture_manager_mark_minified
+ * @brief	notes that a texture was drawn below half scale this frame, which
+ *			makes texture_manager_tick switch it to its mip levels
+ * @param	tex - (texture_2d *) texture drawn
+ * @retval	NONE
+ */
+void texture_manager_mark_minified(texture_2d *tex) {
+    tex->minified_epoch = m_frame_epoch;
+    if (tex->shared) {
+        tex->shared->minified_epoch = m_frame_epoch;
+    }
+}
+
+/**
+ * @name	texture_manager_mark_drawn
+ * @brief	notes the scale a texture was drawn at, which picks its level of detail
+ * @param	tex - (texture_2d *) texture drawn
+ * @param	scale2 - (float) squared screen pixels per image pixel along the
+ *			axis drawn largest
+ * @retval	NONE
+ */
+void texture_manager_mark_drawn(texture_2d *tex, float scale2) {
+    if (scale2 > tex->draw_scale2) {
+        tex->draw_scale2 = scale2;
+    }
+}
+
+/**
+ * @name	texture_manager_probe_image
+ * @brief	reads the size of an image from its file header before it is decoded,
+ *			the next tick budgets for it and reports the size to JS with an
+ *			imageSize event.  Safe to call from decode threads
+ * @param	url - (const char *) url of the image, may be NULL
+ * @param	data - (const void *) PNG, JPEG or PKM file data
+ * @param	sz - (unsigned long) size of the data
+ * @retval	NONE
+ */
+void texture_manager_probe_image(const char *url, const void *data, unsigned long sz) {
+    int width, height, num_channels;
+    if (!url || !probe_image_from_memory((const unsigned char *)data, (long)sz, &width, &height, &num_channels)) {
+        return;
+    }
+
+    probed_size *entry = NULL;
+    pthread_mutex_lock(&m_probe_mutex);
+    HASH_FIND(hh, m_probed_sizes, url, strlen(url), entry);
+    if (!entry) {
+        entry = (probed_size *)malloc(sizeof(probed_size));
+        entry->url = strdup(url);
+        HASH_ADD_KEYPTR(hh, m_probed_sizes, entry->url, strlen(entry->url), entry);
+    }
+    entry->width = width;
+    entry->height = height;
+    entry->num_channels = num_channels;
+    pthread_mutex_unlock(&m_probe_mutex);
+}
+
+// Replaces the guessed size of textures still waiting for their decode with
+// the probed one, so the memory limit counts them before they arrive
+static void apply_probed_sizes(texture_manager *manager) {
+    pthread_mutex_lock(&m_probe_mutex);
+    probed_size *probed = m_probed_sizes;
+    m_probed_sizes = NULL;
+    pthread_mutex_unlock(&m_probe_mutex);
+
+    probed_size *entry = NULL;
+    probed_size *tmp = NULL;
+    HASH_ITER(hh, probed, entry, tmp) {
+        bool resized = false;
+
+        pthread_mutex_lock(&mutex);
+        texture_2d *tex = NULL;
+        HASH_FIND(url_hash, manager->url_to_tex, entry->url, strlen(entry->url), tex);
+        if (tex && !tex->loaded && !tex->pixel_data) {
+            resized = tex->originalWidth != entry->width || tex->originalHeight != entry->height;
+            if (resized || tex->num_channels != entry->num_channels) {
+                manager->approx_bytes_to_load -= tex->assumed_texture_bytes;
+                tex->originalWidth = tex->width = entry->width;
+                tex->originalHeight = tex->height = entry->height;
+                tex->num_channels = entry->num_channels;
+                tex->assumed_texture_bytes = texture_2d_estimate_gpu_bytes(tex->width, tex->height, tex->num_channels);
+                manager->approx_bytes_to_load += tex->assumed_texture_bytes;
+            }
+        }
+        pthread_mutex_unlock(&mutex);
+
+        if (resized) {
+            TEXLOG("Probed %s at %dx%d", entry->url, entry->width, entry->height);
+            notify_image_size(entry->url, entry->width, entry->height);
+        }
+
+        HASH_DEL(probed, entry);
+        free(entry->url);
+        free(entry);
+    }
+}
+
+/**
+ * @name	texture_manager_get_lod_scale
+ * @brief	gets the scale an image loads at, safe to call from decode threads
+ * @param	url - (const char *) url of the image, may be NULL
+ * @retval	int - 1, 2 or 4, at least 2 when use_halfsized_textures is set
+ */
+int texture_manager_get_lod_scale(const char *url) {
+    int scale = 1;
+    if (url) {
+        lod_entry *entry = NULL;
+        pthread_mutex_lock(&m_lod_mutex);
+        HASH_FIND(hh, m_lod_scales, url, strlen(url), entry);
+        if (entry) {
+            scale = entry->scale;
+        }
+        pthread_mutex_unlock(&m_lod_mutex);
+    }
+    return use_halfsized_textures && scale < 2 ? 2 : scale;
+}
+
+static void set_lod_scale(const char *url, int scale) {
+    lod_entry *entry = NULL;
+    pthread_mutex_lock(&m_lod_mutex);
+    HASH_FIND(hh, m_lod_scales, url, strlen(url), entry);
+    if (scale <= 1) {
+        if (entry) {
+            HASH_DEL(m_lod_scales, entry);
+            free(entry->url);
+            free(entry);
+        }
+    } else {
+        if (!entry) {
+            entry = (lod_entry *)malloc(sizeof(lod_entry));
+            entry->url = strdup(url);
+            HASH_ADD_KEYPTR(hh, m_lod_scales, entry->url, strlen(entry->url), entry);
+        }
+        entry->scale = scale;
+    }
+    pthread_mutex_unlock(&m_lod_mutex);
+}
+
+// Largest scale that still gives every screen pixel a texel, dropping
+// texels needs a margin so textures drawn near a boundary do not flip
+static int get_wanted_scale(float draw_scale2, int current) {
+    int scale = 1;
+    while (scale < TEXTURE_MAX_SCALE) {
+        const int next = scale << 1;
+        const float limit = next > current ? LOD_DROP_LIMIT2 : 1.0f;
+        if (draw_scale2 * next * next > limit) {
+            break;
+        }
+        scale = next;
+    }
+    return scale;
+}
+
+// Decodes a loaded texture again at another scale, it keeps drawing until
+// texture_manager_tick swaps in the new texels.  Call with the mutex held
+static bool reload_texture_lod(texture_2d *tex, int scale) {
+    const char *url = tex->url;
+    set_lod_scale(url, scale);
+
+    if (!strncmp("http", url, 4) || !strncmp("//", url, 2)) {
+        return image_cache_reload(url);
+    } else if (!is_remote_resource(url)) {
+        buffer_pool_release(tex->pixel_data);
+        tex->pixel_data = NULL;
+        LIST_ADD(&tex_load_list, tex);
+        pthread_cond_signal(&cond_var);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @name	update_texture_lods
+ * @brief	reloads textures at the level of detail they are drawn at, every
+ *			LOD_WINDOW_FRAMES frames.  More texels are loaded as soon as a
+ *			texture is drawn larger, fewer only after LOD_DROP_WINDOWS windows
+ *			in a row drawn small
+ * @param	manager - (texture_manager *) manager that owns the textures
+ * @retval	NONE
+ */
+static void update_texture_lods(texture_manager *manager) {
+    if (!m_lod_dirty && (m_frame_epoch % LOD_WINDOW_FRAMES)) {
+        return;
+    }
+
+    const bool floor_changed = m_lod_dirty;
+    const int floor = use_halfsized_textures ? 2 : 1;
+    int reloads = 0;
+    m_lod_dirty = false;
+
+    texture_2d *tex = NULL;
+    texture_2d *tmp = NULL;
+    HASH_ITER(url_hash, manager->url_to_tex, tex, tmp) {
+        const float draw_scale2 = tex->draw_scale2;
+        tex->draw_scale2 = 0;
+
+        // compressed textures only drop levels from their file as they load
+        if (!tex->loaded || tex->failed || tex->is_canvas || tex->is_text || tex->atlas_page || tex->proxy_shift ||
+            tex->compression_type || LIST_IN_LIST(&tex_load_list, tex) || !strncmp(tex->url, "__canvas__", 10)) {
+            continue;
+        }
+
+        if (draw_scale2 <= 0) {
+            // not drawn lately, load it at the new floor when it is drawn again
+            if (floor_changed && tex->scale < texture_2d_clamp_scale(floor, tex->originalWidth, tex->originalHeight)) {
+                texture_manager_free_texture(manager, tex);
+            }
+            continue;
+        }
+
+        int wanted = get_wanted_scale(draw_scale2, tex->scale);
+        wanted = texture_2d_clamp_scale(wanted < floor ? floor : wanted, tex->originalWidth, tex->originalHeight);
+        if (wanted > tex->scale && !floor_changed && ++tex->lod_low_windows < LOD_DROP_WINDOWS) {
+            continue;
+        }
+        tex->lod_low_windows = 0;
+
+        if (wanted != tex->scale && reloads < LOD_RELOADS_PER_TICK && reload_texture_lod(tex, wanted)) {
+            TEXLOG("Texture level of detail: %s, scale %d -> %d", tex->url, tex->scale, wanted);
+            reloads++;
+        }
+    }
+}
+
 void texture_manager_set_use_halfsized_textures(bool use_halfsized) {
     if (use_halfsized_textures != use_halfsized) {
         LOG("{tex} use_halfsized_textures=%d", use_halfsized);
         use_halfsized_textures = use_halfsized;
-        texture_manager_clear_textures(m_instance, true);
+
+        // textures move to the new floor one by one, see update_texture_lods(),
+        // except when texture_manager_tick runs out of memory and clears them all
+        m_lod_dirty = true;
+    }
+}
+
+static texture_usage *get_usage_category(texture_manager_stats *stats, texture_2d *tex) {
+    if (!tex->loaded) {
+        return &stats->loading;
+    } else if (tex->is_canvas) {
+        return &stats->canvases;
+    } else if (tex->is_text) {
+        return &stats->text;
+    }
+    return &stats->images;
+}
+
+static const char *get_usage_category_name(texture_2d *tex) {
+    if (!tex->loaded) {
+        return "loading";
+    } else if (tex->failed) {
+        return "failed";
+    } else if (tex->is_canvas) {
+        return "canvas";
+    } else if (tex->is_text) {
+        return "text";
+    }
+    return "image";
+}
+
+static void collect_stats(texture_manager *manager, texture_manager_stats *stats) {
+    memset(stats, 0, sizeof(texture_manager_stats));
+    stats->max_texture_bytes = manager->max_texture_bytes;
+    stats->hits = m_lookup_hits;
+    stats->misses = m_lookup_misses;
+    stats->frame_epoch = m_frame_epoch;
+
+    texture_2d *tex = NULL;
+    texture_2d *tmp = NULL;
+    HASH_ITER(url_hash, manager->url_to_tex, tex, tmp) {
+        if (tex->loaded && tex->failed) {
+            stats->failed_count++;
+            continue;
+        }
+
+        texture_usage *usage = get_usage_category(stats, tex);
+        usage->count++;
+        usage->bytes += tex->loaded ? tex->used_texture_bytes : tex->assumed_texture_bytes;
+    }
+}
+
+static json_t *usage_to_json(texture_usage *usage) {
+    json_t *obj = json_object();
+    json_object_set_new(obj, "count", json_integer(usage->count));
+    json_object_set_new(obj, "bytes", json_integer(usage->bytes));
+    return obj;
+}
+
+/**
+ * @name	texture_manager_get_stats
+ * @brief	totals the textures currently known to the manager by category
+ * @param	manager - (texture_manager *) manager to inspect
+ * @param	stats - (texture_manager_stats *) out: filled with the totals
+ * @retval	NONE
+ */
+void texture_manager_get_stats(texture_manager *manager, texture_manager_stats *stats) {
+    pthread_mutex_lock(&mutex);
+    collect_stats(manager, stats);
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * @name	texture_manager_dump_residency
+ * @brief	describes every texture known to the manager along with totals, for
+ *			tuning the memory limits of a device
+ * @param	manager - (texture_manager *) manager to inspect
+ * @retval	char* - JSON string which must be freed by the caller, or NULL on failure
+ */
+char *texture_manager_dump_residency(texture_manager *manager) {
+    texture_manager_stats stats;
+    json_t *root = json_object();
+    json_t *textures = json_array();
+
+    pthread_mutex_lock(&mutex);
+    collect_stats(manager, &stats);
+
+    texture_2d *tex = NULL;
+    texture_2d *tmp = NULL;
+    HASH_ITER(url_hash, manager->url_to_tex, tex, tmp) {
+        json_t *obj = json_object();
+        json_object_set_new(obj, "url", json_string(tex->url ? tex->url : ""));
+        json_object_set_new(obj, "category", json_string(get_usage_category_name(tex)));
+        json_object_set_new(obj, "bytes", json_integer(tex->loaded ? tex->used_texture_bytes : tex->assumed_texture_bytes));
+        json_object_set_new(obj, "width", json_integer(tex->width));
+        json_object_set_new(obj, "height", json_integer(tex->height));
+        json_object_set_new(obj, "originalWidth", json_integer(tex->originalWidth));
+        json_object_set_new(obj, "originalHeight", json_integer(tex->originalHeight));
+        json_object_set_new(obj, "scale", json_integer(tex->scale));
+        json_object_set_new(obj, "channels", json_integer(tex->num_channels));
+        json_object_set_new(obj, "pixelType", json_integer(tex->pixel_type));
+        json_object_set_new(obj, "compression", json_integer(tex->compression_type));
+        json_object_set_new(obj, "levels", json_integer(tex->num_levels));
+        json_object_set_new(obj, "proxyShift", json_integer(tex->proxy_shift));
+        json_object_set_new(obj, "mipmapped", json_boolean(tex->mipmapped));
+        json_object_set_new(obj, "shared", json_integer(tex->shared ? tex->shared->refcount : 0));
+        json_object_set_new(obj, "drawScale", json_real(sqrtf(tex->draw_scale2)));
+        json_object_set_new(obj, "atlas", json_boolean(tex->atlas_page != NULL));
+        json_object_set_new(obj, "spilledBytes", json_integer(canvas_spill_get_bytes(tex->spill)));
+        json_object_set_new(obj, "lastUsedFrame", json_integer(tex->frame_epoch));
+        json_object_set_new(obj, "lastAccessed", json_integer((json_int_t)tex->last_accessed));
+        json_object_set_new(obj, "loadLatencyMs", json_integer(tex->load_latency_ms));
+        json_object_set_new(obj, "hits", json_integer(tex->hits));
+        json_object_set_new(obj, "misses", json_integer(tex->misses));
+        json_array_append_new(textures, obj);
     }
+
+    json_object_set_new(root, "frame", json_integer(m_frame_epoch));
+    json_object_set_new(root, "usedBytes", json_integer(manager->texture_bytes_used));
+    json_object_set_new(root, "loadingBytes", json_integer(manager->approx_bytes_to_load));
+    json_object_set_new(root, "maxBytes", json_integer(manager->max_texture_bytes));
+    json_object_set_new(root, "frameUsedBytes", json_integer(m_frame_used_bytes));
+    json_object_set_new(root, "highWaterBytes", json_integer(get_epoch_used_max()));
+    pthread_mutex_unlock(&mutex);
+
+    json_object_set_new(root, "pixelCacheBytes", json_integer(pixel_cache_get_bytes()));
+    json_object_set_new(root, "bufferPoolBytes", json_integer(buffer_pool_get_bytes()));
+
+    json_object_set_new(root, "hits", json_integer(stats.hits));
+    json_object_set_new(root, "misses", json_integer(stats.misses));
+    json_object_set_new(root, "failed", json_integer(stats.failed_count));
+    json_object_set_new(root, "images", usage_to_json(&stats.images));
+    json_object_set_new(root, "canvases", usage_to_json(&stats.canvases));
+    json_object_set_new(root, "text", usage_to_json(&stats.text));
+    json_object_set_new(root, "loading", usage_to_json(&stats.loading));
+    json_object_set_new(root, "textures", textures);
+
+    char *dump = json_dumps(root, JSON_COMPACT);
+    json_decref(root);
+    return dump;
 }
 
 texture_manager *texture_manager_acquire() {
@@ -672,6 +1693,50 @@ void texture_manager_destroy(texture_manager *manager) {
     }
     HASH_CLEAR(url_hash, manager->url_to_tex);
     free(manager);
+    pixel_cache_clear();
+    canvas_spill_shutdown();
+    buffer_pool_trim();
+
+    shared_texture *shared = NULL;
+    shared_texture *tmp_shared = NULL;
+    HASH_ITER(hh, m_shared_textures, shared, tmp_shared) {
+        HASH_DEL(m_shared_textures, shared);
+        texture_format_free_opacity(&shared->opacity);
+        free(shared);
+    }
+
+    lod_entry *lod = NULL;
+    lod_entry *tmp_lod = NULL;
+    HASH_ITER(hh, m_lod_scales, lod, tmp_lod) {
+        HASH_DEL(m_lod_scales, lod);
+        free(lod->url);
+        free(lod);
+    }
+
+    probed_size *probed = NULL;
+    probed_size *tmp_probed = NULL;
+    pthread_mutex_lock(&m_probe_mutex);
+    HASH_ITER(hh, m_probed_sizes, probed, tmp_probed) {
+        HASH_DEL(m_probed_sizes, probed);
+        free(probed->url);
+        free(probed);
+    }
+    pthread_mutex_unlock(&m_probe_mutex);
+
+    // Forget interned urls
+    texture_handle_entry *entry = NULL;
+    texture_handle_entry *tmp_entry = NULL;
+    HASH_ITER(hh, m_handle_by_url, entry, tmp_entry) {
+        HASH_DEL(m_handle_by_url, entry);
+        free(entry->url);
+        free(entry);
+    }
+    free(m_handle_entries);
+    free(m_handle_textures);
+    m_handle_entries = NULL;
+    m_handle_textures = NULL;
+    m_handle_count = 1;
+    m_handle_max = 0;
     // Clear the texture load list
     tex_load_list = NULL;
 
@@ -685,6 +1750,13 @@ void texture_manager_destroy(texture_manager *manager) {
     m_memory_warning = false;
     m_frame_epoch = 1;
     m_frame_used_bytes = 0;
+    m_atlas_unused_bytes = 0;
+    m_lookup_hits = 0;
+    m_lookup_misses = 0;
+
+    sheet_index_destroy(m_sheet_index);
+    m_sheet_index = NULL;
+    m_sheet_index_loaded = false;
 }
 
 void texture_manager_touch_texture(texture_manager *manager, const char *url) {
@@ -727,13 +1799,88 @@ static long get_epoch_used_max() {
     return highest;
 }
 
+// Uploads one level of pixel_data to the bound texture, width and height are those of the base level
+static long upload_texture_level(texture_2d *tex, int level, int width, int height) {
+    const int bytes_per_texel = texture_format_bytes_per_texel(tex->num_channels, tex->pixel_type);
+    const unsigned char *level_data = tex->pixel_data + texture_2d_gpu_bytes(width, height, bytes_per_texel, tex->compression_type, level);
+    int level_width = width >> level ? width >> level : 1;
+    int level_height = height >> level ? height >> level : 1;
+
+    if (tex->compression_type) {
+        long level_bytes = (long)compressed_texture_get_size(tex->compression_type, level_width, level_height);
+        if (!level_bytes) {
+            // unknown block layout, a single level is the whole file payload
+            level_bytes = tex->used_texture_bytes;
+        }
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, tex->compression_type, level_width, level_height, 0, level_bytes, level_data);
+        return level_bytes;
+    } else {
+        // select the right internal and input format based on the number of channels
+        GLint format;
+        switch (tex->num_channels) {
+        case 1:
+            format = GL_LUMINANCE;
+            break;
+        case 3:
+            format = GL_RGB;
+            break;
+        default:
+        case 4:
+            format = GL_RGBA;
+            break;
+        }
+        // 16-bit textures keep the format and pack the channels into one type
+        GLenum type = tex->pixel_type ? tex->pixel_type : GL_UNSIGNED_BYTE;
+        // tightly sized rows are not always 4-byte aligned
+        bool unaligned = ((level_width * bytes_per_texel) & 3) != 0;
+        if (unaligned) {
+            GLTRACE(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+        }
+        GLTRACE(glTexImage2D(GL_TEXTURE_2D, level, format, level_width, level_height, 0, format, type, level_data));
+        if (unaligned) {
+            GLTRACE(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+        }
+        return (long)level_width * level_height * bytes_per_texel;
+    }
+}
+
+// Switches textures with all their mip levels up between sampling the base
+// level and the mip levels, going by how they were drawn last frame
+static void update_mipmap_filters(texture_manager *manager) {
+    texture_2d *tex = NULL;
+    texture_2d *tmp = NULL;
+    HASH_ITER(url_hash, manager->url_to_tex, tex, tmp) {
+        if (tex->num_levels < 2 || tex->uploaded_levels != tex->num_levels || !tex->loaded || tex->failed ||
+            tex->atlas_page || tex->frame_epoch != m_frame_epoch) {
+            continue;
+        }
+
+        // textures sharing a GL texture go by the smallest draw of any of them
+        bool *mipmapped = tex->shared ? &tex->shared->mipmapped : &tex->mipmapped;
+        bool minified = (tex->shared ? tex->shared->minified_epoch : tex->minified_epoch) == m_frame_epoch;
+        if (minified != *mipmapped) {
+            *mipmapped = minified;
+            GLTRACE(glBindTexture(GL_TEXTURE_2D, tex->name));
+            GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minified ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR));
+        }
+        tex->mipmapped = minified;
+    }
+}
+
 void texture_manager_tick(texture_manager *manager) {
     LOGFN("texture_manager_tick");
+    apply_probed_sizes(manager);
     pthread_mutex_lock(&mutex);
 
     if (should_use_halfsized) {
         should_use_halfsized = false;
         set_halfsized_textures(true);
+
+        // out of memory, so every texture goes now rather than one by one
+        // through update_texture_lods() and reloads at half size
+        if (use_halfsized_textures) {
+            texture_manager_clear_textures(manager, true);
+        }
     }
 
     // move our estimated max memory limit up or down if necessary
@@ -753,6 +1900,11 @@ void texture_manager_tick(texture_manager *manager) {
 
         // zero the epoch used bins
         memset(m_epoch_used, 0, sizeof(m_epoch_used));
+
+        // texels kept for eviction and idle decode buffers are the cheapest
+        // memory to give back
+        pixel_cache_clear();
+        buffer_pool_trim();
     } else if ((highest > manager->max_texture_bytes || overLimit) && !m_memory_critical) {
         // increase the max texture bytes limit
         long new_max_bytes = MEMORY_GAIN_RATE * (double)manager->max_texture_bytes;
@@ -766,6 +1918,20 @@ void texture_manager_tick(texture_manager *manager) {
     // clear uneeded textures and make space for ones about to be loaded
     texture_manager_clear_textures(manager, false);
 
+    // move survivors out of mostly evicted atlas pages so they can be released
+    texture_atlas_tick();
+
+    // whole pages stay allocated while any item lives, charge what items do not
+    long atlas_unused = texture_atlas_get_unused_bytes();
+    manager->texture_bytes_used += atlas_unused - m_atlas_unused_bytes;
+    m_atlas_unused_bytes = atlas_unused;
+
+    // sample mip levels only for textures drawn minified last frame
+    update_mipmap_filters(manager);
+
+    // reload textures drawn at another size than they were loaded at
+    update_texture_lods(manager);
+
     // invalidate earlier frame epochs tagged on textures
     m_frame_epoch++;
     m_frame_used_bytes = 0;
@@ -774,54 +1940,106 @@ void texture_manager_tick(texture_manager *manager) {
     const int epoch = (unsigned)m_frame_epoch & EPOCH_USED_MASK;
     m_epoch_used[epoch] = manager->texture_bytes_used;
 
-    // load new textures
+    // load new textures, spreading large batches like a reload over a few ticks
     texture_2d *cur_tex = tex_load_list;
     bool glErrorFound = false;
-    while (cur_tex && !glErrorFound) {
-        // skip this if texture is not ready to load
-        if (!cur_tex->failed && (cur_tex->pixel_data == NULL || cur_tex->url == NULL)) {
+    long upload_bytes = 0;
+    while (cur_tex && !glErrorFound && upload_bytes < TEXTURE_UPLOAD_BYTES_PER_TICK) {
+        // skip this if texture is not ready to load, sharers have no texels of their own
+        const bool is_sharing = cur_tex->shared && !cur_tex->loaded;
+        if (!cur_tex->failed && !is_sharing && (cur_tex->pixel_data == NULL || cur_tex->url == NULL)) {
+            LIST_ITERATE(&tex_load_list, cur_tex);
+            continue;
+        }
+
+        // generated mip levels go up one per tick after the base level
+        if (cur_tex->loaded && cur_tex->uploaded_levels > 0 && cur_tex->uploaded_levels < cur_tex->num_levels) {
+            GLTRACE(glBindTexture(GL_TEXTURE_2D, cur_tex->name));
+            upload_bytes += upload_texture_level(cur_tex, cur_tex->uploaded_levels++,
+                                                 cur_tex->width >> TEXTURE_SCALE_SHIFT(cur_tex->scale), cur_tex->height >> TEXTURE_SCALE_SHIFT(cur_tex->scale));
+
+            texture_2d *old_cur = cur_tex;
+            LIST_ITERATE(&tex_load_list, cur_tex);
+            if (old_cur->uploaded_levels == old_cur->num_levels) {
+                release_texels(old_cur);
+                LIST_REMOVE(&tex_load_list, old_cur);
+                share_texture(manager, old_cur);
+            }
+            continue;
+        }
+
+        // other loaded textures in the list are proxies waiting for their full texels
+        const bool is_refinement = cur_tex->loaded && !cur_tex->failed;
+        if (is_refinement && (m_memory_critical || manager->texture_bytes_used - cur_tex->used_texture_bytes +
+                              texture_2d_get_gpu_bytes(cur_tex) > manager->max_texture_bytes)) {
+            // keep drawing the proxy until there is room
             LIST_ITERATE(&tex_load_list, cur_tex);
             continue;
         }
 
         GLuint texture = 0;
-        if (!cur_tex->failed) {
+        if (is_sharing) {
+            // the bytes stay charged once, to the shared record
+            texture = cur_tex->shared->name;
+            cur_tex->uploaded_levels = cur_tex->num_levels;
+            cur_tex->mipmapped = false;
+            glErrorFound = on_texture_uploaded(manager, cur_tex->url, texture, cur_tex->width, cur_tex->height,
+                cur_tex->originalWidth, cur_tex->originalHeight, cur_tex->num_channels, cur_tex->scale, cur_tex->is_text,
+                0, cur_tex->compression_type);
+        } else if (!cur_tex->failed && !cur_tex->loaded && !cur_tex->proxy_shift && texture_atlas_add(cur_tex)) {
+            // small images share a page and only account for their own area
+            texture = cur_tex->name;
+            upload_bytes += cur_tex->used_texture_bytes;
+            glErrorFound = on_texture_uploaded(manager, cur_tex->url, texture, cur_tex->width, cur_tex->height,
+                cur_tex->originalWidth, cur_tex->originalHeight, cur_tex->num_channels, cur_tex->scale, cur_tex->is_text,
+                cur_tex->used_texture_bytes, cur_tex->compression_type);
+        } else if (!cur_tex->failed) {
             GLTRACE(glGenTextures(1, &texture));
             GLTRACE(glBindTexture(GL_TEXTURE_2D, texture));
-            GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+            GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
             GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-            GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
-            GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
+            GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+            GLTRACE(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
 
             // create the texture
-            int channels = cur_tex->num_channels;
-            int width = cur_tex->width >> (cur_tex->scale - 1);
-            int height = cur_tex->height >> (cur_tex->scale - 1);
-            if (cur_tex->compression_type) {
-                glCompressedTexImage2D(GL_TEXTURE_2D, 0, cur_tex->compression_type, width, height, 0, cur_tex->used_texture_bytes, cur_tex->pixel_data);
-            } else {
-                // select the right internal and input format based on the number of channels
-                GLint format;
-                switch (channels) {
-                case 1:
-                    format = GL_LUMINANCE;
-                    break;
-                case 3:
-                    format = GL_RGB;
-                    break;
-                default:
-                case 4:
-                    format = GL_RGBA;
-                    break;
-                }
-                GLTRACE(glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, cur_tex->pixel_data));
+            int width = cur_tex->width >> TEXTURE_SCALE_SHIFT(cur_tex->scale);
+            int height = cur_tex->height >> TEXTURE_SCALE_SHIFT(cur_tex->scale);
+            if (cur_tex->proxy_shift) {
+                width = (width + (1 << cur_tex->proxy_shift) - 1) >> cur_tex->proxy_shift;
+                height = (height + (1 << cur_tex->proxy_shift) - 1) >> cur_tex->proxy_shift;
+            }
+
+            // generated mip levels follow the base level over the next ticks,
+            // levels from the file all go up now
+            cur_tex->uploaded_levels = cur_tex->compression_type ? cur_tex->num_levels : 1;
+            cur_tex->mipmapped = false;
+            int level;
+            for (level = 0; level < cur_tex->uploaded_levels; ++level) {
+                upload_bytes += upload_texture_level(cur_tex, level, width, height);
+            }
+
+            // the full texture replaces the proxy under the same texture_2d
+            if (is_refinement && cur_tex->atlas_page) {
+                texture_atlas_remove(cur_tex);
+            } else if (is_refinement && release_shared_texture(manager, cur_tex)) {
+                GLuint proxy_name = cur_tex->name;
+                GLTRACE(glDeleteTextures(1, &proxy_name));
             }
 
-            glErrorFound = texture_manager_on_texture_loaded(manager, cur_tex->url, texture, cur_tex->width, cur_tex->height,
+            glErrorFound = on_texture_uploaded(manager, cur_tex->url, texture, cur_tex->width, cur_tex->height,
                 cur_tex->originalWidth, cur_tex->originalHeight, cur_tex->num_channels, cur_tex->scale, cur_tex->is_text,
                 cur_tex->used_texture_bytes, cur_tex->compression_type);
-        } else {
+        } else if (!cur_tex->loaded) {
             cur_tex->loaded = true;
+            cur_tex->used_texture_bytes = 0;
+            manager->approx_bytes_to_load -= cur_tex->assumed_texture_bytes;
+        }
+
+        // draws classify by the texels that are up now
+        if (!cur_tex->failed) {
+            texture_format_free_opacity(&cur_tex->opacity);
+            cur_tex->opacity = cur_tex->pending_opacity;
+            memset(&cur_tex->pending_opacity, 0, sizeof(texture_opacity));
         }
 
         // generate event string
@@ -843,14 +2061,19 @@ void texture_manager_tick(texture_manager *manager) {
             event_len = snprintf(event_str, event_len, "{\"url\":\"%s\",\"name\":\"imageError\",\"priority\":0}", cur_tex->url);
         } else {
             // create json event string
+            // proxies report imageLoaded, their full texels imageRefined
             event_len = snprintf(event_str, event_len, "{\"url\":\"%s\",\"height\":%d,\"originalHeight\":%d,\"originalWidth\":%d" \
-                ",\"glName\":%d,\"width\":%d,\"name\":\"imageLoaded\",\"priority\":0}", cur_tex->url, (int)cur_tex->height,
-                (int)cur_tex->originalHeight, (int)cur_tex->originalWidth, (int)texture, (int)cur_tex->width);
+                ",\"glName\":%d,\"width\":%d,\"name\":\"%s\",\"priority\":0}", cur_tex->url, (int)cur_tex->height,
+                (int)cur_tex->originalHeight, (int)cur_tex->originalWidth, (int)texture, (int)cur_tex->width,
+                is_refinement ? "imageRefined" : "imageLoaded");
         }
 
         event_str[event_len] = '\0';
 
-        // dispatch the event
+        // dispatch the event, the decode thread may hand over new texels
+        // (the full image for a proxy) while the mutex is let go
+        const unsigned char *uploaded_texels = cur_tex->pixel_data;
+        const int uploaded_proxy_shift = cur_tex->proxy_shift;
         pthread_mutex_unlock(&mutex);
         core_dispatch_event(event_str);
 
@@ -860,12 +2083,25 @@ void texture_manager_tick(texture_manager *manager) {
 
         pthread_mutex_lock(&mutex);
 
-        free(cur_tex->pixel_data);
-        cur_tex->pixel_data = NULL;
+        // replaced texels stay queued for their own upload, and the texture
+        // is not shared under the content hash of texels it does not show
+        if (cur_tex->pixel_data != uploaded_texels || cur_tex->proxy_shift != uploaded_proxy_shift) {
+            LIST_ITERATE(&tex_load_list, cur_tex);
+            continue;
+        }
+
+        // keep the generated mip levels that are still to go up
+        if (!cur_tex->failed && cur_tex->uploaded_levels > 0 && cur_tex->uploaded_levels < cur_tex->num_levels) {
+            LIST_ITERATE(&tex_load_list, cur_tex);
+            continue;
+        }
+
+        release_texels(cur_tex);
 
         texture_2d *old_cur = cur_tex;
         LIST_ITERATE(&tex_load_list, cur_tex);
         LIST_REMOVE(&tex_load_list, old_cur);
+        share_texture(manager, old_cur);
     }
 
     pthread_mutex_unlock(&mutex);
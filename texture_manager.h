@@ -32,6 +32,24 @@ typedef struct texture_manager_t {
 	int tex_count;
 } texture_manager;
 
+typedef struct texture_usage_t {
+	int count;
+	long bytes;
+} texture_usage;
+
+// Snapshot of texture residency, see texture_manager_get_stats()
+typedef struct texture_manager_stats_t {
+	texture_usage images;
+	texture_usage canvases;
+	texture_usage text;
+	texture_usage loading; // bytes are estimates until the texture is uploaded
+	int failed_count;
+	long max_texture_bytes;
+	unsigned long hits;   // draw lookups that found the texture ready
+	unsigned long misses; // draw lookups that found the texture missing or loading
+	int frame_epoch;
+} texture_manager_stats;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,8 +63,11 @@ texture_2d *texture_manager_add_texture(texture_manager *manager, texture_2d *te
 texture_2d *texture_manager_add_texture_from_image(texture_manager *manager, const char *url, int name, int width, int height, int original_width, int original_height);
 texture_2d *texture_manager_add_texture_loaded(texture_manager *manager, texture_2d *tex);
 texture_2d *texture_manager_load_texture(texture_manager *manager, const char *url);
+int texture_manager_get_handle(texture_manager *manager, const char *url);
+texture_2d *texture_manager_load_texture_by_handle(texture_manager *manager, int handle);
 texture_2d *texture_manager_load_texture_with_size(texture_manager *manager, const char *url, int width, int height);
 void texture_manager_reload_canvases(texture_manager *manager);
+void texture_manager_restore_canvas(texture_manager *manager, texture_2d *tex);
 void texture_manager_reload(texture_manager *manager);
 texture_2d *texture_manager_resize_texture(texture_manager *manager, texture_2d *tex, int width, int height);
 void texture_manager_save(texture_manager *manager);
@@ -56,6 +77,13 @@ void texture_manager_clear_textures(texture_manager *manager, bool clear_all);
 void texture_manager_free_texture(texture_manager *manager, texture_2d *tex);
 void texture_manager_touch_texture(texture_manager *manager, const char *url);
 void texture_manager_set_use_halfsized_textures(bool use_halfsized);
+void texture_manager_set_generate_mipmaps(bool generate);
+void texture_manager_mark_minified(texture_2d *tex);
+void texture_manager_mark_drawn(texture_2d *tex, float scale2);
+int texture_manager_get_lod_scale(const char *url);
+void texture_manager_probe_image(const char *url, const void *data, unsigned long sz);
+void texture_manager_load_sheet_index();
+void texture_manager_get_sheet_size(char *url, int *width, int *height);
 texture_2d *texture_manager_update_texture(texture_manager *manager, const char *url, int name,
 											int width, int height, int original_width, int original_height,
 											int num_channels, int scale, bool is_text, long used);
@@ -78,6 +106,8 @@ void texture_manager_memory_critical();
 void texture_manager_reset_memory_critical();
 void texture_manager_set_max_memory(texture_manager *manager, long bytes); // Will only ratchet down
 void image_cache_load_callback(struct image_data *data);
+void texture_manager_get_stats(texture_manager *manager, texture_manager_stats *stats);
+char *texture_manager_dump_residency(texture_manager *manager); // JSON string, caller must free
 texture_manager *texture_manager_acquire();
 void texture_manager_release();
 
@@ -16,6 +16,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "timestep_image_map.h"
 #include "core/log.h"
@@ -26,9 +27,21 @@ timestep_image_map *timestep_image_map_init() {
     map->canary = CANARY_GOOD;
 #endif
     map->url = 0;
+    map->texture_handle = 0;
     return map;
 }
 
+// Replaces the url, dropping the cached texture handle so it is resolved again.
+// This is the user setter for ImageMap.url, see templates/image_map.json
+void timestep_image_map_set_url(timestep_image_map *map, const char *url) {
+    if (map->url) {
+        free(map->url);
+    }
+
+    map->url = url ? strdup(url) : 0;
+    map->texture_handle = 0;
+}
+
 void timestep_image_delete(timestep_image_map *map) {
     if (map->url) {
         free(map->url);
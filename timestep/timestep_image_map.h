@@ -31,6 +31,7 @@ typedef struct timestep_image_map_t {
 	unsigned int canary;
 #endif
 	char *url;
+	int texture_handle; // Interned url, resolved on first draw and dropped by timestep_image_map_set_url()
 } timestep_image_map;
 
 #if defined(DEBUG)
@@ -43,6 +44,7 @@ typedef struct timestep_sprite_t {
 } timestep_sprite;
 
 timestep_image_map *timestep_image_map_init();
+void timestep_image_map_set_url(timestep_image_map *map, const char *url);
 void timestep_image_delete(timestep_image_map *map);
 
 #endif
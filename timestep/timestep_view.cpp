@@ -23,6 +23,7 @@
 #include "js/js.h"
 #include "core/log.h"
 #include "core/tealeaf_context.h"
+#include "core/texture_manager.h"
 
 static unsigned int UID = 0;
 static int add_order = 0;
@@ -56,7 +57,10 @@ static void image_view_render(timestep_view *v, context_2d *ctx) {
             LOG("ERROR: !! The map canary is dead !! %x", map->canary);
         } else {
 #endif
-            context_2d_drawImage(ctx, 0, map->url, &src_rect, &dest_rect);
+            if (!map->texture_handle) {
+                map->texture_handle = texture_manager_get_handle(texture_manager_get(), map->url);
+            }
+            context_2d_drawImage_handle(ctx, map->texture_handle, &src_rect, &dest_rect);
 #if defined(DEBUG)
         }
 #endif
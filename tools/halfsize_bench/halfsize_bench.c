@@ -0,0 +1,275 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/*
+ * Times the half-sizing and premultiplying done by texture_2d_load_texture_raw
+ * against the scalar loops it used before premultiply.c, and checks that both
+ * give the same bytes.  Build for the target with and without SIMD, for
+ * example -mno-sse2 on x86 or -mfpu=vfpv3 on 32-bit ARM, to compare those too.
+ *
+ *   halfsizebench [width height [iterations]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core/premultiply.h"
+#include "core/mipmap.h"
+
+#define COLOR_AVG2(x, y) (((unsigned short)( x ) + (unsigned short)( y ) + 1) >> 1)
+#define COLOR_AVG4(x, y, z, w) (((unsigned short)( x ) + (unsigned short)( y ) + (unsigned short)( z ) + (unsigned short)( w ) + 2) >> 2)
+#define MULT_ALPHA(c, a) (unsigned char)(((unsigned short)( c ) * (unsigned short)( a ) + 128) >> 8)
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The RGBA 2x2 loop as it was, even rows and columns only
+static void old_halve_rgba(const unsigned char *rowi, unsigned char *rowo, int w_old, int h_old) {
+    const int OLD_STRIDE = w_old << 2;
+    int x, y;
+
+    for (y = 0; y < (h_old & ~1); y += 2, rowi += OLD_STRIDE) {
+        for (x = 0; x < (w_old & ~1); x += 2) {
+            unsigned short a0 = rowi[3], a1 = rowi[7], a2 = rowi[OLD_STRIDE+3], a3 = rowi[OLD_STRIDE+7];
+            unsigned short a = 0, r = 0, g = 0, b = 0, acnt = 0;
+            if (a0) { a += a0; ++acnt; r += rowi[0]; g += rowi[1]; b += rowi[2]; }
+            if (a1) { a += a1; ++acnt; r += rowi[4]; g += rowi[5]; b += rowi[6]; }
+            if (a2) { a += a2; ++acnt; r += rowi[OLD_STRIDE]; g += rowi[OLD_STRIDE+1]; b += rowi[OLD_STRIDE+2]; }
+            if (a3) { a += a3; ++acnt; r += rowi[OLD_STRIDE+4]; g += rowi[OLD_STRIDE+5]; b += rowi[OLD_STRIDE+6]; }
+
+            switch (acnt) {
+            case 2: a = (a + 1) >> 1; r = (r + 1) >> 1; g = (g + 1) >> 1; b = (b + 1) >> 1; break;
+            case 3: a = (a + 1) / 3; r = (r + 1) / 3; g = (g + 1) / 3; b = (b + 1) / 3; break;
+            case 4: a = (a + 2) >> 2; r = (r + 2) >> 2; g = (g + 2) >> 2; b = (b + 2) >> 2; break;
+            default: break;
+            }
+
+            rowo[0] = MULT_ALPHA(r, a);
+            rowo[1] = MULT_ALPHA(g, a);
+            rowo[2] = MULT_ALPHA(b, a);
+            rowo[3] = (unsigned char)a;
+            rowi += 8;
+            rowo += 4;
+        }
+        rowi += (w_old & 1) << 2;
+    }
+
+    // final odd row with itself
+    if (h_old & 1) {
+        for (x = 0; x < (w_old & ~1); x += 2) {
+            unsigned short a0 = rowi[3], a1 = rowi[7];
+            unsigned short a = 0, r = 0, g = 0, b = 0, acnt = 0;
+            if (a0) { a += a0; ++acnt; r += rowi[0]; g += rowi[1]; b += rowi[2]; }
+            if (a1) { a += a1; ++acnt; r += rowi[4]; g += rowi[5]; b += rowi[6]; }
+            if (acnt == 2) { a = (a + 1) >> 1; r = (r + 1) >> 1; g = (g + 1) >> 1; b = (b + 1) >> 1; }
+
+            rowo[0] = MULT_ALPHA(r, a);
+            rowo[1] = MULT_ALPHA(g, a);
+            rowo[2] = MULT_ALPHA(b, a);
+            rowo[3] = (unsigned char)a;
+            rowi += 8;
+            rowo += 4;
+        }
+    }
+}
+
+// The RGB and monochrome 2x2 loops as they were
+static void old_halve_color(const unsigned char *rowi, unsigned char *rowo, int w_old, int h_old, int ch) {
+    const int OLD_STRIDE = w_old * ch;
+    int x, y, c;
+
+    for (y = 0; y < (h_old & ~1); y += 2, rowi += OLD_STRIDE) {
+        for (x = 0; x < (w_old & ~1); x += 2) {
+            for (c = 0; c < ch; ++c) {
+                rowo[c] = COLOR_AVG4(rowi[c], rowi[ch+c], rowi[OLD_STRIDE+c], rowi[OLD_STRIDE+ch+c]);
+            }
+            rowi += 2 * ch;
+            rowo += ch;
+        }
+        rowi += (w_old & 1) * ch;
+    }
+
+    if (h_old & 1) {
+        for (x = 0; x < (w_old & ~1); x += 2) {
+            for (c = 0; c < ch; ++c) {
+                rowo[c] = COLOR_AVG2(rowi[c], rowi[ch+c]);
+            }
+            rowi += 2 * ch;
+            rowo += ch;
+        }
+    }
+}
+
+static void old_premultiply(const unsigned char *rowi, unsigned char *rowo, int texels) {
+    while (texels--) {
+        unsigned short a = rowi[3];
+        rowo[0] = MULT_ALPHA(rowi[0], a);
+        rowo[1] = MULT_ALPHA(rowi[1], a);
+        rowo[2] = MULT_ALPHA(rowi[2], a);
+        rowo[3] = (unsigned char)a;
+        rowi += 4;
+        rowo += 4;
+    }
+}
+
+// The same work through the kernels texture_2d.c calls now
+static void new_halve(const unsigned char *rowi, unsigned char *rowo, int w_old, int h_old, int ch) {
+    const int stride = w_old * ch;
+    const int out_w = w_old >> 1;
+    int y;
+
+    for (y = 0; y < (h_old & ~1); y += 2, rowi += 2 * stride, rowo += out_w * ch) {
+        if (ch == 4) {
+            premultiply_halve_row(rowi, rowi + stride, rowo, out_w);
+        } else {
+            mipmap_box_filter_row(rowi, rowi + stride, rowo, out_w, ch);
+        }
+    }
+
+    if (h_old & 1) {
+        if (ch == 4) {
+            premultiply_halve_row(rowi, rowi, rowo, out_w);
+        } else {
+            mipmap_box_filter_row(rowi, rowi, rowo, out_w, ch);
+        }
+    }
+}
+
+// Sprites are mostly clear or opaque with soft edges, noise covers the rest
+static void fill_image(unsigned char *pixels, int w, int h, int ch) {
+    int i;
+    for (i = 0; i < w * h; ++i) {
+        unsigned char *p = pixels + i * ch;
+        int c;
+        for (c = 0; c < ch; ++c) {
+            p[c] = (unsigned char)rand();
+        }
+        if (ch == 4) {
+            int kind = rand() % 4;
+            p[3] = kind == 0 ? 0 : kind == 1 ? 255 : (unsigned char)rand();
+        }
+    }
+}
+
+typedef void (*bench_fn)(const unsigned char *in, unsigned char *out, int w, int h, int ch);
+
+static void run_old_halve(const unsigned char *in, unsigned char *out, int w, int h, int ch) {
+    if (ch == 4) {
+        old_halve_rgba(in, out, w, h);
+    } else {
+        old_halve_color(in, out, w, h, ch);
+    }
+}
+
+static void run_new_halve(const unsigned char *in, unsigned char *out, int w, int h, int ch) {
+    new_halve(in, out, w, h, ch);
+}
+
+// premultiplying reads the image as RGBA, whatever its channel count
+static void run_old_premultiply(const unsigned char *in, unsigned char *out, int w, int h, int ch) {
+    old_premultiply(in, out, w * h * ch / 4);
+}
+
+static void run_new_premultiply(const unsigned char *in, unsigned char *out, int w, int h, int ch) {
+    premultiply_row(in, out, w * h * ch / 4);
+}
+
+static double time_fn(bench_fn fn, const unsigned char *in, unsigned char *out, int w, int h, int ch, int iterations) {
+    double start = now_seconds();
+    int i;
+    for (i = 0; i < iterations; ++i) {
+        fn(in, out, w, h, ch);
+    }
+    return now_seconds() - start;
+}
+
+// Returns nonzero if the two versions disagree
+static int compare(const char *name, bench_fn old_fn, bench_fn new_fn, int w, int h, int ch, int iterations) {
+    const size_t in_size = (size_t)w * h * ch;
+    unsigned char *in = (unsigned char *)malloc(in_size);
+    unsigned char *old_out = (unsigned char *)calloc(in_size, 1);
+    unsigned char *new_out = (unsigned char *)calloc(in_size, 1);
+    int failed;
+
+    fill_image(in, w, h, ch);
+    old_fn(in, old_out, w, h, ch);
+    new_fn(in, new_out, w, h, ch);
+    failed = memcmp(old_out, new_out, in_size) != 0;
+
+    double old_time = time_fn(old_fn, in, old_out, w, h, ch, iterations);
+    double new_time = time_fn(new_fn, in, new_out, w, h, ch, iterations);
+    double mb = (double)in_size * iterations / (1024.0 * 1024.0);
+    printf("%-16s %5dx%-5d old %8.1f MB/s  new %8.1f MB/s  x%.2f  %s\n", name, w, h,
+           mb / old_time, mb / new_time, old_time / new_time, failed ? "MISMATCH" : "exact");
+
+    free(in);
+    free(old_out);
+    free(new_out);
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    int width = 2048, height = 2048, iterations = 20;
+    int failed = 0;
+    int i;
+
+    if (argc >= 3) {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        iterations = atoi(argv[3]);
+    }
+    if (width < 1 || height < 1 || iterations < 1) {
+        fprintf(stderr, "usage: %s [width height [iterations]]\n", argv[0]);
+        return 1;
+    }
+
+    srand(1);
+    failed |= compare("halve rgba", run_old_halve, run_new_halve, width, height, 4, iterations);
+    failed |= compare("halve rgb", run_old_halve, run_new_halve, width, height, 3, iterations);
+    failed |= compare("halve luminance", run_old_halve, run_new_halve, width, height, 1, iterations);
+    failed |= compare("premultiply", run_old_premultiply, run_new_premultiply, width, height, 4, iterations);
+
+    // odd and small sizes exercise the scalar tails
+    for (i = 0; i < 200 && !failed; ++i) {
+        int w = 1 + rand() % 67, h = 1 + rand() % 9, ch;
+        for (ch = 1; ch <= 4; ++ch) {
+            if (ch == 2) {
+                continue;
+            }
+            unsigned char *in = (unsigned char *)malloc((size_t)w * h * ch);
+            unsigned char *a = (unsigned char *)calloc((size_t)w * h * ch, 1);
+            unsigned char *b = (unsigned char *)calloc((size_t)w * h * ch, 1);
+            fill_image(in, w, h, ch);
+            run_old_halve(in, a, w, h, ch);
+            run_new_halve(in, b, w, h, ch);
+            if (memcmp(a, b, (size_t)w * h * ch)) {
+                printf("MISMATCH halving %dx%d with %d channels\n", w, h, ch);
+                failed = 1;
+            }
+            free(in);
+            free(a);
+            free(b);
+        }
+    }
+
+    return failed;
+}
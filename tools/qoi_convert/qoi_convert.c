@@ -0,0 +1,201 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/*
+ * Converts PNGs to QOI images for the build, which load_image_from_memory
+ * decodes several times faster.  Opaque images are written with 3 channels so
+ * they can still become ETC1 or RGB565 textures.  Grayscale and 16-bit PNGs
+ * are refused, the engine would not load them as RGB or RGBA.  Every file is
+ * decoded again and compared before it is written.
+ *
+ *   qoiconvert <in.png> <out.qoi>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+
+#include "core/qoi.h"
+
+static int write_file(const char *path, const void *data, unsigned long size) {
+    FILE *file = fopen(path, "wb");
+    int ok;
+
+    if (!file) {
+        return 0;
+    }
+
+    ok = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+// Drops the alpha channel in place when every pixel is opaque
+static int pack_opaque(unsigned char *pixels, unsigned long count) {
+    unsigned long i;
+
+    for (i = 0; i < count; ++i) {
+        if (pixels[i * 4 + 3] != 255) {
+            return 4;
+        }
+    }
+
+    for (i = 0; i < count; ++i) {
+        memmove(pixels + i * 3, pixels + i * 4, 3);
+    }
+    return 3;
+}
+
+static int matches(const unsigned char *file, unsigned long size, const unsigned char *pixels) {
+    qoi_decoder dec;
+    int y, ok = 1;
+
+    if (!qoi_decoder_init(&dec, file, size)) {
+        return 0;
+    }
+
+    const size_t pitch = (size_t)dec.width * dec.channels;
+    unsigned char *row = (unsigned char *)malloc(pitch);
+    for (y = 0; ok && y < dec.height; ++y) {
+        ok = qoi_decode_row(&dec, row) && !memcmp(row, pixels + pitch * y, pitch);
+    }
+    free(row);
+    return ok;
+}
+
+// Decodes with the same libpng setup as load_png in image_loader.c, so the
+// texels are the ones the engine would load from the PNG.  No gamma is applied
+static unsigned char *read_png(const char *path, int *width, int *height, int *channels) {
+    unsigned char sig[8];
+    unsigned char *volatile pixels = NULL;
+    png_bytep *volatile rows = NULL;
+    png_structp png_ptr = NULL;
+    png_infop info_ptr = NULL;
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        fprintf(stderr, "%s: unable to open\n", path);
+        return NULL;
+    }
+    if (fread(sig, 1, 8, file) != 8 || png_sig_cmp(sig, 0, 8)) {
+        fprintf(stderr, "%s: not a PNG\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+    if (!info_ptr) {
+        png_destroy_read_struct(&png_ptr, NULL, NULL);
+        fclose(file);
+        return NULL;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        fprintf(stderr, "%s: unable to decode\n", path);
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        free(rows);
+        free(pixels);
+        fclose(file);
+        return NULL;
+    }
+
+    png_init_io(png_ptr, file);
+    png_set_sig_bytes(png_ptr, 8);
+    png_read_info(png_ptr, info_ptr);
+
+    int bit_depth, color_type;
+    png_uint_32 w, h;
+    png_get_IHDR(png_ptr, info_ptr, &w, &h, &bit_depth, &color_type, NULL, NULL, NULL);
+    if (color_type & PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png_ptr);
+    }
+    if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+    }
+    png_read_update_info(png_ptr, info_ptr);
+
+    // QOI holds RGB or RGBA, the engine keeps grayscale as luminance
+    *channels = (int)png_get_channels(png_ptr, info_ptr);
+    if (bit_depth > 8 || (*channels != 3 && *channels != 4)) {
+        fprintf(stderr, "%s: only 8-bit RGB, RGBA and palette images convert, keep the PNG\n", path);
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        fclose(file);
+        return NULL;
+    }
+
+    const size_t pitch = png_get_rowbytes(png_ptr, info_ptr);
+    pixels = (unsigned char *)malloc(pitch * h);
+    rows = (png_bytep *)malloc(h * sizeof(png_bytep));
+    if (pixels && rows) {
+        png_uint_32 y;
+        for (y = 0; y < h; ++y) {
+            rows[y] = pixels + pitch * y;
+        }
+        png_read_image(png_ptr, rows);
+    } else {
+        fprintf(stderr, "%s: out of memory\n", path);
+        free(pixels);
+        pixels = NULL;
+    }
+
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    free(rows);
+    fclose(file);
+    *width = (int)w;
+    *height = (int)h;
+    return pixels;
+}
+
+static int convert(const char *in_path, const char *out_path) {
+    int width, height, channels;
+    unsigned char *pixels = read_png(in_path, &width, &height, &channels);
+    if (!pixels) {
+        return 1;
+    }
+
+    if (channels == 4) {
+        channels = pack_opaque(pixels, (unsigned long)width * height);
+    }
+    unsigned long size = 0;
+    unsigned char *file = qoi_encode(pixels, width, height, channels, &size);
+
+    if (!file || !matches(file, size, pixels)) {
+        fprintf(stderr, "%s: unable to encode\n", in_path);
+        free(pixels);
+        free(file);
+        return 1;
+    }
+
+    int ok = write_file(out_path, file, size);
+    free(pixels);
+    free(file);
+
+    if (!ok) {
+        fprintf(stderr, "%s: unable to write\n", out_path);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3) {
+        return convert(argv[1], argv[2]);
+    }
+
+    fprintf(stderr, "usage: %s <in.png> <out.qoi>\n", argv[0]);
+    return 2;
+}
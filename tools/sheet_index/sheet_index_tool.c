@@ -0,0 +1,140 @@
+/* @license
+ * This file is part of the Game Closure SDK.
+ *
+ * The Game Closure SDK is free software: you can redistribute it and/or modify
+ * it under the terms of the Mozilla Public License v. 2.0 as published by Mozilla.
+
+ * The Game Closure SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Mozilla Public License v. 2.0 for more details.
+
+ * You should have received a copy of the Mozilla Public License v. 2.0
+ * along with the Game Closure SDK.  If not, see <http://mozilla.org/MPL/2.0/>.
+ */
+
+/*
+ * Converts spritesheets/spritesheetSizeMap.json to the binary index read by
+ * texture_manager_load_sheet_index(), and back again for inspection.
+ *
+ *   sheetindex tobin spritesheetSizeMap.json spritesheetSizeMap.bin
+ *   sheetindex tojson spritesheetSizeMap.bin spritesheetSizeMap.json
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/sheet_index.h"
+
+static unsigned char *read_file(const char *path, unsigned long *size) {
+    FILE *file = fopen(path, "rb");
+    unsigned char *data = NULL;
+    long len;
+
+    if (!file) {
+        return NULL;
+    }
+
+    if (fseek(file, 0, SEEK_END) == 0 && (len = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        data = (unsigned char *)malloc(len + 1);
+        if (data && fread(data, 1, len, file) == (size_t)len) {
+            data[len] = '\0';
+            *size = (unsigned long)len;
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(file);
+    return data;
+}
+
+static int write_file(const char *path, const void *data, unsigned long size) {
+    FILE *file = fopen(path, "wb");
+    int ok;
+
+    if (!file) {
+        return 0;
+    }
+
+    ok = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+static int to_bin(const char *in_path, const char *out_path) {
+    json_error_t error;
+    json_t *root = json_load_file(in_path, 0, &error);
+    unsigned long size = 0;
+
+    if (!root) {
+        fprintf(stderr, "%s:%d: %s\n", in_path, error.line, error.text);
+        return 1;
+    }
+
+    unsigned char *data = sheet_index_build_from_json(root, &size);
+    json_decref(root);
+
+    if (!data) {
+        fprintf(stderr, "%s: expected an object of {\"w\": width, \"h\": height} entries\n", in_path);
+        return 1;
+    }
+
+    int ok = write_file(out_path, data, size);
+    free(data);
+
+    if (!ok) {
+        fprintf(stderr, "%s: unable to write\n", out_path);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int to_json(const char *in_path, const char *out_path) {
+    unsigned long size = 0;
+    unsigned char *data = read_file(in_path, &size);
+    sheet_index *index = sheet_index_load(data, size);
+    unsigned int i;
+
+    if (!index) {
+        fprintf(stderr, "%s: not a valid spritesheet index\n", in_path);
+        free(data);
+        return 1;
+    }
+
+    json_t *root = json_object();
+    for (i = 0; i < index->count; ++i) {
+        const char *name;
+        int width, height;
+        sheet_index_get(index, i, &name, &width, &height);
+
+        json_t *sheet = json_object();
+        json_object_set_new(sheet, "w", json_integer(width));
+        json_object_set_new(sheet, "h", json_integer(height));
+        json_object_set_new(root, name, sheet);
+    }
+
+    int ok = json_dump_file(root, out_path, JSON_INDENT(2) | JSON_SORT_KEYS) == 0;
+    json_decref(root);
+    sheet_index_destroy(index);
+
+    if (!ok) {
+        fprintf(stderr, "%s: unable to write\n", out_path);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && !strcmp(argv[1], "tobin")) {
+        return to_bin(argv[2], argv[3]);
+    } else if (argc == 4 && !strcmp(argv[1], "tojson")) {
+        return to_json(argv[2], argv[3]);
+    }
+
+    fprintf(stderr, "usage: %s tobin <map.json> <map.bin>\n       %s tojson <map.bin> <map.json>\n", argv[0], argv[0]);
+    return 2;
+}
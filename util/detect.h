@@ -32,5 +32,18 @@
 #define unlikely(x)     __builtin_expect((x),0)
 #endif
 
+// SIMD instruction sets the compiler is targeting
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GC_SSE2 1
+#endif
+
+#if defined(__SSSE3__)
+#define GC_SSSE3 1
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define GC_NEON 1
+#endif
+
 #endif
 